@@ -0,0 +1,81 @@
+#pragma once
+
+#include "spymarine/Parsing.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/*! Builds Simarine messages in the same layout a Simarine Pico uses so
+ *  traffic can be generated on the host.
+ *
+ *  Every value is terminated by 0xff. The CRC covers everything but the
+ *  first byte and the last byte in front of the CRC.
+ */
+class FrameBuilder {
+public:
+  explicit FrameBuilder(
+      spymarine::MessageType type = spymarine::MessageType::sensorState)
+      : mType{type} {}
+
+  // Value of type 1, a plain number
+  FrameBuilder& addNumber(uint8_t id, int16_t firstWord,
+                          int16_t secondWord = 0) {
+    mValues.insert(mValues.end(), {id, 0x01});
+    addWords(firstWord, secondWord);
+    mValues.push_back(0xff);
+    return *this;
+  }
+
+  // Value of type 3, a number with 5 additional bytes of unknown meaning
+  FrameBuilder& addExtendedNumber(uint8_t id, int16_t firstWord,
+                                  int16_t secondWord = 0) {
+    mValues.insert(mValues.end(), {id, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00});
+    addWords(firstWord, secondWord);
+    mValues.push_back(0xff);
+    return *this;
+  }
+
+  // Value of type 4, a zero terminated string
+  FrameBuilder& addString(uint8_t id, std::string_view str) {
+    mValues.insert(mValues.end(), {id, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00});
+    mValues.insert(mValues.end(), str.begin(), str.end());
+    mValues.insert(mValues.end(), {0x00, 0xff});
+    return *this;
+  }
+
+  std::vector<uint8_t> build() const {
+    const std::array<uint8_t, spymarine::kHeaderLength> header{
+        0x00, 0x00, 0x00, 0x00, 0x00, 0xff, static_cast<uint8_t>(mType),
+        0x85, 0xde, 0xc3, 0x46, 0x00, 0x00, 0xff};
+
+    std::vector<uint8_t> frame(header.size() + mValues.size() + 2);
+    const auto valuesEnd =
+        std::copy(header.begin(), header.end(), frame.begin());
+    std::copy(mValues.begin(), mValues.end(), valuesEnd);
+
+    const auto length = frame.size() - spymarine::kHeaderLength + 1;
+    frame[11] = static_cast<uint8_t>(length >> 8);
+    frame[12] = static_cast<uint8_t>(length);
+
+    const auto crc =
+        spymarine::crc(std::span{frame.begin() + 1, frame.end() - 3});
+    frame[frame.size() - 2] = static_cast<uint8_t>(crc >> 8);
+    frame[frame.size() - 1] = static_cast<uint8_t>(crc);
+
+    return frame;
+  }
+
+private:
+  void addWords(int16_t firstWord, int16_t secondWord) {
+    mValues.insert(mValues.end(), {static_cast<uint8_t>(secondWord >> 8),
+                                   static_cast<uint8_t>(secondWord),
+                                   static_cast<uint8_t>(firstWord >> 8),
+                                   static_cast<uint8_t>(firstWord)});
+  }
+
+  spymarine::MessageType mType;
+  std::vector<uint8_t> mValues;
+};
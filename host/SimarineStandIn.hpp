@@ -0,0 +1,146 @@
+#pragma once
+
+#include "FrameBuilder.hpp"
+
+#include "spymarine/Devices.hpp"
+#include "spymarine/Parsing.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+/*! A TCP server that answers deviceCount and deviceInfo requests like a
+ *  Simarine Pico with the given device types connected, so sensor discovery
+ *  can be run on the host. Connections are served one after another, other
+ *  requests are ignored.
+ */
+class SimarineStandIn {
+public:
+  explicit SimarineStandIn(std::vector<uint8_t> deviceTypes)
+      : mDeviceTypes{std::move(deviceTypes)} {}
+
+  ~SimarineStandIn() {
+    if (mSocket >= 0) {
+      close(mSocket);
+    }
+  }
+
+  SimarineStandIn(const SimarineStandIn&) = delete;
+  SimarineStandIn& operator=(const SimarineStandIn&) = delete;
+
+  /* Listens on port of the loopback interface or of all interfaces. Port 0
+   * picks a free port, see port(). Returns false on failure.
+   */
+  bool listen(uint16_t port, bool loopbackOnly) {
+    mSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (mSocket < 0) {
+      return false;
+    }
+
+    const int reuse = 1;
+    setsockopt(mSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr =
+        htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+    socklen_t length = sizeof(address);
+    if (bind(mSocket, reinterpret_cast<sockaddr*>(&address), length) != 0 ||
+        ::listen(mSocket, 1) != 0 ||
+        getsockname(mSocket, reinterpret_cast<sockaddr*>(&address),
+                    &length) != 0) {
+      return false;
+    }
+
+    mPort = ntohs(address.sin_port);
+    return true;
+  }
+
+  uint16_t port() const { return mPort; }
+
+  // Serves connections until stop() is called
+  void serve() {
+    while (!mStopped) {
+      const auto connection = accept(mSocket, nullptr, nullptr);
+      if (connection < 0) {
+        continue;
+      }
+      while (!mStopped && answer(connection)) {
+      }
+      close(connection);
+    }
+  }
+
+  // Makes serve() return once the current connection is closed
+  void stop() {
+    mStopped = true;
+    shutdown(mSocket, SHUT_RDWR);
+  }
+
+private:
+  // Answers the next request, returns false once the connection is closed
+  bool answer(int connection) {
+    std::array<uint8_t, 1024> buffer;
+    const std::span bytes{buffer};
+    if (!receiveAll(connection, bytes.first(spymarine::kHeaderLength))) {
+      return false;
+    }
+
+    const auto header = spymarine::parseHeader(bytes);
+    const size_t size =
+        header ? header->length + spymarine::kHeaderLength - 1 : 0;
+    if (!header || size < spymarine::kHeaderLength || size > bytes.size() ||
+        !receiveAll(connection,
+                    bytes.subspan(spymarine::kHeaderLength,
+                                  size - spymarine::kHeaderLength))) {
+      return false;
+    }
+
+    const auto request = spymarine::parseMessage(bytes.first(size));
+    const auto deviceIndex =
+        request ? spymarine::parseDeviceRequest(*request) : std::nullopt;
+    if (!deviceIndex) {
+      return true;
+    }
+
+    FrameBuilder response{request->type};
+    if (request->type == spymarine::MessageType::deviceCount) {
+      response.addNumber(1, static_cast<int16_t>(mDeviceTypes.size()));
+    } else if (*deviceIndex < mDeviceTypes.size()) {
+      response.addNumber(1, mDeviceTypes[*deviceIndex]);
+      response.addString(3, "Device " + std::to_string(*deviceIndex));
+    } else {
+      return true;
+    }
+
+    const auto frame = response.build();
+    return send(connection, frame.data(), frame.size(), MSG_NOSIGNAL) ==
+           static_cast<ssize_t>(frame.size());
+  }
+
+  static bool receiveAll(int connection, std::span<uint8_t> bytes) {
+    while (!bytes.empty()) {
+      const auto received = recv(connection, bytes.data(), bytes.size(), 0);
+      if (received <= 0) {
+        return false;
+      }
+      bytes = bytes.subspan(received);
+    }
+    return true;
+  }
+
+  std::vector<uint8_t> mDeviceTypes;
+  int mSocket{-1};
+  uint16_t mPort{0};
+  std::atomic<bool> mStopped{false};
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <span>
+#include <vector>
+
+/*! NOR flash in memory for running FlashLog on the host.
+ *
+ *  Writes clear bits like real flash, writes that would need to set a bit
+ *  are counted as conflicts. A fault can be injected after a number of
+ *  writes and erases: the failing operation only changes the first half of
+ *  its bytes, as if power was lost in the middle of it, and all operations
+ *  fail until powerCycle() is called.
+ */
+class SimulatedFlash {
+public:
+  SimulatedFlash(size_t sectorSize, size_t sectorCount)
+      : mSectorSize{sectorSize}, mBytes(sectorSize * sectorCount, 0xff),
+        mEraseCounts(sectorCount) {}
+
+  size_t sectorSize() const { return mSectorSize; }
+  size_t sectorCount() const { return mEraseCounts.size(); }
+
+  bool read(size_t offset, std::span<uint8_t> bytes) {
+    checkBounds(offset, bytes.size());
+    if (mPoweredOff) {
+      return false;
+    }
+    std::copy_n(mBytes.begin() + offset, bytes.size(), bytes.begin());
+    return true;
+  }
+
+  bool write(size_t offset, std::span<const uint8_t> bytes) {
+    checkBounds(offset, bytes.size());
+    if (mPoweredOff) {
+      return false;
+    }
+    const auto count = interrupt() ? bytes.size() / 2 : bytes.size();
+    for (size_t i = 0; i < count; i++) {
+      auto& byte = mBytes[offset + i];
+      mConflicts += (byte & bytes[i]) != bytes[i];
+      byte &= bytes[i];
+    }
+    return count == bytes.size();
+  }
+
+  bool erase(size_t sector) {
+    checkBounds(sector * mSectorSize, mSectorSize);
+    if (mPoweredOff) {
+      return false;
+    }
+    const auto count = interrupt() ? mSectorSize / 2 : mSectorSize;
+    std::fill_n(mBytes.begin() + sector * mSectorSize, count, 0xff);
+    mEraseCounts[sector]++;
+    return count == mSectorSize;
+  }
+
+  /* Lets the given number of writes and erases succeed and interrupts the
+   * next one.
+   */
+  void failAfter(size_t operations) { mOperationsUntilFault = operations; }
+
+  // Ends a fault, the flash keeps its contents
+  void powerCycle() {
+    mPoweredOff = false;
+    mOperationsUntilFault.reset();
+  }
+
+  // Clears all bits of a byte, e.g. to corrupt a record
+  void clearByte(size_t offset) { mBytes[offset] = 0; }
+
+  // Number of writes and erases so far
+  size_t operations() const { return mOperations; }
+
+  // Number of writes that would have needed to set a bit
+  size_t conflicts() const { return mConflicts; }
+
+  const std::vector<uint32_t>& eraseCounts() const { return mEraseCounts; }
+
+private:
+  void checkBounds(size_t offset, size_t size) const {
+    if (offset + size > mBytes.size()) {
+      std::fprintf(stderr, "Flash access out of bounds at %zu\n", offset);
+      std::abort();
+    }
+  }
+
+  // Counts an operation, returns true if it is interrupted by a fault
+  bool interrupt() {
+    mOperations++;
+    if (mOperationsUntilFault && (*mOperationsUntilFault)-- == 0) {
+      mPoweredOff = true;
+    }
+    return mPoweredOff;
+  }
+
+  size_t mSectorSize;
+  std::vector<uint8_t> mBytes;
+  std::vector<uint32_t> mEraseCounts;
+  std::optional<size_t> mOperationsUntilFault;
+  bool mPoweredOff{false};
+  size_t mOperations{0};
+  size_t mConflicts{0};
+};
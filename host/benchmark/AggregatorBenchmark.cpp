@@ -0,0 +1,296 @@
+#include "Benchmark.hpp"
+
+#include "JsonWriter.hpp"
+#include "SensorAggregator.hpp"
+#include "SensorValuesBinary.hpp"
+#include "SensorValuesJson.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <unordered_map>
+
+namespace benchmark {
+
+namespace {
+
+// The aggregator as it was before it used fixed slots
+class MovingAverageCalculator {
+public:
+  using SensorValuesMap = std::unordered_map<spymarine::SensorId, double>;
+
+  void updateValue(spymarine::SensorId id, const double newValue) {
+    const auto [counter, value] = mCumulativeValues[id];
+    mCumulativeValues[id] = {counter + 1, value + newValue};
+  }
+
+  const SensorValuesMap& calculateMovingAverage() {
+    for (auto& entry : mCumulativeValues) {
+      const auto [counter, value] = entry.second;
+      mAverageValues[entry.first] = value / counter;
+      entry.second = {0, 0.0};
+    }
+    return mAverageValues;
+  }
+
+private:
+  std::unordered_map<spymarine::SensorId, std::pair<size_t, double>>
+      mCumulativeValues;
+  SensorValuesMap mAverageValues;
+};
+
+/* The aggregator as it was before it kept raw values, converted samples are
+ * aggregated with Welford's online algorithm
+ */
+class DoubleAggregator {
+public:
+  struct Value {
+    spymarine::SensorId id;
+    uint32_t count;
+    double mean;
+    double min;
+    double max;
+    double last;
+    double variance;
+  };
+
+  void updateValue(spymarine::SensorId id, double value) {
+    auto& slot = mSlots[id];
+    if (slot.count == 0) {
+      slot.min = value;
+      slot.max = value;
+    } else {
+      slot.min = std::min(slot.min, value);
+      slot.max = std::max(slot.max, value);
+    }
+    slot.count++;
+    const auto delta = value - slot.mean;
+    slot.mean += delta / slot.count;
+    slot.m2 += delta * (value - slot.mean);
+    slot.last = value;
+    mActiveSlots[id / 32] |= uint32_t{1} << (id % 32);
+  }
+
+  std::span<Value> finishWindow() {
+    size_t count = 0;
+    for (size_t word = 0; word < mActiveSlots.size(); word++) {
+      for (auto bits = mActiveSlots[word]; bits != 0; bits &= bits - 1) {
+        const auto id = word * 32 + std::countr_zero(bits);
+        auto& slot = mSlots[id];
+        mValues[count++] = {static_cast<spymarine::SensorId>(id),
+                            slot.count,
+                            slot.mean,
+                            slot.min,
+                            slot.max,
+                            slot.last,
+                            slot.m2 / slot.count};
+        slot = {};
+      }
+      mActiveSlots[word] = 0;
+    }
+    return std::span{mValues.data(), count};
+  }
+
+private:
+  struct Slot {
+    uint32_t count;
+    double mean;
+    double m2;
+    double min;
+    double max;
+    double last;
+  };
+
+  std::array<Slot, 256> mSlots{};
+  std::array<uint32_t, 256 / 32> mActiveSlots{};
+  std::array<Value, 256> mValues{};
+};
+
+// Number formatted like the JSON writer does
+double formatted(double value) {
+  std::array<char, 32> buffer;
+  JsonWriter writer{buffer};
+  writer.addDouble(value);
+  return std::strtod(std::string{writer.string()}.c_str(), nullptr);
+}
+
+double formatted(int64_t numerator, uint64_t denominator) {
+  std::array<char, 32> buffer;
+  JsonWriter writer{buffer};
+  writer.addFixedPoint(numerator, denominator);
+  return std::strtod(std::string{writer.string()}.c_str(), nullptr);
+}
+
+void fail(const char* message, spymarine::SensorId id) {
+  std::fprintf(stderr, "Fixed point check failed: %s for sensor %d\n",
+               message, id);
+  std::abort();
+}
+
+/* Aggregates random windows of every sensor type with the fixed-point
+ * pipeline and with the double pipeline it replaced. The published values
+ * have to agree: mean, min, max and last within one digit of the JSON
+ * output, the binary value within one unit, the standard deviation within
+ * 0.1% of the resolution. Prints how many values differ at all.
+ */
+void verifyFixedPointEquivalence() {
+  spymarine::SensorDefinition definition;
+  for (size_t type = 0; type < spymarine::kSensorTypeCount; type++) {
+    definition.add(static_cast<spymarine::SensorId>(type),
+                   static_cast<spymarine::SensorType>(type));
+  }
+
+  std::mt19937 random{42};
+  const auto aggregator = std::make_unique<SensorAggregator>();
+  const auto reference = std::make_unique<DoubleAggregator>();
+  constexpr double kDigit = 1e-6;
+  size_t values = 0;
+  size_t differentJson = 0;
+  size_t differentBinary = 0;
+
+  for (int window = 0; window < 2000; window++) {
+    for (size_t type = 0; type < spymarine::kSensorTypeCount; type++) {
+      const auto id = static_cast<spymarine::SensorId>(type);
+      const auto scale = definition.conversion(id).scale();
+      // Around a random level, barometers in Pa around 1013 hPa
+      const auto unsignedValue = type == static_cast<size_t>(
+                                             spymarine::SensorType::barometer);
+      const auto level = unsignedValue
+                             ? 101325
+                             : std::uniform_int_distribution<int32_t>{
+                                   -30000, 30000}(random);
+      std::uniform_int_distribution<int32_t> noise{-500, 500};
+      const auto samples =
+          std::uniform_int_distribution<uint32_t>{1, 200}(random);
+      for (uint32_t i = 0; i < samples; i++) {
+        const auto raw = level + noise(random);
+        aggregator->updateValue(id, raw, i);
+        reference->updateValue(id, static_cast<double>(raw) / scale);
+      }
+    }
+
+    const auto fixed = aggregator->finishWindow(definition);
+    const auto expected = reference->finishWindow();
+    if (fixed.size() != expected.size()) {
+      fail("sensor count differs", 0);
+    }
+
+    for (size_t i = 0; i < fixed.size(); i++) {
+      const auto& value = fixed[i];
+      const auto& old = expected[i];
+      const auto json =
+          formatted(value.sum, uint64_t{value.count} * value.scale);
+      const auto oldJson = formatted(old.mean);
+      if (value.id != old.id || value.count != old.count ||
+          std::fabs(json - oldJson) > 1.5 * kDigit ||
+          std::fabs(formatted(value.min, value.scale) - formatted(old.min)) >
+              1.5 * kDigit ||
+          std::fabs(formatted(value.max, value.scale) - formatted(old.max)) >
+              1.5 * kDigit ||
+          std::fabs(formatted(value.last, value.scale) - formatted(old.last)) >
+              1.5 * kDigit) {
+        fail("JSON value differs", value.id);
+      }
+      if (std::fabs(std::sqrt(value.variance) - std::sqrt(old.variance)) >
+          1e-3 / value.scale) {
+        fail("standard deviation differs", value.id);
+      }
+      differentJson += json != oldJson;
+
+      // The binary encoding of the old mean, rounded in double
+      const auto type = *definition.find(value.id);
+      const SensorValue single[] = {value};
+      std::array<uint8_t, sensorValuesBinarySize(1)> buffer;
+      double binary = 0;
+      readSensorValuesBinary(
+          *writeSensorValuesBinary(buffer, single, definition, 0),
+          [&](spymarine::SensorId, spymarine::SensorType, double decoded) {
+            binary = decoded;
+          });
+      const auto binaryScale = spymarine::sensorBinaryScale(type);
+      const auto oldBinary = std::clamp(std::round(old.mean * binaryScale),
+                                        -32768.0, 32767.0) /
+                             binaryScale;
+      if (std::fabs(binary - oldBinary) > 1.5 / binaryScale) {
+        fail("binary value differs", value.id);
+      }
+      differentBinary += binary != oldBinary;
+      values++;
+    }
+  }
+
+  std::printf("fixed point: %zu values, %zu JSON means and %zu binary means "
+              "differ by one digit\n",
+              values, differentJson, differentBinary);
+}
+
+// Items are samples. A window of 60 frames with a value for each sensor is
+// aggregated per call.
+template <typename Aggregator, typename FinishFunction>
+void benchmarkAggregator(std::string_view name, size_t sensorCount,
+                         Aggregator& aggregator, FinishFunction finish) {
+  constexpr size_t kFramesPerWindow = 60;
+
+  run(name, kFramesPerWindow * sensorCount, [&] {
+    for (size_t frame = 0; frame < kFramesPerWindow; frame++) {
+      for (size_t id = 0; id < sensorCount; id++) {
+        const auto sensorId = static_cast<spymarine::SensorId>(id * 3);
+        // The earlier aggregators didn't keep receive times
+        if constexpr (std::is_same_v<Aggregator, SensorAggregator>) {
+          aggregator.updateValue(sensorId, static_cast<int32_t>(frame),
+                                 static_cast<uint32_t>(frame));
+        } else {
+          aggregator.updateValue(sensorId, static_cast<int32_t>(frame));
+        }
+      }
+    }
+    finish(aggregator);
+  });
+}
+
+} // namespace
+
+void runAggregatorBenchmarks() {
+  verifyFixedPointEquivalence();
+
+  constexpr auto kSensorDefinition = [] {
+    spymarine::SensorDefinition definition;
+    for (unsigned id = 0; id < 256; id += 3) {
+      definition.add(static_cast<spymarine::SensorId>(id),
+                     spymarine::SensorType::voltage);
+    }
+    return definition;
+  }();
+
+  for (const size_t sensorCount : {4, 64}) {
+    const auto count = std::to_string(sensorCount);
+
+    auto aggregator = std::make_unique<SensorAggregator>();
+    benchmarkAggregator("aggregator/" + count, sensorCount, *aggregator,
+                        [&](auto& aggregator) {
+                          doNotOptimize(
+                              aggregator.finishWindow(kSensorDefinition)
+                                  .size());
+                        });
+
+    auto reference = std::make_unique<DoubleAggregator>();
+    benchmarkAggregator("aggregator/double/" + count, sensorCount, *reference,
+                        [](auto& aggregator) {
+                          doNotOptimize(aggregator.finishWindow().size());
+                        });
+
+    MovingAverageCalculator calculator;
+    benchmarkAggregator("aggregator/map/" + count, sensorCount, calculator,
+                        [](auto& calculator) {
+                          doNotOptimize(
+                              calculator.calculateMovingAverage().size());
+                        });
+  }
+}
+
+} // namespace benchmark
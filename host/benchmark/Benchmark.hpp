@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*! Minimal benchmark harness for the host build.
+ *
+ *  A benchmark case is a function that processes a number of items (frames,
+ *  messages, ...) per call. It is run repeatedly until a minimum duration has
+ *  passed and the throughput, the time per item and the number of heap
+ *  allocations per item are reported.
+ */
+namespace benchmark {
+
+// Number of calls to operator new since the start of the process
+size_t allocationCount();
+
+// Prevents the compiler from optimizing away a computed value
+template <typename T> inline void doNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Result {
+  double itemsPerSecond;
+  double nanosecondsPerItem;
+  double allocationsPerItem;
+};
+
+inline void printHeader() {
+  std::printf("%-48s %14s %12s %14s\n", "benchmark", "items/s", "ns/item",
+              "allocs/item");
+}
+
+inline void printResult(std::string_view name, const Result& result) {
+  std::printf("%-48.*s %14.0f %12.1f %14.2f\n", static_cast<int>(name.size()),
+              name.data(), result.itemsPerSecond, result.nanosecondsPerItem,
+              result.allocationsPerItem);
+}
+
+/* Calls function repeatedly, each call processing itemsPerCall items, and
+ * returns the result.
+ */
+template <typename Function>
+Result measure(size_t itemsPerCall, Function function) {
+  using Clock = std::chrono::steady_clock;
+  constexpr auto kMinDuration = std::chrono::milliseconds{300};
+
+  // Warm up caches and lazily initialized state
+  function();
+
+  size_t calls = 1;
+  while (true) {
+    const auto allocationsBefore = allocationCount();
+    const auto start = Clock::now();
+    for (size_t i = 0; i < calls; i++) {
+      function();
+    }
+    const auto duration = Clock::now() - start;
+    const auto allocations = allocationCount() - allocationsBefore;
+
+    if (duration >= kMinDuration) {
+      const auto items = static_cast<double>(calls * itemsPerCall);
+      const auto seconds = std::chrono::duration<double>(duration).count();
+      return {items / seconds, seconds * 1e9 / items,
+              static_cast<double>(allocations) / items};
+    }
+
+    calls *= 2;
+  }
+}
+
+// Same as measure, prints the result under the given name
+template <typename Function>
+Result run(std::string_view name, size_t itemsPerCall, Function function) {
+  const auto result = measure(itemsPerCall, function);
+  printResult(name, result);
+  return result;
+}
+
+// A named set of raw datagrams as received from a Simarine device
+struct FrameSet {
+  std::string name;
+  std::vector<std::vector<uint8_t>> frames;
+};
+
+void runCrcBenchmarks(const FrameSet& frameSet);
+void runParsingBenchmarks(const FrameSet& frameSet);
+void runAggregatorBenchmarks();
+void runPayloadBenchmarks();
+void runRingBenchmarks();
+void runUdpBenchmarks(const FrameSet& frameSet);
+void runDiscoveryBenchmarks();
+void runFlashLogBenchmarks();
+void runMetricsBenchmarks(const FrameSet& frameSet);
+void runSnapshotBenchmarks();
+void runDerivedBenchmarks();
+void runSchedulerBenchmarks();
+void runCaptureBenchmarks();
+
+} // namespace benchmark
@@ -0,0 +1,145 @@
+#include "Benchmark.hpp"
+
+#include "CaptureStream.hpp"
+#include "FrameCapture.hpp"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace benchmark {
+
+namespace {
+
+constexpr uint16_t kPort = 43297;
+constexpr size_t kDatagramSize = 200;
+
+void fail(const char* message, size_t detail) {
+  std::fprintf(stderr, "Capture stream check failed: %s (%zu)\n", message,
+               detail);
+  std::abort();
+}
+
+// The datagram of record i
+std::array<uint8_t, kDatagramSize> datagram(uint32_t i) {
+  std::array<uint8_t, kDatagramSize> bytes;
+  for (size_t j = 0; j < bytes.size(); j++) {
+    bytes[j] = static_cast<uint8_t>(i + j);
+  }
+  return bytes;
+}
+
+/* Streams records to a capture server on loopback that doesn't read at
+ * first, so the send buffer fills up and records are sent partially or
+ * dropped. No write may block, and once the server reads, the capture has
+ * to contain every record that wasn't dropped, intact and in order. Items
+ * are written records.
+ */
+void verifyCaptureStream() {
+  constexpr uint32_t kStalledRecords = 100'000;
+  constexpr uint32_t kRecordCount = 2 * kStalledRecords;
+  constexpr auto kMaxWrite = std::chrono::milliseconds{50};
+
+  const auto listener = socket(AF_INET, SOCK_STREAM, 0);
+  const int reuse = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(kPort);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listener, reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(listener, 1) != 0) {
+    std::fprintf(stderr, "Couldn't listen on TCP port %d\n", kPort);
+    close(listener);
+    return;
+  }
+
+  auto stream = std::make_unique<CaptureStream>(kDatagramSize);
+  if (!stream->connect("127.0.0.1", kPort)) {
+    fail("couldn't connect", kPort);
+  }
+  const auto server = accept(listener, nullptr, nullptr);
+  close(listener);
+
+  std::vector<uint8_t> capture;
+  std::thread reader;
+  const auto startReading = [&] {
+    reader = std::thread{[&] {
+      std::array<uint8_t, 65536> buffer;
+      ssize_t size;
+      while ((size = recv(server, buffer.data(), buffer.size(), 0)) > 0) {
+        capture.insert(capture.end(), buffer.begin(), buffer.begin() + size);
+      }
+    }};
+  };
+
+  auto longestWrite = std::chrono::steady_clock::duration::zero();
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < kRecordCount; i++) {
+    if (i == kStalledRecords) {
+      startReading();
+    }
+    const auto bytes = datagram(i);
+    const auto writeStart = std::chrono::steady_clock::now();
+    if (!stream->write(i, bytes)) {
+      fail("connection lost at record", i);
+    }
+    longestWrite = std::max(longestWrite,
+                            std::chrono::steady_clock::now() - writeStart);
+  }
+  const auto seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  const auto dropped = stream->droppedRecords();
+
+  // Closes the connection, so the reader ends
+  stream.reset();
+  reader.join();
+  close(server);
+
+  if (longestWrite > kMaxWrite) {
+    fail("write blocked for ms",
+         std::chrono::duration_cast<std::chrono::milliseconds>(longestWrite)
+             .count());
+  }
+  if (dropped == 0) {
+    fail("send buffer never filled up", 0);
+  }
+
+  uint32_t previous = 0;
+  size_t records = 0;
+  const auto count = readCapture(
+      capture, [&](uint32_t timestamp, std::span<const uint8_t> bytes) {
+        const auto expected = datagram(timestamp);
+        if ((records > 0 && timestamp <= previous) ||
+            !std::equal(bytes.begin(), bytes.end(), expected.begin(),
+                        expected.end())) {
+          fail("corrupted record", timestamp);
+        }
+        previous = timestamp;
+        records++;
+      });
+  // The rest of the last record may still have been pending
+  if (!count || *count + 1 < kRecordCount - dropped ||
+      *count > kRecordCount - dropped) {
+    fail("wrong record count", count.value_or(0));
+  }
+
+  printResult("capture/write/stalled", {kRecordCount / seconds,
+                                        seconds * 1e9 / kRecordCount, 0});
+  std::printf("%-48s %7u of %u records dropped\n", "", dropped, kRecordCount);
+}
+
+} // namespace
+
+void runCaptureBenchmarks() { verifyCaptureStream(); }
+
+} // namespace benchmark
@@ -0,0 +1,92 @@
+#include "Benchmark.hpp"
+
+#include "spymarine/Crc.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+
+namespace benchmark {
+
+namespace {
+
+// The original bit-serial implementation, kept as reference
+uint16_t crcBitwise(const std::span<const uint8_t> bytes) {
+  const uint16_t poly = 0x1189;
+  uint16_t crc = 0;
+
+  for (auto byte : bytes) {
+    crc ^= byte << 8;
+    for (int i = 0; i < 8; i++) {
+      if (crc & 0x8000) {
+        crc = (crc << 1) ^ poly;
+      } else {
+        crc <<= 1;
+      }
+    }
+  }
+
+  return crc;
+}
+
+template <size_t Slices> uint16_t crc(std::span<const uint8_t> bytes) {
+  spymarine::BasicCrcState<Slices> state;
+  state.update(bytes);
+  return state.value();
+}
+
+template <size_t Slices>
+uint16_t crcChunked(std::span<const uint8_t> bytes, std::mt19937& random) {
+  spymarine::BasicCrcState<Slices> state;
+  while (!bytes.empty()) {
+    const auto chunk = std::min<size_t>(random() % 24, bytes.size());
+    state.update(bytes.first(chunk));
+    bytes = bytes.subspan(chunk);
+  }
+  return state.value();
+}
+
+// Compares all table variants, fed at once and in random chunks, with the
+// reference implementation on random input. Aborts on mismatch.
+void verifyCrcEquivalence() {
+  std::mt19937 random{42};
+  std::vector<uint8_t> bytes;
+
+  for (int i = 0; i < 10000; i++) {
+    bytes.resize(random() % 1500);
+    for (auto& byte : bytes) {
+      byte = static_cast<uint8_t>(random());
+    }
+
+    const auto expected = crcBitwise(bytes);
+    if (crc<1>(bytes) != expected || crc<4>(bytes) != expected ||
+        crc<8>(bytes) != expected || crcChunked<1>(bytes, random) != expected ||
+        crcChunked<4>(bytes, random) != expected ||
+        crcChunked<8>(bytes, random) != expected) {
+      std::fprintf(stderr, "CRC mismatch for input of %zu bytes\n",
+                   bytes.size());
+      std::abort();
+    }
+  }
+}
+
+} // namespace
+
+void runCrcBenchmarks(const FrameSet& frameSet) {
+  verifyCrcEquivalence();
+
+  const auto benchmark = [&](std::string_view name, auto function) {
+    run(frameSet.name + "/" + std::string{name}, frameSet.frames.size(), [&] {
+      for (const auto& frame : frameSet.frames) {
+        doNotOptimize(function(std::span{frame.begin() + 1, frame.end() - 3}));
+      }
+    });
+  };
+
+  benchmark("crc/bitwise", crcBitwise);
+  benchmark("crc/table", crc<1>);
+  benchmark("crc/slice-by-4", crc<4>);
+  benchmark("crc/slice-by-8", crc<8>);
+}
+
+} // namespace benchmark
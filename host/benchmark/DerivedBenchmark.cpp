@@ -0,0 +1,227 @@
+#include "Benchmark.hpp"
+
+#include "DerivedSensors.hpp"
+
+#include <array>
+#include <cstdlib>
+#include <optional>
+
+namespace benchmark {
+
+namespace {
+
+constexpr spymarine::SensorId kVoltage = 1;
+constexpr spymarine::SensorId kCurrent = 2;
+constexpr spymarine::SensorId kCharge = 3;
+constexpr spymarine::SensorId kPower = 10;
+constexpr spymarine::SensorId kChargeIntegral = 11;
+constexpr spymarine::SensorId kEnergy = 12;
+constexpr spymarine::SensorId kChargeRate = 13;
+constexpr spymarine::SensorId kTimeToEmpty = 14;
+
+constexpr auto kSensorDefinition = [] {
+  spymarine::SensorDefinition definition;
+  definition.add(kVoltage, spymarine::SensorType::voltage);
+  definition.add(kCurrent, spymarine::SensorType::current);
+  definition.add(kCharge, spymarine::SensorType::charge);
+  definition.add(20, spymarine::SensorType::temperature);
+  return definition;
+}();
+
+// Like kDerivedSensors of Config.example.hpp, followed by invalid sensors
+constexpr std::array kDerivedSensors{
+    DerivedSensor::power(kPower, kVoltage, kCurrent),
+    DerivedSensor::integral(kChargeIntegral, kCurrent,
+                            spymarine::SensorType::capacity),
+    DerivedSensor::integral(kEnergy, kPower, spymarine::SensorType::energy),
+    DerivedSensor::chargeRate(kChargeRate, kCharge, std::chrono::minutes{1}),
+    DerivedSensor::timeToEmpty(kTimeToEmpty, kCharge, kChargeRate),
+    // Taken id, unknown input and input that is only defined later
+    DerivedSensor::power(kCurrent, kVoltage, kCurrent),
+    DerivedSensor::power(15, kVoltage, 99),
+    DerivedSensor::timeToEmpty(16, kCharge, 17),
+    DerivedSensor::chargeRate(17, kCharge),
+};
+
+void fail(const char* message, long detail) {
+  std::fprintf(stderr, "Derived sensor check failed: %s (%ld)\n", message,
+               detail);
+  std::abort();
+}
+
+// The latest derived sample of each sensor
+struct DerivedSamples {
+  void update(const SensorSample& sample) {
+    latest[sample.id] = sample.raw;
+    counts[sample.id]++;
+    count++;
+  }
+
+  std::array<std::optional<int32_t>, 256> latest{};
+  std::array<size_t, 256> counts{};
+  size_t count{0};
+};
+
+void expect(const DerivedSamples& samples, spymarine::SensorId id,
+            std::optional<int32_t> expected) {
+  if (samples.latest[id] != expected) {
+    fail("unexpected value of sensor", id);
+  }
+}
+
+/* Values of a battery discharging at 10 A and 12.5 V for an hour, a gap
+ * that is left out of the integrals and the charge rate and time to empty
+ * while discharging and charging. Updates must not allocate.
+ */
+void verifyDerivedSensors() {
+  auto definition = kSensorDefinition;
+  DerivedSensors derivedSensors{kDerivedSensors, definition};
+  if (derivedSensors.count() != 6 || derivedSensors.skipped() != 3) {
+    fail("wrong number of skipped sensors", derivedSensors.skipped());
+  }
+  if (definition.find(kPower) != spymarine::SensorType::power ||
+      definition.find(kTimeToEmpty) != spymarine::SensorType::duration ||
+      definition.find(15) || definition.find(16) ||
+      definition.find(17) != spymarine::SensorType::chargeRate) {
+    fail("wrong derived sensor definition", 0);
+  }
+
+  DerivedSamples samples;
+  // Samples of the same frame share frame, see SensorSample
+  const auto update = [&](spymarine::SensorId id, int32_t raw,
+                          uint32_t timestamp, uint16_t frame) {
+    derivedSensors.update({raw, timestamp, id, frame},
+                          [&](const SensorSample& sample) {
+                            samples.update(sample);
+                          });
+  };
+
+  const auto allocationsBefore = allocationCount();
+
+  // Power needs both inputs
+  update(kVoltage, 12'500, 0, 0);
+  expect(samples, kPower, std::nullopt);
+  update(kCurrent, -1000, 0, 0);
+  expect(samples, kPower, -12'500);
+  expect(samples, kChargeIntegral, 0);
+  expect(samples, kEnergy, 0);
+
+  // -10 Ah and -125 Wh after an hour
+  for (uint32_t second = 1; second <= 3600; second++) {
+    update(kVoltage, 12'500, second * 1000, second);
+    update(kCurrent, -1000, second * 1000, second);
+  }
+  expect(samples, kChargeIntegral, -1000);
+  expect(samples, kEnergy, -12'500);
+
+  // The gap is left out, then the current goes up linearly to 10 A, which
+  // adds no charge with the trapezoidal rule
+  update(kCurrent, -1000, 3'660'000, 3660);
+  expect(samples, kChargeIntegral, -1000);
+  update(kVoltage, 12'500, 3'670'000, 3670);
+  update(kCurrent, 1000, 3'670'000, 3670);
+  expect(samples, kChargeIntegral, -1000);
+  expect(samples, kPower, 12'500);
+
+  // Power is yielded once per frame from the voltage and current of the
+  // frame, a new voltage isn't paired with the previous current
+  const auto powerSamples = samples.counts[kPower];
+  update(kVoltage, 13'000, 3'671'000, 3671);
+  expect(samples, kPower, 12'500);
+  update(kCurrent, 2000, 3'671'000, 3671);
+  expect(samples, kPower, 26'000);
+  if (samples.counts[kPower] != powerSamples + 1) {
+    fail("power samples per frame", samples.counts[kPower] - powerSamples);
+  }
+
+  // The frames of a receive batch share their timestamp. A frame without
+  // current doesn't pair its voltage with the current of the next frame.
+  update(kVoltage, 12'000, 3'672'000, 3672);
+  update(kCurrent, -1000, 3'672'000, 3672);
+  expect(samples, kPower, -12'000);
+  update(kVoltage, 13'000, 3'672'000, 3673);
+  update(kCurrent, -2000, 3'672'000, 3674);
+  expect(samples, kPower, -12'000);
+  update(kVoltage, 12'500, 3'672'000, 3675);
+  update(kCurrent, -2000, 3'672'000, 3675);
+  expect(samples, kPower, -25'000);
+  if (samples.counts[kPower] != powerSamples + 3) {
+    fail("power samples of a batch", samples.counts[kPower] - powerSamples);
+  }
+
+  // -0.6 per hour, the first time to empty is of the previous charge and
+  // 17 measures over 5 minutes, so it has no value yet
+  update(kCharge, 14'400, 0, 0);
+  update(kCharge, 14'390, 30'000, 1);
+  expect(samples, kChargeRate, std::nullopt);
+  const auto timeToEmptySamples = samples.counts[kTimeToEmpty];
+  update(kCharge, 14'240, 60'000, 2);
+  expect(samples, kChargeRate, -6000);
+  expect(samples, kTimeToEmpty, 148);
+  expect(samples, 17, std::nullopt);
+  if (samples.counts[kTimeToEmpty] != timeToEmptySamples + 1) {
+    fail("time to empty samples per charge sample",
+         samples.counts[kTimeToEmpty] - timeToEmptySamples);
+  }
+
+  // The rate stays until the next period ended. Every frame of a batch
+  // yields one time to empty of its own charge.
+  update(kCharge, 14'230, 90'000, 3);
+  expect(samples, kChargeRate, -6000);
+  expect(samples, kTimeToEmpty, 148);
+  update(kCharge, 7120, 90'000, 4);
+  expect(samples, kChargeRate, -6000);
+  expect(samples, kTimeToEmpty, 74);
+  if (samples.counts[kTimeToEmpty] != timeToEmptySamples + 3) {
+    fail("time to empty samples of a batch",
+         samples.counts[kTimeToEmpty] - timeToEmptySamples);
+  }
+
+  // No time to empty while charging
+  samples.latest[kTimeToEmpty].reset();
+  update(kCharge, 14'400, 120'000, 5);
+  expect(samples, kChargeRate, 6000);
+  expect(samples, kTimeToEmpty, std::nullopt);
+
+  // Sensors without derived sensors don't yield samples
+  const auto count = samples.count;
+  update(20, 250, 120'000, 5);
+  if (samples.count != count) {
+    fail("samples of unrelated sensor", samples.count - count);
+  }
+
+  if (allocationCount() != allocationsBefore) {
+    fail("allocations", allocationCount() - allocationsBefore);
+  }
+}
+
+} // namespace
+
+void runDerivedBenchmarks() {
+  verifyDerivedSensors();
+
+  auto definition = kSensorDefinition;
+  DerivedSensors derivedSensors{kDerivedSensors, definition};
+  uint32_t timestamp = 0;
+  int64_t sum = 0;
+  const auto consume = [&](const SensorSample& sample) { sum += sample.raw; };
+
+  // Items are input samples, a frame with a voltage and a current sample
+  // updates 3 derived sensors
+  uint16_t frame = 0;
+  run("derived/update/voltage+current", 2, [&] {
+    timestamp += 100;
+    frame++;
+    derivedSensors.update({12'500, timestamp, kVoltage, frame}, consume);
+    derivedSensors.update({-1000, timestamp, kCurrent, frame}, consume);
+  });
+  run("derived/update/charge", 1, [&] {
+    derivedSensors.update({14'000, timestamp += 100, kCharge, ++frame}, consume);
+  });
+  run("derived/update/unrelated", 1, [&] {
+    derivedSensors.update({250, timestamp += 100, 20, ++frame}, consume);
+  });
+  doNotOptimize(sum);
+}
+
+} // namespace benchmark
@@ -0,0 +1,100 @@
+#include "Benchmark.hpp"
+#include "SimarineStandIn.hpp"
+
+#include "SimarineClient.hpp"
+
+#include <cstdlib>
+#include <thread>
+
+namespace benchmark {
+
+namespace {
+
+using spymarine::SensorType;
+
+// Two batteries with a voltmeter, a tank, an unused slot, a thermometer, a
+// barometer, an ohmmeter and an ammeter in between
+const std::vector<uint8_t> kDeviceTypes{9, 1, 8, 0, 3, 5, 6, 2, 9};
+
+constexpr spymarine::SensorDefinition kExpectedDefinition{
+    {0, SensorType::charge},       {1, SensorType::current},
+    {2, SensorType::voltage},      {3, SensorType::capacity},
+    {5, SensorType::voltage},      {6, SensorType::tankLevel},
+    {7, SensorType::tankVolume},   {8, SensorType::temperature},
+    {9, SensorType::barometer},    {11, SensorType::resistance},
+    {12, SensorType::current},     {14, SensorType::charge},
+    {15, SensorType::current},     {16, SensorType::voltage},
+    {17, SensorType::capacity},
+};
+
+bool operator==(const spymarine::SensorDefinition& lhs,
+                const spymarine::SensorDefinition& rhs) {
+  for (unsigned id = 0; id < 256; id++) {
+    if (lhs.find(static_cast<spymarine::SensorId>(id)) !=
+        rhs.find(static_cast<spymarine::SensorId>(id))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Discovers the sensors of the stand-in over loopback and compares the
+ * result with kExpectedDefinition and the topology hash with the hash of
+ * other topologies. Aborts on mismatch.
+ */
+void verifyDiscovery(uint16_t port) {
+  SimarineClient client;
+  const auto discovery =
+      client.connect("127.0.0.1", port, std::chrono::seconds{2})
+          ? discoverSensors(client)
+          : nullptr;
+  if (!discovery || discovery->deviceCount() != kDeviceTypes.size() ||
+      !(discovery->sensorDefinition() == kExpectedDefinition)) {
+    std::fprintf(stderr, "Discovery returned an unexpected definition\n");
+    std::abort();
+  }
+
+  // Swapping two devices changes the ids and has to change the hash
+  spymarine::SensorDiscovery swapped;
+  auto swappedTypes = kDeviceTypes;
+  std::swap(swappedTypes[1], swappedTypes[2]);
+  for (const auto type : swappedTypes) {
+    swapped.addDevice(type);
+  }
+  if (swapped.topologyHash() == discovery->topologyHash()) {
+    std::fprintf(stderr, "Topology hash didn't change\n");
+    std::abort();
+  }
+
+  spymarine::SensorDiscovery unknown;
+  if (unknown.addDevice(0xfe)) {
+    std::fprintf(stderr, "Discovery accepted an unknown device type\n");
+    std::abort();
+  }
+}
+
+} // namespace
+
+void runDiscoveryBenchmarks() {
+  SimarineStandIn standIn{kDeviceTypes};
+  if (!standIn.listen(0, true)) {
+    std::fprintf(stderr, "Couldn't start the Simarine stand-in\n");
+    return;
+  }
+  std::thread server{[&] { standIn.serve(); }};
+
+  verifyDiscovery(standIn.port());
+
+  // Items are discoveries including connecting, one request per device and
+  // one for the device count
+  run("discovery/loopback", 1, [&] {
+    SimarineClient client;
+    client.connect("127.0.0.1", standIn.port(), std::chrono::seconds{2});
+    doNotOptimize(discoverSensors(client));
+  });
+
+  standIn.stop();
+  server.join();
+}
+
+} // namespace benchmark
@@ -0,0 +1,343 @@
+#include "Benchmark.hpp"
+#include "SimulatedFlash.hpp"
+
+#include "FlashLog.hpp"
+#include "OutboxSender.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <optional>
+#include <set>
+#include <vector>
+
+namespace benchmark {
+
+namespace {
+
+using Log = FlashLog<SimulatedFlash>;
+
+constexpr size_t kSectorSize = 512;
+
+// Record i holds i followed by i % 40 bytes derived from it
+std::vector<uint8_t> makeRecord(uint32_t i) {
+  std::vector<uint8_t> record(4 + i % 40);
+  for (size_t j = 0; j < record.size(); j++) {
+    record[j] = j < 4 ? static_cast<uint8_t>(i >> (8 * j))
+                      : static_cast<uint8_t>(i * 31 + j);
+  }
+  return record;
+}
+
+uint32_t recordIndex(std::span<const uint8_t> payload) {
+  if (payload.size() < 4) {
+    return UINT32_MAX;
+  }
+  const auto i = payload[0] | (payload[1] << 8) | (payload[2] << 16) |
+                 (uint32_t(payload[3]) << 24);
+  const auto expected = makeRecord(i);
+  return std::equal(payload.begin(), payload.end(), expected.begin(),
+                    expected.end())
+             ? i
+             : UINT32_MAX;
+}
+
+void fail(const char* message, size_t detail) {
+  std::fprintf(stderr, "Flash log check failed: %s (%zu)\n", message, detail);
+  std::abort();
+}
+
+/* Reads and consumes all pending records in batches, checks that they are
+ * valid and returns their indices
+ */
+std::vector<uint32_t> drain(Log& log) {
+  std::array<uint8_t, 128> buffer;
+  std::vector<uint32_t> indices;
+  while (log.read(buffer, [&](std::span<const uint8_t> payload) {
+    const auto i = recordIndex(payload);
+    if (i == UINT32_MAX) {
+      fail("invalid payload of size", payload.size());
+    }
+    indices.push_back(i);
+  }) > 0) {
+    if (!log.consume()) {
+      fail("consume failed after", indices.size());
+    }
+  }
+  return indices;
+}
+
+/* Appends far more records than fit while reading some of them and mounting
+ * again in between. The log has to keep the newest records in order and
+ * wear all sectors evenly.
+ */
+void verifyWrapAround() {
+  SimulatedFlash flash{kSectorSize, 4};
+  std::optional<Log> log{flash};
+  log->mount();
+
+  std::vector<uint32_t> delivered;
+  constexpr uint32_t kRecords = 5000;
+  for (uint32_t i = 0; i < kRecords; i++) {
+    if (!log->append(makeRecord(i))) {
+      fail("append failed", i);
+    }
+    if (i % 97 == 0) {
+      std::array<uint8_t, 64> buffer;
+      log->read(buffer, [&](std::span<const uint8_t> payload) {
+        delivered.push_back(recordIndex(payload));
+      });
+      log->consume();
+    }
+    if (i % 331 == 0) {
+      const auto pending = log->pendingRecords();
+      log.emplace(flash);
+      log->mount();
+      if (log->pendingRecords() != pending) {
+        fail("pending records changed by mounting", pending);
+      }
+    }
+  }
+
+  const auto rest = drain(*log);
+  delivered.insert(delivered.end(), rest.begin(), rest.end());
+  if (!std::is_sorted(delivered.begin(), delivered.end()) ||
+      std::adjacent_find(delivered.begin(), delivered.end()) !=
+          delivered.end() ||
+      delivered.back() != kRecords - 1) {
+    fail("records out of order or missing", delivered.size());
+  }
+
+  // The newest records that fit in all but the oldest sector survive
+  constexpr auto kMaxRecordSize = kFlashLogRecordHeaderSize + 4 + 39;
+  constexpr auto kNewestRecords =
+      3 * (kSectorSize - kFlashLogSectorHeaderSize) / kMaxRecordSize;
+  const auto tail = std::find(delivered.begin(), delivered.end(),
+                              kRecords - kNewestRecords);
+  if (tail == delivered.end()) {
+    fail("newest records lost", delivered.size());
+  }
+  for (auto it = tail; it + 1 != delivered.end(); ++it) {
+    if (*(it + 1) != *it + 1) {
+      fail("gap in newest records", *it);
+    }
+  }
+
+  const auto [minErases, maxErases] = std::minmax_element(
+      flash.eraseCounts().begin(), flash.eraseCounts().end());
+  if (*maxErases - *minErases > 1 || flash.conflicts() != 0) {
+    fail("uneven wear or conflicting writes", *maxErases - *minErases);
+  }
+}
+
+/* Runs a sequence of appends and reads and interrupts it at every possible
+ * flash operation. After mounting again every record whose append
+ * succeeded has to be delivered unless it was consumed, no other record may
+ * be delivered and the log has to accept new records. Records of a read
+ * whose consume failed may or may not be delivered.
+ */
+void verifyPowerLoss() {
+  constexpr uint32_t kRecords = 80;
+
+  const auto run = [&](std::optional<size_t> faultAfter) {
+    SimulatedFlash flash{kSectorSize, 8};
+    if (faultAfter) {
+      flash.failAfter(*faultAfter);
+    }
+
+    std::set<uint32_t> appended;
+    std::set<uint32_t> read;
+    std::set<uint32_t> consumed;
+    {
+      Log log{flash};
+      log.mount();
+      for (uint32_t i = 0; i < kRecords; i++) {
+        if (log.append(makeRecord(i))) {
+          appended.insert(i);
+        }
+        if (i % 9 == 8) {
+          std::vector<uint32_t> batch;
+          std::array<uint8_t, 96> buffer;
+          log.read(buffer, [&](std::span<const uint8_t> payload) {
+            batch.push_back(recordIndex(payload));
+          });
+          read.insert(batch.begin(), batch.end());
+          if (log.consume()) {
+            consumed.insert(batch.begin(), batch.end());
+          }
+        }
+      }
+    }
+
+    flash.powerCycle();
+    Log log{flash};
+    if (!log.mount()) {
+      fail("mount failed after fault at", faultAfter.value_or(0));
+    }
+
+    std::set<uint32_t> expected;
+    std::set_difference(appended.begin(), appended.end(), read.begin(),
+                        read.end(), std::inserter(expected, expected.begin()));
+
+    const auto delivered = drain(log);
+    const std::set<uint32_t> deliveredSet{delivered.begin(), delivered.end()};
+    const auto deliveredConsumed =
+        std::find_first_of(delivered.begin(), delivered.end(),
+                           consumed.begin(), consumed.end());
+    if (!std::is_sorted(delivered.begin(), delivered.end()) ||
+        deliveredSet.size() != delivered.size() ||
+        deliveredConsumed != delivered.end() ||
+        !std::includes(deliveredSet.begin(), deliveredSet.end(),
+                       expected.begin(), expected.end()) ||
+        !std::includes(appended.begin(), appended.end(), deliveredSet.begin(),
+                       deliveredSet.end())) {
+      fail("wrong records after fault at", faultAfter.value_or(0));
+    }
+
+    for (uint32_t i = kRecords; i < kRecords + 20; i++) {
+      log.append(makeRecord(i));
+    }
+    const auto later = drain(log);
+    if (later.size() != 20 || later.front() != kRecords) {
+      fail("log unusable after fault at", faultAfter.value_or(0));
+    }
+
+    return flash.operations();
+  };
+
+  const auto operations = run(std::nullopt);
+  for (size_t faultAfter = 0; faultAfter < operations; faultAfter++) {
+    run(faultAfter);
+  }
+}
+
+// A corrupted payload is skipped and the other records are delivered
+void verifyCorruption() {
+  SimulatedFlash flash{kSectorSize, 4};
+  Log log{flash};
+  log.mount();
+  for (uint32_t i = 0; i < 3; i++) {
+    log.append(makeRecord(i));
+  }
+
+  // The last byte of the payload of record 1
+  flash.clearByte(kFlashLogSectorHeaderSize + kFlashLogRecordHeaderSize +
+                  makeRecord(0).size() + kFlashLogRecordHeaderSize +
+                  makeRecord(1).size() - 1);
+
+  const auto delivered = drain(log);
+  if (delivered != std::vector<uint32_t>{0, 2} ||
+      log.counters().corrupted != 1) {
+    fail("corrupted record delivered", delivered.size());
+  }
+}
+
+// Records the messages of OutboxSender, acknowledged when the check says so
+struct AcknowledgingClient {
+  bool connected() const { return isConnected; }
+
+  std::optional<int> publishAcknowledged(const char*,
+                                         std::span<const uint8_t> data) {
+    messages.emplace_back(data.begin(), data.end());
+    return static_cast<int>(messages.size());
+  }
+
+  bool acknowledged(int messageId) const {
+    return messageId <= acknowledgedMessages;
+  }
+
+  bool isConnected{true};
+  int acknowledgedMessages{0};
+  std::vector<std::vector<uint8_t>> messages;
+};
+
+/* Publishes one batch per call and removes its records only once it was
+ * acknowledged. A batch that isn't acknowledged in time is published again
+ * and nothing is published while disconnected. The acknowledged batches
+ * have to hold every record once and in order.
+ */
+void verifyOutboxSender() {
+  using Clock = OutboxSender<Log>::Clock;
+  constexpr auto kTimeout = std::chrono::seconds{30};
+  constexpr uint32_t kRecords = 20;
+
+  SimulatedFlash flash{kSectorSize, 4};
+  Log log{flash};
+  log.mount();
+  std::vector<uint8_t> expected;
+  for (uint32_t i = 0; i < kRecords; i++) {
+    const auto record = makeRecord(i);
+    log.append(record);
+    expected.insert(expected.end(), record.begin(), record.end());
+  }
+
+  std::array<uint8_t, 128> buffer;
+  OutboxSender<Log> sender{log, "/sensors/backlog", buffer, kTimeout};
+  AcknowledgingClient client;
+  auto now = Clock::time_point{};
+
+  client.isConnected = false;
+  if (sender.send(client, now) != 0 || !client.messages.empty()) {
+    fail("published while disconnected", client.messages.size());
+  }
+
+  client.isConnected = true;
+  sender.send(client, now);
+  sender.send(client, now += std::chrono::seconds{1});
+  if (client.messages.size() != 1 || log.pendingRecords() != kRecords) {
+    fail("batch consumed or published before acknowledgement",
+         client.messages.size());
+  }
+
+  // Published again with the same records after the timeout
+  sender.send(client, now += kTimeout);
+  if (client.messages.size() != 2 ||
+      client.messages[1] != client.messages[0] ||
+      log.pendingRecords() != kRecords) {
+    fail("batch not published again after timeout", client.messages.size());
+  }
+
+  std::vector<uint8_t> delivered;
+  size_t consumed = 0;
+  while (sender.inFlight()) {
+    const auto messages = client.messages.size();
+    const auto batch = client.messages.back();
+    client.acknowledgedMessages = static_cast<int>(messages);
+    consumed += sender.send(client, now);
+    delivered.insert(delivered.end(), batch.begin(), batch.end());
+    if (client.messages.size() > messages + 1) {
+      fail("more than one batch published at once", messages);
+    }
+  }
+
+  if (delivered != expected || consumed != kRecords ||
+      log.pendingRecords() != 0) {
+    fail("records lost or repeated", consumed);
+  }
+}
+
+} // namespace
+
+void runFlashLogBenchmarks() {
+  verifyWrapAround();
+  verifyPowerLoss();
+  verifyCorruption();
+  verifyOutboxSender();
+
+  // Items are records of the size of a binary payload with 4 sensors,
+  // appended, read and consumed in batches of 16
+  SimulatedFlash flash{4096, 16};
+  Log log{flash};
+  log.mount();
+  const std::vector<uint8_t> record(22, 0x42);
+  std::array<uint8_t, 16 * 22> buffer;
+  run("flashLog/append+read", 16, [&] {
+    for (int i = 0; i < 16; i++) {
+      log.append(record);
+    }
+    doNotOptimize(log.read(buffer, [](std::span<const uint8_t>) {}));
+    log.consume();
+  });
+}
+
+} // namespace benchmark
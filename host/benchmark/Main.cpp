@@ -0,0 +1,125 @@
+#include "Benchmark.hpp"
+#include "FrameBuilder.hpp"
+#include "FrameCapture.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <optional>
+
+namespace {
+
+std::atomic<size_t> gAllocationCount{0};
+
+// Builds frames that resemble the sensor state broadcast of a Simarine Pico
+// with a couple of devices connected: a mix of plain and extended numbers
+// and a few strings.
+benchmark::FrameSet syntheticFrames(std::string name, size_t valueCount) {
+  benchmark::FrameSet frameSet{std::move(name), {}};
+
+  for (int i = 0; i < 16; i++) {
+    FrameBuilder builder;
+    for (size_t id = 0; id < valueCount; id++) {
+      const auto firstWord = static_cast<int16_t>(id * 100 + i);
+      const auto secondWord = static_cast<int16_t>(16000 - i * 10);
+      if (id % 16 == 15) {
+        builder.addString(static_cast<uint8_t>(id), "Battery");
+      } else if (id % 3 == 2) {
+        builder.addExtendedNumber(static_cast<uint8_t>(id), firstWord,
+                                  secondWord);
+      } else {
+        builder.addNumber(static_cast<uint8_t>(id), firstWord, secondWord);
+      }
+    }
+    frameSet.frames.push_back(builder.build());
+  }
+
+  return frameSet;
+}
+
+// Each file is expected to contain either a capture written by
+// CaptureStream or a single raw datagram as received on the Simarine UDP
+// port.
+std::optional<benchmark::FrameSet> recordedFrames(int argc, char** argv) {
+  benchmark::FrameSet frameSet{"recorded", {}};
+
+  for (int i = 1; i < argc; i++) {
+    std::ifstream file{argv[i], std::ios::binary};
+    if (!file) {
+      std::fprintf(stderr, "Couldn't open %s\n", argv[i]);
+      return std::nullopt;
+    }
+    const std::vector<uint8_t> bytes{std::istreambuf_iterator<char>{file},
+                                     std::istreambuf_iterator<char>{}};
+
+    const auto records =
+        readCapture(bytes, [&](uint32_t, std::span<const uint8_t> frame) {
+          frameSet.frames.emplace_back(frame.begin(), frame.end());
+        });
+    if (!records) {
+      frameSet.frames.push_back(bytes);
+    }
+  }
+
+  return frameSet;
+}
+
+} // namespace
+
+void* operator new(size_t size) {
+  gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (auto p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+size_t benchmark::allocationCount() {
+  return gAllocationCount.load(std::memory_order_relaxed);
+}
+
+/* Usage: simarine_benchmark [datagram files...]
+ *
+ * Runs all benchmarks on synthetic frames and, if given, on recorded frames.
+ */
+int main(int argc, char** argv) {
+  const auto recorded = recordedFrames(argc, argv);
+  if (!recorded) {
+    return EXIT_FAILURE;
+  }
+
+  benchmark::printHeader();
+
+  std::vector<benchmark::FrameSet> frameSets{
+      syntheticFrames("synthetic/64", 64), syntheticFrames("synthetic/8", 8)};
+  if (!recorded->frames.empty()) {
+    frameSets.push_back(*recorded);
+  }
+
+  for (const auto& frameSet : frameSets) {
+    benchmark::runCrcBenchmarks(frameSet);
+    benchmark::runParsingBenchmarks(frameSet);
+    benchmark::runMetricsBenchmarks(frameSet);
+  }
+
+  benchmark::runAggregatorBenchmarks();
+  benchmark::runPayloadBenchmarks();
+  benchmark::runRingBenchmarks();
+  benchmark::runSchedulerBenchmarks();
+  benchmark::runSnapshotBenchmarks();
+  benchmark::runDerivedBenchmarks();
+  benchmark::runUdpBenchmarks(frameSets.front());
+  benchmark::runCaptureBenchmarks();
+  benchmark::runDiscoveryBenchmarks();
+  benchmark::runFlashLogBenchmarks();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,255 @@
+#include "Benchmark.hpp"
+
+#include "Metrics.hpp"
+#include "PublishTracker.hpp"
+#include "SensorAggregator.hpp"
+#include "SpscRing.hpp"
+#include "spymarine/SensorStateDecoder.hpp"
+
+#include "esp_cpu.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <thread>
+
+namespace benchmark {
+
+namespace {
+
+// The sensor definition of Config.example.hpp
+constexpr spymarine::SensorDefinition kSensorDefinition{
+    {26, spymarine::SensorType::charge},
+    {27, spymarine::SensorType::current},
+    {33, spymarine::SensorType::charge},
+    {35, spymarine::SensorType::voltage},
+};
+
+// kReceiveBatchSize and kStatsBufferSize of AppMain
+constexpr size_t kReceiveBatchSize = 8;
+constexpr size_t kStatsBufferSize = 1024;
+
+void fail(const char* message, uint32_t detail) {
+  std::fprintf(stderr, "Metrics check failed: %s (%u)\n", message, detail);
+  std::abort();
+}
+
+// Quantiles are the upper bounds of their buckets and cover one interval
+void verifyHistogram() {
+  MetricHistogram histogram;
+  for (uint32_t value = 1; value <= 100; value++) {
+    histogram.record(value);
+  }
+  histogram.record(0);
+  histogram.record(UINT32_MAX);
+
+  const auto summary = histogram.summarize();
+  if (summary.count != 102 || summary.p50 != 63 || summary.p90 != 127 ||
+      summary.p99 != 127 || summary.max != UINT32_MAX) {
+    fail("wrong summary of count", summary.count);
+  }
+
+  histogram.record(5);
+  const auto next = histogram.summarize();
+  if (next.count != 1 || next.p50 != 7 || next.max != 7) {
+    fail("summary includes earlier values, count", next.count);
+  }
+  if (histogram.summarize().count != 0) {
+    fail("empty interval not empty", 0);
+  }
+
+  // Shared updates from several threads don't lose any, like those of the
+  // publishing and the MQTT task
+  constexpr uint32_t kSharedUpdates = 100'000;
+  MetricCounter counter;
+  const auto update = [&] {
+    for (uint32_t i = 0; i < kSharedUpdates; i++) {
+      histogram.recordShared(1);
+      counter.addShared();
+    }
+  };
+  std::thread first{update};
+  std::thread second{update};
+  first.join();
+  second.join();
+  if (const auto count = histogram.summarize().count;
+      count != 2 * kSharedUpdates || counter.value() != 2 * kSharedUpdates) {
+    fail("shared updates lost, count", count);
+  }
+}
+
+// The metrics with their largest values fit into the buffer of AppMain
+void verifyMetricsJson() {
+  const auto metrics = std::make_unique<PipelineMetrics>();
+  for (auto* counter :
+       {&metrics->batches, &metrics->datagrams, &metrics->duplicates,
+        &metrics->rejectedFrames, &metrics->crcMismatches, &metrics->samples,
+        &metrics->droppedSamples, &metrics->publish.publishes,
+        &metrics->publish.failedPublishes, &metrics->publish.publishedBytes,
+        &metrics->publish.untrackedAcknowledgements}) {
+    counter->add(UINT32_MAX);
+  }
+  for (auto* histogram :
+       {&metrics->frameCycles, &metrics->sampleCycles,
+        &metrics->serializeCycles, &metrics->oldestSampleMilliseconds,
+        &metrics->newestSampleMilliseconds,
+        &metrics->publish.publishMicroseconds,
+        &metrics->publish.acknowledgeMicroseconds}) {
+    histogram->record(UINT32_MAX);
+  }
+
+  std::array<char, kStatsBufferSize> buffer;
+  JsonWriter writer{buffer};
+  writeMetricsJson(writer, *metrics, UINT32_MAX, UINT32_MAX);
+  if (writer.overflow()) {
+    fail("stats don't fit into bytes", kStatsBufferSize);
+  }
+
+  // Without acknowledgements in the interval the latency isn't measured
+  JsonWriter emptyWriter{buffer};
+  writeMetricsJson(emptyWriter, *metrics, 0, 0);
+  const auto stats = emptyWriter.string();
+  if (stats.find("\"ack_us\":null") == std::string_view::npos) {
+    fail("unmeasured ack_us not null, bytes", stats.size());
+  }
+}
+
+/* Acknowledgements are matched to their publish in either order, across
+ * wrapping times, and the oldest publishes are dropped when too many wait
+ */
+void verifyPublishTracker() {
+  PublishTracker tracker;
+  if (tracker.published(1, 1, 1000) || tracker.acknowledged(1, 1700) != 700u) {
+    fail("acknowledgement not matched", 1);
+  }
+  if (tracker.acknowledged(2, 2500) || tracker.published(2, 1, 2000) != 500u) {
+    fail("early acknowledgement not matched", 2);
+  }
+  if (tracker.published(3, 1, UINT32_MAX - 99) ||
+      tracker.acknowledged(3, 100) != 200u) {
+    fail("wrapped time not matched", 3);
+  }
+  if (tracker.acknowledged(1, 3000) || tracker.dropped() != 0) {
+    fail("acknowledgement matched twice", 1);
+  }
+  // QoS 0 isn't acknowledged, so it isn't measured and doesn't take an entry
+  for (int i = 0; i < 20; i++) {
+    if (tracker.published(0, 0, 3500)) {
+      fail("QoS 0 publish measured", i);
+    }
+  }
+  if (tracker.dropped() != 0) {
+    fail("QoS 0 publishes dropped entries", tracker.dropped());
+  }
+
+  // Publishes 10 to 25 drop the unmatched acknowledgement of 1, the
+  // unmatched acknowledgement of 30 drops publish 10
+  for (int id = 10; id < 26; id++) {
+    tracker.published(id, 1, 4000);
+  }
+  if (tracker.dropped() != 1 || tracker.acknowledged(30, 4100) ||
+      tracker.dropped() != 2 || tracker.acknowledged(10, 4100) ||
+      tracker.acknowledged(25, 4100) != 100u) {
+    fail("wrong entries dropped, dropped", tracker.dropped());
+  }
+}
+
+/* The oldest and newest receive times of a window, also across the
+ * wrapping of the milliseconds since boot
+ */
+void verifySampleTimes() {
+  SensorAggregator aggregator;
+  aggregator.updateValue(35, 13200, UINT32_MAX - 10);
+  aggregator.updateValue(26, 15900, UINT32_MAX - 5);
+  aggregator.updateValue(35, 13300, 20);
+  aggregator.updateValue(26, 15950, 10);
+
+  const auto times = sampleTimes(aggregator.finishWindow(kSensorDefinition));
+  if (!times || times->first != UINT32_MAX - 10 || times->last != 20) {
+    fail("wrong sample times, first", times ? times->first : 0);
+  }
+  if (sampleTimes(aggregator.finishWindow(kSensorDefinition))) {
+    fail("sample times of an empty window", 0);
+  }
+}
+
+// Decodes the frames and queues their samples like the receiving task
+class ReceivePath {
+public:
+  explicit ReceivePath(const FrameSet& frameSet) : mFrames{frameSet.frames} {}
+
+  void run() {
+    for (const auto& frame : mFrames) {
+      if (const auto decoded = spymarine::decodeSensorState(
+              frame, kSensorDefinition, mReadings, mParseCounters)) {
+        for (const auto& reading : *decoded) {
+          mRing.push({reading.raw, 0, reading.id, 0});
+        }
+      }
+      while (mRing.pop()) {
+      }
+    }
+  }
+
+private:
+  const std::vector<std::vector<uint8_t>>& mFrames;
+  std::array<spymarine::SensorReading, 256> mReadings;
+  spymarine::ParseCounters mParseCounters;
+  SpscRing<SensorSample, 512> mRing;
+};
+
+} // namespace
+
+/* The receiving task records its metrics once per batch of datagrams. Their
+ * cost is compared with the cost of the frames of a full batch. It is
+ * measured on its own since it is far below the noise of measuring the
+ * receive path with and without metrics.
+ *
+ * The two reads of the cycle counter around a timed batch are measured
+ * separately: on the ESP32 they read a CPU register, on the host they
+ * execute rdtsc, which virtual machines may trap and which then costs more
+ * than all the counters. Only one in kTimedBatchInterval batches is timed,
+ * like in the receiving task.
+ */
+void runMetricsBenchmarks(const FrameSet& frameSet) {
+  verifyHistogram();
+  verifyMetricsJson();
+  verifyPublishTracker();
+  verifySampleTimes();
+
+  // Items are frames
+  const auto receivePath = std::make_unique<ReceivePath>(frameSet);
+  const auto frame = run(frameSet.name + "/receivePath",
+                         frameSet.frames.size(), [&] { receivePath->run(); });
+
+  // Items are batches
+  const auto metrics = std::make_unique<PipelineMetrics>();
+  uint32_t batch = 0;
+  const auto record = run("metrics/recordReceiveBatch", 1, [&] {
+    batch++;
+    doNotOptimize(batch);
+    metrics->recordReceiveBatch({kReceiveBatchSize, batch % 3, 0, 0, 32, 0});
+  });
+  const auto timed = run("metrics/recordReceiveBatch/cycleCount", 1, [&] {
+    const auto isTimed = metrics->timesNextBatch();
+    const auto start = isTimed ? esp_cpu_get_cycle_count() : 0;
+    batch++;
+    doNotOptimize(batch);
+    metrics->recordReceiveBatch(
+        {kReceiveBatchSize, batch % 3, 0, 0, 32, 0},
+        isTimed ? std::optional{esp_cpu_get_cycle_count() - start}
+                : std::nullopt);
+  });
+
+  const auto batchNanoseconds = kReceiveBatchSize * frame.nanosecondsPerItem;
+  std::printf("%-48s %7.2f%% of a batch of %zu frames, %.2f%% with the host "
+              "cycle counter\n",
+              "", 100 * record.nanosecondsPerItem / batchNanoseconds,
+              kReceiveBatchSize,
+              100 * timed.nanosecondsPerItem / batchNanoseconds);
+}
+
+} // namespace benchmark
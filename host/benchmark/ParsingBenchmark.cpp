@@ -0,0 +1,338 @@
+#include "Benchmark.hpp"
+
+#include "FrameBuilder.hpp"
+#include "FrameDeduplicator.hpp"
+#include "spymarine/Parsing.hpp"
+#include "spymarine/Sensor.hpp"
+#include "spymarine/SensorStateDecoder.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_map>
+
+namespace benchmark {
+
+namespace {
+
+using spymarine::SensorId;
+using spymarine::SensorType;
+
+// The sensor definition of Config.example.hpp
+constexpr spymarine::SensorDefinition kSensorDefinition{
+    {26, SensorType::charge},
+    {27, SensorType::current},
+    {33, SensorType::charge},
+    {35, SensorType::voltage},
+};
+
+// An installation with many devices where every value of the synthetic
+// frames is a configured sensor
+constexpr auto kLargeSensorDefinition = [] {
+  spymarine::SensorDefinition definition;
+  for (SensorId id = 0; id < 64; id++) {
+    definition.add(id,
+                   static_cast<SensorType>(id % spymarine::kSensorTypeCount));
+  }
+  return definition;
+}();
+
+// The sensor definition as it was before it became a dense table
+using SensorDefinitionMap = std::unordered_map<SensorId, SensorType>;
+
+SensorDefinitionMap toMap(const spymarine::SensorDefinition& definition) {
+  SensorDefinitionMap map;
+  definition.forEach([&](SensorId id, SensorType type) { map[id] = type; });
+  return map;
+}
+
+template <typename SensorValueFunction>
+void parseSensorStateMessage(const std::span<uint8_t> bytes,
+                             const SensorDefinitionMap& sensorDefinition,
+                             SensorValueFunction function) {
+  if (const auto message = spymarine::parseMessage(bytes);
+      message && message->type == spymarine::MessageType::sensorState) {
+    spymarine::parseValues(
+        message->data,
+        [&](const SensorId id, const spymarine::Number number) {
+          const auto it = sensorDefinition.find(id);
+          if (it != sensorDefinition.end()) {
+            function(id, spymarine::sensorValue(it->second, number));
+          }
+        },
+        [](const SensorId, const std::string_view) {});
+  }
+}
+
+// Replays every frame kReplayRepeats times in a row as the Pico does,
+// kReplayInterval apart
+constexpr size_t kReplayRepeats = 4;
+constexpr auto kReplayInterval = std::chrono::milliseconds{250};
+
+/* Decodes the frames of a replay with deduplication like the receiver task
+ * and returns the sum of all raw values. The clock continues across calls so
+ * the first copy of a frame is accepted again in the next round.
+ */
+int64_t parseReplay(const std::vector<std::vector<uint8_t>>& replay,
+                    FrameDeduplicator* deduplicator,
+                    FrameDeduplicator::Clock::time_point& now) {
+  std::array<spymarine::SensorReading, 256> output;
+  spymarine::ParseCounters counters;
+  int64_t sum = 0;
+  for (const auto& frame : replay) {
+    now += kReplayInterval;
+    if (deduplicator && deduplicator->isDuplicate(frame, now)) {
+      continue;
+    }
+    const auto readings = spymarine::decodeSensorState(
+        frame, kLargeSensorDefinition, output, counters);
+    if (!readings) {
+      continue;
+    }
+    if (deduplicator) {
+      deduplicator->accept(frame, now);
+    }
+    for (const auto& reading : *readings) {
+      sum += reading.raw;
+    }
+  }
+  return sum;
+}
+
+/* Compares the fused decoder with the three stage path of
+ * parseSensorStateMessage for all frames. The raw values of the decoder
+ * have to convert to exactly the same values. Aborts on mismatch.
+ */
+void verifyDecoderEquivalence(const FrameSet& frameSet,
+                              const spymarine::SensorDefinition& definition) {
+  std::array<spymarine::SensorReading, 256> output;
+
+  for (const auto& frame : frameSet.frames) {
+    std::vector<std::pair<SensorId, double>> expected;
+    spymarine::ParseCounters expectedCounters;
+    spymarine::parseSensorStateMessage(
+        frame, definition, expectedCounters,
+        [&](SensorId id, double value) { expected.emplace_back(id, value); });
+
+    spymarine::ParseCounters counters;
+    const auto readings =
+        spymarine::decodeSensorState(frame, definition, output, counters);
+
+    auto matches = readings && readings->size() == expected.size() &&
+                   counters.crcMismatch == expectedCounters.crcMismatch;
+    for (size_t i = 0; matches && i < expected.size(); i++) {
+      const auto& reading = (*readings)[i];
+      matches = reading.id == expected[i].first &&
+                static_cast<double>(reading.raw) /
+                        definition.conversion(reading.id).scale() ==
+                    expected[i].second;
+    }
+    if (!matches &&
+        expectedCounters.badMagic + expectedCounters.lengthMismatch +
+                expectedCounters.crcMismatch ==
+            0) {
+      std::fprintf(stderr, "Decoder mismatch for %s\n", frameSet.name.c_str());
+      std::abort();
+    }
+  }
+}
+
+// A sensor of every type with a known number and its expected value
+struct GoldenSensor {
+  SensorType type;
+  int16_t firstWord;
+  int16_t secondWord;
+  double value;
+};
+
+constexpr std::array<GoldenSensor, spymarine::kSensorTypeCount>
+    kGoldenSensors{{
+        {SensorType::charge, 0, 12000, 0.75},
+        {SensorType::current, -1234, 0, -12.34},
+        {SensorType::voltage, 12650, 0, 12.65},
+        {SensorType::temperature, -55, 0, -5.5},
+        {SensorType::tankLevel, 625, 0, 0.625},
+        {SensorType::tankVolume, 0, 1234, 123.4},
+        {SensorType::pressure, 2500, 0, 2.5},
+        // 101325 Pa
+        {SensorType::barometer, static_cast<int16_t>(0x8bcd), 1, 1013.25},
+        {SensorType::resistance, static_cast<int16_t>(40000), 0, 40000},
+        {SensorType::capacity, 10050, 0, 100.5},
+        {SensorType::power, -1234, 0, -12.34},
+        {SensorType::energy, 4321, 0, 43.21},
+        {SensorType::chargeRate, -250, 0, -0.025},
+        {SensorType::duration, 4250, 0, 42.5},
+    }};
+
+/* Converts a frame with a sensor of every type, as plain and as extended
+ * numbers, with both decoders and compares the values with kGoldenSensors.
+ * Aborts on mismatch.
+ */
+void verifySensorConversions() {
+  spymarine::SensorDefinition definition;
+  FrameBuilder builder;
+  for (size_t i = 0; i < kGoldenSensors.size(); i++) {
+    const auto& sensor = kGoldenSensors[i];
+    const auto id = static_cast<SensorId>(i);
+    const auto extendedId = static_cast<SensorId>(i + kGoldenSensors.size());
+    definition.add(id, sensor.type);
+    definition.add(extendedId, sensor.type);
+    builder.addNumber(id, sensor.firstWord, sensor.secondWord);
+    builder.addExtendedNumber(extendedId, sensor.firstWord, sensor.secondWord);
+  }
+  const auto frame = builder.build();
+
+  const auto check = [](SensorId id, double value) {
+    const auto& sensor = kGoldenSensors[id % kGoldenSensors.size()];
+    if (value != sensor.value) {
+      std::fprintf(stderr,
+                   "Sensor %d of type %d converted to %f, expected %f\n", id,
+                   static_cast<int>(sensor.type), value, sensor.value);
+      std::abort();
+    }
+  };
+
+  spymarine::ParseCounters counters;
+  size_t count = 0;
+  spymarine::parseSensorStateMessage(frame, definition, counters,
+                                     [&](SensorId id, double value) {
+                                       check(id, value);
+                                       count++;
+                                     });
+
+  std::array<spymarine::SensorReading, 256> output;
+  const auto readings =
+      spymarine::decodeSensorState(frame, definition, output, counters);
+  if (readings) {
+    for (const auto& reading : *readings) {
+      check(reading.id, static_cast<double>(reading.raw) /
+                            definition.conversion(reading.id).scale());
+      count++;
+    }
+  }
+
+  if (count != 4 * kGoldenSensors.size()) {
+    std::fprintf(stderr, "Only %zu sensor values converted\n", count);
+    std::abort();
+  }
+}
+
+std::string caseName(const FrameSet& frameSet, std::string_view name) {
+  return frameSet.name + "/" + std::string{name};
+}
+
+} // namespace
+
+void runParsingBenchmarks(const FrameSet& frameSet) {
+  verifySensorConversions();
+
+  // parseSensorStateMessage takes mutable bytes
+  auto frames = frameSet.frames;
+
+  run(caseName(frameSet, "parseMessage"), frames.size(), [&] {
+    for (const auto& frame : frames) {
+      doNotOptimize(spymarine::parseMessage(frame));
+    }
+  });
+
+  std::vector<spymarine::Message> messages;
+  for (const auto& frame : frames) {
+    if (const auto message = spymarine::parseMessage(frame)) {
+      messages.push_back(*message);
+    }
+  }
+
+  run(caseName(frameSet, "parseValues"), messages.size(), [&] {
+    for (const auto& message : messages) {
+      size_t count = 0;
+      spymarine::parseValues(
+          message.data,
+          [&](uint8_t, spymarine::Number number) {
+            count += number.firstWord();
+          },
+          [&](uint8_t, std::string_view str) { count += str.size(); });
+      doNotOptimize(count);
+    }
+  });
+
+  const auto benchmarkSensorState = [&](std::string_view name,
+                                       const auto& sensorDefinition) {
+    run(caseName(frameSet, name), frames.size(), [&] {
+      for (auto& frame : frames) {
+        double sum = 0;
+        parseSensorStateMessage(
+            frame, sensorDefinition,
+            [&](SensorId, double value) { sum += value; });
+        doNotOptimize(sum);
+      }
+    });
+  };
+
+  benchmarkSensorState("parseSensorStateMessage/4", kSensorDefinition);
+  benchmarkSensorState("parseSensorStateMessage/64", kLargeSensorDefinition);
+  benchmarkSensorState("parseSensorStateMessage/map/4",
+                       toMap(kSensorDefinition));
+  benchmarkSensorState("parseSensorStateMessage/map/64",
+                       toMap(kLargeSensorDefinition));
+
+  const auto benchmarkDecoder = [&](std::string_view name,
+                                    const spymarine::SensorDefinition&
+                                        sensorDefinition) {
+    verifyDecoderEquivalence(frameSet, sensorDefinition);
+
+    std::array<spymarine::SensorReading, 256> output;
+    spymarine::ParseCounters counters;
+    run(caseName(frameSet, name), frames.size(), [&] {
+      for (const auto& frame : frames) {
+        int64_t sum = 0;
+        if (const auto readings = spymarine::decodeSensorState(
+                frame, sensorDefinition, output, counters)) {
+          for (const auto& reading : *readings) {
+            sum += reading.raw;
+          }
+        }
+        doNotOptimize(sum);
+      }
+    });
+  };
+
+  benchmarkDecoder("decodeSensorState/4", kSensorDefinition);
+  benchmarkDecoder("decodeSensorState/64", kLargeSensorDefinition);
+
+  // Recorded frames may already repeat, the replay adds repeats of its own.
+  // Each frame is also preceded by a copy with a corrupted value but the
+  // same trailing CRC, which must not suppress the valid frame.
+  std::vector<std::vector<uint8_t>> distinctFrames;
+  std::vector<std::vector<uint8_t>> replay;
+  std::vector<std::vector<uint8_t>> corruptedReplay;
+  for (const auto& frame : frames) {
+    if (std::find(distinctFrames.begin(), distinctFrames.end(), frame) ==
+        distinctFrames.end()) {
+      distinctFrames.push_back(frame);
+      replay.insert(replay.end(), kReplayRepeats, frame);
+      corruptedReplay.push_back(frame);
+      corruptedReplay.back()[spymarine::kHeaderLength] ^= 0x01;
+      corruptedReplay.push_back(frame);
+    }
+  }
+
+  // Deduplication must see every distinct frame exactly once per round
+  FrameDeduplicator::Clock::time_point now;
+  FrameDeduplicator deduplicator{std::chrono::seconds{1}};
+  const auto expected = parseReplay(distinctFrames, nullptr, now);
+  FrameDeduplicator corruptedDeduplicator{std::chrono::seconds{1}};
+  if (parseReplay(replay, &deduplicator, now) != expected ||
+      deduplicator.counters().accepted != distinctFrames.size() ||
+      parseReplay(corruptedReplay, &corruptedDeduplicator, now) != expected ||
+      corruptedDeduplicator.counters().accepted != distinctFrames.size()) {
+    std::fprintf(stderr, "Deduplication mismatch for %s\n",
+                 frameSet.name.c_str());
+    std::abort();
+  }
+
+  run(caseName(frameSet, "replay/decodeSensorState"), replay.size(),
+      [&] { doNotOptimize(parseReplay(replay, nullptr, now)); });
+  run(caseName(frameSet, "replay/deduplicated"), replay.size(),
+      [&] { doNotOptimize(parseReplay(replay, &deduplicator, now)); });
+}
+
+} // namespace benchmark
@@ -0,0 +1,318 @@
+#include "Benchmark.hpp"
+
+#include "SensorTopics.hpp"
+#include "SensorValuesBinary.hpp"
+#include "SensorValuesJson.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+
+namespace benchmark {
+
+namespace {
+
+// The JSON writer as it was before it stopped using snprintf, reduced to
+// what's needed for sensor values
+class SnprintfJsonWriter {
+public:
+  explicit SnprintfJsonWriter(JsonBuffer& buffer) : mBuffer{buffer} {}
+
+  void startArray() {
+    handleComma();
+    writeChar('[');
+    mCommaRequired = false;
+  }
+
+  void endArray() {
+    writeChar(']');
+    mCommaRequired = true;
+  }
+
+  void startObject() {
+    handleComma();
+    writeChar('{');
+    mCommaRequired = false;
+  }
+
+  void endObject() {
+    writeChar('}');
+    mCommaRequired = true;
+    mExpectObjectValue = false;
+  }
+
+  void addObjectKey(std::string_view key) {
+    handleComma();
+    writeChar('"');
+    writeData(key);
+    writeChar('"');
+    writeChar(':');
+    mCommaRequired = true;
+    mExpectObjectValue = true;
+  }
+
+  void addInt(int value) {
+    handleCommaForValue();
+    writeFormattedValue("%d", value);
+    mCommaRequired = true;
+  }
+
+  void addDouble(double value) {
+    handleCommaForValue();
+    writeFormattedValue("%g", value);
+    mCommaRequired = true;
+  }
+
+  std::string_view string() const { return {mBuffer.data(), mPos}; }
+
+private:
+  void writeData(std::span<const char> data) {
+    reserve(data.size());
+    std::copy(data.begin(), data.end(), mBuffer.begin() + mPos);
+    mPos += data.size();
+  }
+
+  void writeChar(char c) { writeData(std::array<const char, 1>{c}); }
+
+  template <typename T>
+  void writeFormattedValue(const char* formatString, T value) {
+    auto write = [&]() {
+      std::span<char> writeBuffer{mBuffer.data() + mPos,
+                                  mBuffer.size() - mPos + 1};
+      return std::snprintf(writeBuffer.data(), writeBuffer.size(),
+                           formatString, value);
+    };
+
+    const auto length = write();
+    if (reserve(length)) {
+      write();
+    }
+    mPos += length;
+  }
+
+  bool reserve(size_t size) {
+    if (mBuffer.size() - mPos < size) {
+      mBuffer.resize(mPos + size);
+      return true;
+    }
+    return false;
+  }
+
+  void handleCommaForValue() {
+    if (!mExpectObjectValue) {
+      handleComma();
+      mExpectObjectValue = false;
+    }
+  }
+
+  void handleComma() {
+    if (mCommaRequired) {
+      writeChar(',');
+    }
+  }
+
+  JsonBuffer& mBuffer;
+  size_t mPos{0};
+  bool mCommaRequired{false};
+  bool mExpectObjectValue{false};
+};
+
+void writeSensorValues(SnprintfJsonWriter& writer,
+                       std::span<const SensorValue> values) {
+  writer.startArray();
+  for (const auto& value : values) {
+    writer.startObject();
+    writer.addObjectKey("sensor_id");
+    writer.addInt(value.id);
+    writer.addObjectKey("value");
+    writer.addDouble(value.mean());
+    writer.endObject();
+  }
+  writer.endArray();
+}
+
+// Items are publishes, also reports the payload size and the serialized
+// bytes per second
+template <typename Function>
+void benchmarkPublish(std::string_view name, Function function) {
+  const auto bytes = function().size();
+  const auto result = run(name, 1, [&] { doNotOptimize(function()); });
+  std::printf("%-48s %14.0f bytes/s %5zu bytes/publish\n", "",
+              result.itemsPerSecond * bytes, bytes);
+}
+
+// Aborts if decoding the binary payload doesn't give back the values within
+// the resolution of the sensor types
+void verifyBinaryRoundTrip(std::span<const SensorValue> values,
+                           const spymarine::SensorDefinition& definition) {
+  std::array<uint8_t, sensorValuesBinarySize(255)> buffer;
+  const auto payload = writeSensorValuesBinary(buffer, values, definition, 42);
+
+  size_t index = 0;
+  const auto timestamp = readSensorValuesBinary(
+      *payload, [&](spymarine::SensorId id, spymarine::SensorType type,
+                    double value) {
+        const auto& expected = values[index++];
+        const auto resolution = 1.0 / spymarine::sensorBinaryScale(type);
+        if (id != expected.id || type != *definition.find(id) ||
+            std::fabs(value - expected.mean()) > resolution / 2) {
+          std::fprintf(stderr, "Binary round trip failed for sensor %d\n", id);
+          std::abort();
+        }
+      });
+
+  if (timestamp != 42u || index != values.size()) {
+    std::fprintf(stderr, "Binary round trip failed\n");
+    std::abort();
+  }
+}
+
+/* Aborts unless running totals of derived integrals round trip: 500 Ah of
+ * capacity within the binary range and 40 kWh, which don't fit, saturated
+ */
+void verifyBinaryTotals() {
+  constexpr spymarine::SensorDefinition kDefinition{
+      {201, spymarine::SensorType::capacity},
+      {202, spymarine::SensorType::energy},
+  };
+  const SensorValue capacity[] = {
+      {201, 1, 100, 50'000, 50'000, 50'000, 50'000, 0.0, 0, 0},
+      {201, 1, 100, -50'000, -50'000, -50'000, -50'000, 0.0, 0, 0},
+  };
+  verifyBinaryRoundTrip(capacity, kDefinition);
+
+  const SensorValue energy[] = {
+      {202, 1, 100, 4'000'000, 4'000'000, 4'000'000, 4'000'000, 0.0, 0, 0},
+      {202, 1, 100, -4'000'000, -4'000'000, -4'000'000, -4'000'000, 0.0, 0,
+       0},
+      {202, 1, 100, 3'276'700, 3'276'700, 3'276'700, 3'276'700, 0.0, 0, 0},
+  };
+  std::array<uint8_t, sensorValuesBinarySize(3)> buffer;
+  const auto payload = writeSensorValuesBinary(buffer, energy, kDefinition, 0);
+  const double expected[] = {std::numeric_limits<double>::infinity(),
+                             -std::numeric_limits<double>::infinity(),
+                             32767.0};
+  size_t index = 0;
+  readSensorValuesBinary(
+      *payload, [&](spymarine::SensorId, spymarine::SensorType type,
+                    double value) {
+        if (type != spymarine::SensorType::energy ||
+            value != expected[index]) {
+          std::fprintf(stderr, "Binary total %zu not saturated\n", index);
+          std::abort();
+        }
+        index++;
+      });
+  if (index != std::size(expected)) {
+    std::fprintf(stderr, "Binary totals not decoded\n");
+    std::abort();
+  }
+}
+
+// Aborts if a topic isn't "/sensors/<id>/<type>"
+void verifySensorTopics(const SensorTopics& topics) {
+  const auto check = [&](spymarine::SensorId id, const char* expected) {
+    const auto topic = topics.topic(id);
+    if (!topic || std::strcmp(topic, expected) != 0) {
+      std::fprintf(stderr, "Wrong topic for sensor %d\n", id);
+      std::abort();
+    }
+  };
+  check(26, "/sensors/26/charge");
+  check(35, "/sensors/35/voltage");
+  check(255, "/sensors/255/temperature");
+  if (topics.topic(0)) {
+    std::fprintf(stderr, "Topic for undefined sensor 0\n");
+    std::abort();
+  }
+}
+
+} // namespace
+
+void runPayloadBenchmarks() {
+  // Sums of 60 samples in raw units, received over a minute
+  const SensorValue values[] = {
+      {26, 60, 16000, 955200, 15840, 16000, 15920, 0.0001, 0, 59000},
+      {27, 60, 100, -2831, -1250, 320, -40, 4.2, 0, 59000},
+      {33, 60, 16000, 838320, 13920, 14000, 13968, 0.00002, 0, 59000},
+      {35, 60, 1000, 795420, 13100, 13400, 13250, 0.01, 0, 59000},
+  };
+
+  JsonBuffer buffer;
+  std::array<char, 4096> fixedBuffer;
+
+  benchmarkPublish("json/sensorValues/snprintf", [&] {
+    SnprintfJsonWriter writer{buffer};
+    writeSensorValues(writer, values);
+    return writer.string();
+  });
+
+  benchmarkPublish("json/sensorValues/growable", [&] {
+    JsonWriter writer{buffer};
+    writeSensorValuesJson(writer, values);
+    return writer.string();
+  });
+
+  benchmarkPublish("json/sensorValues/fixed", [&] {
+    JsonWriter writer{fixedBuffer};
+    writeSensorValuesJson(writer, values);
+    return writer.string();
+  });
+
+  benchmarkPublish("json/sensorValues/fixed/statistics", [&] {
+    JsonWriter writer{fixedBuffer};
+    writeSensorValuesJson(writer, values, true);
+    return writer.string();
+  });
+
+  constexpr spymarine::SensorDefinition kSensorDefinition{
+      {26, spymarine::SensorType::charge},
+      {27, spymarine::SensorType::current},
+      {33, spymarine::SensorType::charge},
+      {35, spymarine::SensorType::voltage},
+  };
+  verifyBinaryRoundTrip(values, kSensorDefinition);
+  verifyBinaryTotals();
+
+  // Items are per sensor publishes, the topic and payload of each value
+  auto topicDefinition = kSensorDefinition;
+  topicDefinition.add(255, spymarine::SensorType::temperature);
+  const auto topics = std::make_unique<SensorTopics>(topicDefinition);
+  verifySensorTopics(*topics);
+
+  run("perSensor/snprintf", std::size(values), [&] {
+    for (const auto& value : values) {
+      std::array<char, SensorTopics::kMaxTopicSize> topic;
+      std::array<char, 32> payload;
+      const auto type = *kSensorDefinition.find(value.id);
+      std::snprintf(topic.data(), topic.size(), "/sensors/%d/%s", value.id,
+                    spymarine::kSensorTypeNames[static_cast<size_t>(type)]);
+      std::snprintf(payload.data(), payload.size(), "%g", value.mean());
+      doNotOptimize(topic);
+      doNotOptimize(payload);
+    }
+  });
+
+  run("perSensor/prebuilt", std::size(values), [&] {
+    for (const auto& value : values) {
+      std::array<char, 32> payload;
+      JsonWriter writer{payload};
+      writeSensorValueJson(writer, value);
+      doNotOptimize(topics->topic(value.id));
+      doNotOptimize(writer.string());
+    }
+  });
+
+  std::array<uint8_t, sensorValuesBinarySize(255)> binaryBuffer;
+  benchmarkPublish("binary/sensorValues", [&] {
+    return *writeSensorValuesBinary(binaryBuffer, values, kSensorDefinition,
+                                    1700000000);
+  });
+}
+
+} // namespace benchmark
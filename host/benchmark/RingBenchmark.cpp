@@ -0,0 +1,65 @@
+#include "Benchmark.hpp"
+
+#include "SensorAggregator.hpp"
+#include "SpscRing.hpp"
+
+#include <cstdlib>
+#include <thread>
+
+namespace benchmark {
+
+namespace {
+
+/* Moves samples through the ring from a producer to a consumer thread, both
+ * yielding on a full or empty ring. Aborts if a sample is lost, duplicated or
+ * reordered.
+ */
+template <size_t Capacity> void benchmarkRing(std::string_view name) {
+  constexpr uint32_t kSampleCount = 5'000'000;
+
+  SpscRing<SensorSample, Capacity> ring;
+
+  const auto start = std::chrono::steady_clock::now();
+
+  std::thread producer{[&] {
+    for (uint32_t i = 0; i < kSampleCount; i++) {
+      const SensorSample sample{static_cast<int32_t>(i), i,
+                                static_cast<spymarine::SensorId>(i),
+                                static_cast<uint16_t>(i)};
+      while (!ring.push(sample)) {
+        std::this_thread::yield();
+      }
+    }
+  }};
+
+  for (uint32_t expected = 0; expected < kSampleCount;) {
+    if (const auto sample = ring.pop()) {
+      if (sample->timestamp != expected ||
+          sample->id != static_cast<spymarine::SensorId>(expected) ||
+          sample->raw != static_cast<int32_t>(expected)) {
+        std::fprintf(stderr, "Ring returned sample %u, expected %u\n",
+                     sample->timestamp, expected);
+        std::abort();
+      }
+      expected++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  producer.join();
+
+  const auto seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  printResult(name, {kSampleCount / seconds, seconds * 1e9 / kSampleCount, 0});
+}
+
+} // namespace
+
+void runRingBenchmarks() {
+  benchmarkRing<4>("ring/spsc/4");
+  benchmarkRing<512>("ring/spsc/512");
+}
+
+} // namespace benchmark
@@ -0,0 +1,160 @@
+#include "Benchmark.hpp"
+
+#include "WindowScheduler.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace benchmark {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// A clock that only moves when the checks move it
+struct FakeClock {
+  using duration = std::chrono::milliseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<FakeClock>;
+  static constexpr bool is_steady = false;
+};
+
+using TimePoint = FakeClock::time_point;
+
+constexpr auto kInterval = std::chrono::milliseconds{60s};
+
+void fail(const char* message, TimePoint time) {
+  std::fprintf(stderr, "Window scheduler check failed: %s at %lld ms\n",
+               message,
+               static_cast<long long>(time.time_since_epoch().count()));
+  std::abort();
+}
+
+bool isAligned(TimePoint time) {
+  return time.time_since_epoch() % kInterval == FakeClock::duration::zero();
+}
+
+/* Wakes up like the aggregating task: when a sample arrives or at the next
+ * boundary, whatever comes first, and always a bit late. Every boundary has
+ * to end exactly one window no later than that wake up latency.
+ */
+void verifyCadence() {
+  constexpr auto kSampleGap = 700ms;
+  constexpr auto kLatency = 3ms;
+
+  auto now = TimePoint{12'345ms};
+  WindowScheduler<FakeClock> scheduler{kInterval, now};
+  if (scheduler.nextBoundary() != TimePoint{60s}) {
+    fail("first boundary not aligned", now);
+  }
+
+  size_t windows = 0;
+  auto previousBoundary = TimePoint{0s};
+  while (now < TimePoint{70min + 12'345ms}) {
+    const auto boundary = scheduler.nextBoundary();
+    const auto timeUntilBoundary = scheduler.timeUntilBoundary(now);
+    if (timeUntilBoundary != std::max(boundary - now, 0ms)) {
+      fail("wrong time until boundary", now);
+    }
+    now += std::min<FakeClock::duration>(timeUntilBoundary, kSampleGap) +
+           kLatency;
+
+    if (!scheduler.advance(now)) {
+      if (now >= boundary) {
+        fail("boundary passed without ending the window", now);
+      }
+      continue;
+    }
+
+    windows++;
+    if (!isAligned(boundary) || now < boundary || now - boundary > kLatency) {
+      fail("window ended off the boundary", now);
+    }
+    if (boundary - previousBoundary != kInterval) {
+      fail("window boundary skipped", now);
+    }
+    previousBoundary = boundary;
+  }
+
+  if (windows != 70) {
+    fail("wrong window count", now);
+  }
+}
+
+// A scheduler started at now
+WindowScheduler<FakeClock> scheduledAt(TimePoint now) {
+  WindowScheduler<FakeClock> scheduler{kInterval, now};
+  if (scheduler.advance(now)) {
+    fail("window ended right after start", now);
+  }
+  return scheduler;
+}
+
+void verifyClockChanges() {
+  // A stall over several boundaries ends one window and skips the others
+  {
+    auto scheduler = scheduledAt(TimePoint{100s});
+    if (!scheduler.advance(TimePoint{330s}) ||
+        scheduler.nextBoundary() != TimePoint{360s}) {
+      fail("missed windows not skipped", TimePoint{330s});
+    }
+    if (scheduler.advance(TimePoint{331s})) {
+      fail("skipped window ended", TimePoint{331s});
+    }
+  }
+
+  // Going back within the window keeps the boundary, going back further
+  // realigns it without ending a window
+  {
+    auto scheduler = scheduledAt(TimePoint{330s});
+    if (scheduler.advance(TimePoint{310s}) ||
+        scheduler.nextBoundary() != TimePoint{360s}) {
+      fail("boundary moved on small step back", TimePoint{310s});
+    }
+    if (scheduler.advance(TimePoint{100s}) ||
+        scheduler.nextBoundary() != TimePoint{120s}) {
+      fail("boundary not realigned after going back", TimePoint{100s});
+    }
+    if (!scheduler.advance(TimePoint{120s}) ||
+        scheduler.nextBoundary() != TimePoint{180s}) {
+      fail("realigned window didn't end", TimePoint{120s});
+    }
+  }
+
+  // SNTP sets the clock from shortly after boot to the wall clock, which
+  // ends the window once and continues on full minutes of the wall clock
+  {
+    auto scheduler = scheduledAt(TimePoint{5s});
+    const auto synchronized = TimePoint{1'700'000'000'123ms};
+    if (!scheduler.advance(synchronized) ||
+        scheduler.nextBoundary() != TimePoint{1'700'000'040'000ms}) {
+      fail("boundary not realigned after SNTP", synchronized);
+    }
+    if (scheduler.advance(synchronized + 30s) ||
+        !scheduler.advance(synchronized + 40s)) {
+      fail("wrong window after SNTP", synchronized + 40s);
+    }
+  }
+}
+
+void verifyWindowScheduler() {
+  verifyCadence();
+  verifyClockChanges();
+}
+
+} // namespace
+
+void runSchedulerBenchmarks() {
+  verifyWindowScheduler();
+
+  // Items are wake ups of the aggregating task 10 ms apart
+  WindowScheduler<FakeClock> scheduler{kInterval, TimePoint{}};
+  auto now = TimePoint{};
+  run("scheduler/advance", 1, [&] {
+    now += 10ms;
+    doNotOptimize(scheduler.advance(now));
+  });
+}
+
+} // namespace benchmark
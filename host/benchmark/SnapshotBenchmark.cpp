@@ -0,0 +1,312 @@
+#include "Benchmark.hpp"
+
+#include "JsonWriter.hpp"
+#include "QueryServer.hpp"
+#include "SensorSnapshot.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace benchmark {
+
+namespace {
+
+constexpr uint16_t kPort = 43298;
+
+// kQueryBufferSize of AppMain
+constexpr size_t kQueryBufferSize = 6144;
+
+// More sensors than the snapshot holds
+constexpr auto kSensorDefinition = [] {
+  spymarine::SensorDefinition definition;
+  for (unsigned id = 0; id < LatestSensorValues::kCapacity + 8; id++) {
+    definition.add(static_cast<spymarine::SensorId>(id),
+                   spymarine::SensorType::voltage);
+  }
+  return definition;
+}();
+
+void fail(const char* message, size_t detail) {
+  std::fprintf(stderr, "Snapshot check failed: %s (%zu)\n", message, detail);
+  std::abort();
+}
+
+// Every sample and window of the given generation carries its number
+void writeGeneration(SensorSnapshot& snapshot, uint32_t generation) {
+  std::array<SensorValue, LatestSensorValues::kCapacity> windows;
+  for (uint32_t id = 0; id < LatestSensorValues::kCapacity; id++) {
+    const auto sensorId = static_cast<spymarine::SensorId>(id);
+    const auto raw = static_cast<int32_t>(generation);
+    snapshot.updateSample({raw, generation, sensorId, 0});
+    windows[id] = {sensorId,
+                   generation,
+                   1000,
+                   raw,
+                   raw,
+                   raw,
+                   raw,
+                   0.0,
+                   generation,
+                   generation};
+  }
+  snapshot.updateWindow(windows);
+  snapshot.publish();
+}
+
+// Returns the generation of the values or fails if they mix generations
+uint32_t checkGeneration(const LatestSensorValues& values) {
+  if (values.count != LatestSensorValues::kCapacity) {
+    fail("wrong sensor count", values.count);
+  }
+  const auto generation = values.sensors[0].timestamp;
+  for (size_t i = 0; i < values.count; i++) {
+    const auto& value = values.sensors[i];
+    const auto& window = value.window;
+    if (value.id != i || value.samples != generation ||
+        value.timestamp != generation ||
+        value.raw != static_cast<int32_t>(generation) ||
+        window.count != generation || window.lastTimestamp != generation ||
+        window.sum != static_cast<int32_t>(generation) ||
+        window.max != static_cast<int32_t>(generation)) {
+      fail("torn read of generation", generation);
+    }
+  }
+  return generation;
+}
+
+struct ReaderResult {
+  size_t reads{0};
+  size_t retries{0};
+};
+
+/* Publishes new generations, as fast as possible or with a pause after each
+ * one, while the readers read the snapshot. Every successful read has to be
+ * a single generation and a reader must never see an older generation than
+ * before. Items are successful reads of all readers.
+ */
+void hammerSnapshot(size_t readerCount, std::chrono::microseconds pause) {
+  constexpr auto kDuration = std::chrono::milliseconds{500};
+
+  const auto snapshot = std::make_unique<SensorSnapshot>(kSensorDefinition);
+  std::atomic<bool> done{false};
+  std::vector<ReaderResult> results(readerCount);
+
+  std::vector<std::thread> readers;
+  for (size_t i = 0; i < readerCount; i++) {
+    readers.emplace_back([&, i] {
+      const auto values = std::make_unique<LatestSensorValues>();
+      uint32_t previous = 0;
+      auto& result = results[i];
+      while (!done.load(std::memory_order_relaxed)) {
+        if (!snapshot->read(*values)) {
+          result.retries++;
+          continue;
+        }
+        const auto generation = checkGeneration(*values);
+        if (generation < previous) {
+          fail("generation went back from", previous);
+        }
+        previous = generation;
+        result.reads++;
+      }
+    });
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  uint32_t generation = 0;
+  while (std::chrono::steady_clock::now() - start < kDuration) {
+    writeGeneration(*snapshot, ++generation);
+    if (pause.count() > 0) {
+      std::this_thread::sleep_for(pause);
+    }
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  const auto seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  ReaderResult total;
+  for (const auto& result : results) {
+    total.reads += result.reads;
+    total.retries += result.retries;
+  }
+  printResult("snapshot/read/" + std::to_string(readerCount) + "readers/" +
+                  (pause.count() > 0 ? "paced" : "busy"),
+              {total.reads / seconds, seconds * 1e9 / total.reads, 0});
+  std::printf("%-48s %7.0f writes/s, %.1f%% of reads retried\n", "",
+              generation / seconds,
+              100.0 * total.retries / (total.reads + total.retries));
+}
+
+/* The reply with the largest values of all sensors of the snapshot stays
+ * within latestSensorValuesJsonSize and fits the buffer of AppMain. A scale
+ * of 7 yields all fractional digits.
+ */
+void verifyQueryReply() {
+  auto values = std::make_unique<LatestSensorValues>();
+  values->count = LatestSensorValues::kCapacity;
+  for (size_t i = 0; i < values->count; i++) {
+    values->sensors[i] = {255, 7, UINT32_MAX, INT32_MIN, 0,
+                          {255, UINT32_MAX, 7, int64_t{INT32_MIN} * UINT32_MAX,
+                           INT32_MIN, INT32_MIN, INT32_MIN, 0.0, 0, 0}};
+  }
+
+  constexpr auto kMaxSize =
+      latestSensorValuesJsonSize(LatestSensorValues::kCapacity);
+  static_assert(kQueryBufferSize >= kMaxSize);
+  std::array<char, kQueryBufferSize> buffer;
+  JsonWriter writer{buffer};
+  writeLatestSensorValuesJson(writer, *values, UINT32_MAX);
+  if (writer.overflow() || writer.string().size() > kMaxSize) {
+    fail("reply larger than bytes", kMaxSize);
+  }
+}
+
+/* Each sender gets a reply once per interval, all senders together up to
+ * the limit per second, and the oldest sender is forgotten when the table
+ * is full
+ */
+void verifyQueryLimiter() {
+  using namespace std::chrono_literals;
+  QueryLimiter limiter{500ms, 4};
+  const QueryLimiter::Clock::time_point start{10s};
+
+  if (!limiter.allow(1, start) || limiter.allow(1, start + 499ms) ||
+      !limiter.allow(1, start + 500ms)) {
+    fail("sender interval not applied, sender", 1);
+  }
+  if (!limiter.allow(2, start + 600ms) || !limiter.allow(3, start + 700ms) ||
+      limiter.allow(4, start + 800ms)) {
+    fail("replies per second not limited, sender", 4);
+  }
+  if (!limiter.allow(4, start + 1s)) {
+    fail("limit not reset after a second, sender", 4);
+  }
+
+  // Senders 10 to 17 push 1 out of the full table, so it's answered again
+  // within its interval
+  QueryLimiter wideLimiter{500ms, 100};
+  wideLimiter.allow(1, start);
+  for (uint32_t address = 10; address < 18; address++) {
+    if (!wideLimiter.allow(address, start + (address - 9) * 1ms)) {
+      fail("new sender limited", address);
+    }
+  }
+  if (!wideLimiter.allow(1, start + 100ms) ||
+      wideLimiter.allow(17, start + 100ms)) {
+    fail("wrong sender forgotten", 1);
+  }
+}
+
+/* Round trips of queries over loopback to a QueryServer answering from the
+ * snapshot like the query task of AppMain. Items are answered queries.
+ */
+void benchmarkQueries() {
+  constexpr size_t kQueryCount = 20'000;
+
+  const auto snapshot = std::make_unique<SensorSnapshot>(kSensorDefinition);
+  writeGeneration(*snapshot, 1);
+
+  // A single sender, only limited by the round trips
+  QueryServer server{"latest", {std::chrono::seconds{0}, UINT32_MAX}};
+  if (!server.bind(kPort)) {
+    std::fprintf(stderr, "Couldn't bind UDP port %d\n", kPort);
+    return;
+  }
+
+  std::thread serverThread{[&] {
+    const auto values = std::make_unique<LatestSensorValues>();
+    std::array<char, kQueryBufferSize> buffer;
+    for (size_t i = 0; i < kQueryCount; i++) {
+      server.receive();
+      while (!snapshot->read(*values)) {
+      }
+      JsonWriter writer{buffer};
+      writeLatestSensorValuesJson(writer, *values, 1);
+      server.reply(writer.string());
+    }
+  }};
+
+  const auto client = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(kPort);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  // Other datagrams aren't answered
+  for (const std::string_view datagram : {"?", "lates", "latest\n"}) {
+    sendto(client, datagram.data(), datagram.size(), 0,
+           reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+  }
+
+  std::array<char, kQueryBufferSize> reply;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kQueryCount; i++) {
+    sendto(client, "latest", 6, 0,
+           reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    const auto size = recv(client, reply.data(), reply.size(), 0);
+    if (size <= 0 ||
+        std::string_view{reply.data(), static_cast<size_t>(size)}.find(
+            R"({"sensor_id":31,"value":0.001,"age_ms":0,"mean":0.001,)") ==
+            std::string_view::npos) {
+      fail("wrong reply to query", i);
+    }
+  }
+  const auto seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+
+  serverThread.join();
+  close(client);
+  if (server.ignored() != 3) {
+    fail("datagrams that aren't queries answered, ignored", server.ignored());
+  }
+
+  printResult("snapshot/query/loopback",
+              {kQueryCount / seconds, seconds * 1e9 / kQueryCount, 0});
+}
+
+} // namespace
+
+void runSnapshotBenchmarks() {
+  verifyQueryReply();
+  verifyQueryLimiter();
+
+  // The aggregating task publishes a few times per second, the paced
+  // writer still publishes about a thousand times as often
+  for (const auto pause :
+       {std::chrono::microseconds{0}, std::chrono::microseconds{100}}) {
+    for (const size_t readerCount : {1, 2, 4, 8}) {
+      hammerSnapshot(readerCount, pause);
+    }
+  }
+
+  // Items are reads of a snapshot that isn't written meanwhile
+  const auto snapshot = std::make_unique<SensorSnapshot>(kSensorDefinition);
+  writeGeneration(*snapshot, 1);
+  const auto values = std::make_unique<LatestSensorValues>();
+  run("snapshot/read/idle", 1, [&] {
+    doNotOptimize(snapshot->read(*values));
+  });
+  run("snapshot/updateSample", 1, [&] {
+    snapshot->updateSample({1, 2, 3, 4});
+  });
+  run("snapshot/publish", 1, [&] { snapshot->publish(); });
+
+  benchmarkQueries();
+}
+
+} // namespace benchmark
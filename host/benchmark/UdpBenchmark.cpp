@@ -0,0 +1,95 @@
+#include "Benchmark.hpp"
+#include "FrameBuilder.hpp"
+
+#include "UdpBroadcastServer.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+
+namespace benchmark {
+
+namespace {
+
+constexpr uint16_t kPort = 43299;
+constexpr size_t kDatagramCount = 200'000;
+
+/* Sends datagrams to the local UDP server as fast as possible while
+ * receiveFunction drains them. Items are sent datagrams, the number of
+ * datagrams that arrived is reported separately since the kernel drops
+ * datagrams if the receiver falls behind.
+ */
+template <typename ReceiveFunction>
+void benchmarkReceive(std::string_view name, const std::vector<uint8_t>& frame,
+                      ReceiveFunction receiveFunction) {
+  UdpBroadcastServer server;
+  if (!server.bind(kPort)) {
+    std::fprintf(stderr, "Couldn't bind UDP port %d\n", kPort);
+    return;
+  }
+
+  const auto sender = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(kPort);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  const auto start = std::chrono::steady_clock::now();
+
+  std::thread senderThread{[&] {
+    for (size_t i = 0; i < kDatagramCount; i++) {
+      sendto(sender, frame.data(), frame.size(), 0,
+             reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    }
+  }};
+
+  size_t received = 0;
+  size_t wakeups = 0;
+  // Stops once nothing arrived for a while after the sender finished
+  while (receiveFunction(server, received)) {
+    wakeups++;
+  }
+
+  senderThread.join();
+  close(sender);
+
+  const auto seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  printResult(name, {kDatagramCount / seconds, seconds * 1e9 / kDatagramCount,
+                     0});
+  std::printf("%-48s %7zu of %zu received, %.2f datagrams/wakeup\n", "",
+              received, kDatagramCount,
+              static_cast<double>(received) / std::max<size_t>(wakeups, 1));
+}
+
+} // namespace
+
+void runUdpBenchmarks(const FrameSet& frameSet) {
+  const auto& frame = frameSet.frames.front();
+  constexpr std::chrono::milliseconds kIdleTimeout{200};
+
+  benchmarkReceive(
+      frameSet.name + "/udp/receiveBatch", frame,
+      [&, batch = FrameBatch{16, 1024}](UdpBroadcastServer& server,
+                                        size_t& received) mutable {
+        server.receiveBatch(batch, kIdleTimeout);
+        received += batch.frames().size();
+        return !batch.frames().empty();
+      });
+
+  // Single datagram per wakeup, like receive() but with the idle timeout
+  // needed to end the benchmark
+  benchmarkReceive(frameSet.name + "/udp/receive", frame,
+                   [&, batch = FrameBatch{1, 1024}](
+                       UdpBroadcastServer& server, size_t& received) mutable {
+                     server.receiveBatch(batch, kIdleTimeout);
+                     received += batch.frames().size();
+                     return !batch.frames().empty();
+                   });
+}
+
+} // namespace benchmark
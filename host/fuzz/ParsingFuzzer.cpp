@@ -0,0 +1,109 @@
+#include "spymarine/Parsing.hpp"
+#include "spymarine/Sensor.hpp"
+#include "spymarine/SensorStateDecoder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <cstdlib>
+
+namespace {
+
+// Every id is a sensor so that all values are converted
+constexpr auto kSensorDefinition = [] {
+  spymarine::SensorDefinition definition;
+  for (unsigned id = 0; id < 256; id++) {
+    definition.add(static_cast<spymarine::SensorId>(id),
+                   static_cast<spymarine::SensorType>(
+                       id % spymarine::kSensorTypeCount));
+  }
+  return definition;
+}();
+
+uint32_t total(const spymarine::ParseCounters& counters) {
+  return counters.badMagic + counters.lengthMismatch + counters.crcMismatch +
+         counters.truncatedValue + counters.unknownValueType;
+}
+
+} // namespace
+
+/* Feeds arbitrary bytes to the parser as a frame and as message data.
+ * Out of bounds reads are caught by the sanitizers, a rejected message has
+ * to be counted exactly once and the fused decoder has to agree with the
+ * three stage path.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  const std::span<const uint8_t> bytes{data, size};
+
+  spymarine::ParseCounters counters;
+  const auto message = spymarine::parseMessage(bytes, counters);
+  if (message.has_value() == (total(counters) != 0)) {
+    std::abort();
+  }
+
+  size_t sum = 0;
+  double valueSum = 0;
+  const auto numberFunction = [&](uint8_t id, spymarine::Number number) {
+    sum += id + number.firstWord() + number.secondWord();
+  };
+  const auto stringFunction = [&](uint8_t id, std::string_view string) {
+    sum += id + string.size();
+    for (const auto c : string) {
+      sum += static_cast<uint8_t>(c);
+    }
+  };
+
+  if (message) {
+    spymarine::parseValues(message->data, numberFunction, stringFunction);
+  }
+  spymarine::parseValues(bytes, numberFunction, stringFunction);
+
+  std::vector<std::pair<spymarine::SensorId, double>> expected;
+  spymarine::ParseCounters expectedCounters;
+  spymarine::parseSensorStateMessage(
+      bytes, kSensorDefinition, expectedCounters,
+      [&](spymarine::SensorId id, double value) {
+        sum += id;
+        valueSum += value;
+        expected.emplace_back(id, value);
+      });
+
+  std::array<spymarine::SensorReading, 256> output;
+  spymarine::ParseCounters decoderCounters;
+  const auto readings = spymarine::decodeSensorState(bytes, kSensorDefinition,
+                                                     output, decoderCounters);
+  if (message && message->type == spymarine::MessageType::sensorState) {
+    if (!readings ||
+        readings->size() != std::min(expected.size(), output.size()) ||
+        decoderCounters.truncatedValue != expectedCounters.truncatedValue ||
+        decoderCounters.unknownValueType != expectedCounters.unknownValueType) {
+      std::abort();
+    }
+    // Raw values are clamped to 32 bits, unsigned values may exceed them
+    for (size_t i = 0; i < readings->size(); i++) {
+      const auto& [id, value] = expected[i];
+      const double scale = kSensorDefinition.conversion(id).scale();
+      const auto clamped =
+          std::clamp(value, std::numeric_limits<int32_t>::min() / scale,
+                     std::numeric_limits<int32_t>::max() / scale);
+      if ((*readings)[i].id != id ||
+          (*readings)[i].raw / scale != clamped) {
+        std::abort();
+      }
+    }
+  } else if (!message && readings && total(decoderCounters) == 0 &&
+             bytes.size() > 6 &&
+             bytes[6] == static_cast<uint8_t>(
+                             spymarine::MessageType::sensorState)) {
+    // A sensor state message rejected by parseMessage must be rejected
+    std::abort();
+  }
+
+  // Keeps the reads from being optimized away
+  volatile auto result = sum + (valueSum > 0);
+  (void)result;
+  return 0;
+}
@@ -0,0 +1,105 @@
+#include "FrameBuilder.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace {
+
+std::vector<std::vector<uint8_t>> seedFrames() {
+  std::vector<std::vector<uint8_t>> frames;
+
+  FrameBuilder empty;
+  frames.push_back(empty.build());
+
+  FrameBuilder values;
+  values.addNumber(1, 100, 200);
+  values.addExtendedNumber(2, -300, 400);
+  values.addString(3, "Battery");
+  values.addNumber(4, 500);
+  frames.push_back(values.build());
+
+  return frames;
+}
+
+// Recalculates length and CRC so a mutated frame reaches value parsing
+void fixFrame(std::vector<uint8_t>& frame) {
+  if (frame.size() < 16) {
+    return;
+  }
+  const auto length = frame.size() - 13;
+  frame[11] = static_cast<uint8_t>(length >> 8);
+  frame[12] = static_cast<uint8_t>(length);
+  const auto crc = spymarine::crc(
+      std::span<const uint8_t>{frame.begin() + 1, frame.end() - 3});
+  frame[frame.size() - 2] = static_cast<uint8_t>(crc >> 8);
+  frame[frame.size() - 1] = static_cast<uint8_t>(crc);
+}
+
+void mutate(std::vector<uint8_t>& frame, std::mt19937& random) {
+  const auto mutations = 1 + random() % 4;
+  for (unsigned i = 0; i < mutations; i++) {
+    const auto position = frame.empty() ? 0 : random() % frame.size();
+    switch (random() % 4) {
+    case 0:
+      if (!frame.empty()) {
+        frame[position] = static_cast<uint8_t>(random());
+      }
+      break;
+    case 1:
+      frame.insert(frame.begin() + position, static_cast<uint8_t>(random()));
+      break;
+    case 2:
+      if (!frame.empty()) {
+        frame.erase(frame.begin() + position);
+      }
+      break;
+    case 3:
+      frame.resize(position);
+      break;
+    }
+  }
+}
+
+} // namespace
+
+/* Usage: simarine_fuzz_parsing [iterations | input files...]
+ *
+ * Driver for compilers without libFuzzer. Runs the given files through the
+ * fuzz target or mutates valid frames for the given number of iterations
+ * (default 1000000). Half of the mutated frames get a valid length and CRC
+ * so that value parsing is reached.
+ */
+int main(int argc, char** argv) {
+  if (argc > 1 && std::strtoul(argv[1], nullptr, 10) == 0) {
+    for (int i = 1; i < argc; i++) {
+      std::ifstream file{argv[i], std::ios::binary};
+      const std::vector<uint8_t> bytes{std::istreambuf_iterator<char>{file},
+                                       std::istreambuf_iterator<char>{}};
+      LLVMFuzzerTestOneInput(bytes.data(), bytes.size());
+    }
+    return EXIT_SUCCESS;
+  }
+
+  const auto iterations =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000ul;
+  const auto seeds = seedFrames();
+  std::mt19937 random{1};
+
+  for (unsigned long i = 0; i < iterations; i++) {
+    auto frame = seeds[random() % seeds.size()];
+    mutate(frame, random);
+    if (random() % 2 == 0) {
+      fixFrame(frame);
+    }
+    LLVMFuzzerTestOneInput(frame.data(), frame.size());
+  }
+
+  std::printf("%lu inputs parsed\n", iterations);
+  return EXIT_SUCCESS;
+}
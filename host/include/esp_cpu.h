@@ -0,0 +1,22 @@
+#pragma once
+
+// Host replacement for the ESP-IDF CPU cycle counter, used by the benchmarks
+// to measure instrumentation the way the firmware does. Counts time stamp
+// counter ticks on x86 and nanoseconds elsewhere.
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+inline uint32_t esp_cpu_get_cycle_count() {
+  return static_cast<uint32_t>(__rdtsc());
+}
+#else
+#include <chrono>
+
+inline uint32_t esp_cpu_get_cycle_count() {
+  return static_cast<uint32_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+}
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+// Host replacement for the ESP-IDF logging macros used by the platform
+// independent sources
+
+#include <cinttypes>
+#include <cstdio>
+
+#define ESP_LOGE(tag, format, ...)                                             \
+  std::fprintf(stderr, "E (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)                                             \
+  std::fprintf(stderr, "W (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)                                             \
+  std::fprintf(stderr, "I (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)                                             \
+  do {                                                                         \
+  } while (false)
@@ -0,0 +1,3 @@
+#pragma once
+
+// Host replacement, sockets are provided by lwip/sockets.h
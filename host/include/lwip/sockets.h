@@ -0,0 +1,10 @@
+#pragma once
+
+// Host replacement for the lwIP socket API, which mirrors BSD sockets
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
@@ -0,0 +1,38 @@
+#include "SensorValuesBinary.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/* Usage: simarine_decode_binary < payload
+ *
+ * Decodes a payload or a batch of payloads published to /sensors/binary or
+ * /sensors/backlog and prints one line per sensor value.
+ */
+int main() {
+  std::vector<uint8_t> payload;
+  for (int c = std::getchar(); c != EOF; c = std::getchar()) {
+    payload.push_back(static_cast<uint8_t>(c));
+  }
+
+  auto valid = !payload.empty();
+  const auto complete =
+      splitSensorValuesBinary(payload, [&](std::span<const uint8_t> bytes) {
+        const auto timestamp = readSensorValuesBinary(
+            bytes, [](spymarine::SensorId id, spymarine::SensorType type,
+                      double value) {
+              std::printf("sensor_id=%d type=%d value=%g\n", id,
+                          static_cast<int>(type), value);
+            });
+        if (timestamp) {
+          std::printf("timestamp=%u\n", *timestamp);
+        }
+        valid = valid && timestamp;
+      });
+
+  if (!complete || !valid) {
+    std::fprintf(stderr, "Invalid payload\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,43 @@
+#include "SimarineClient.hpp"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+/* Usage: simarine_discover address [port]
+ *
+ * Discovers the sensors of the Simarine device (or simarine_standin) at the
+ * IPv4 address like the firmware does at boot and prints the topology hash
+ * and the sensor definition in the format of Config.example.hpp.
+ */
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3) {
+    std::fprintf(stderr, "Usage: simarine_discover address [port]\n");
+    return EXIT_FAILURE;
+  }
+
+  const auto port =
+      argc > 2 ? static_cast<uint16_t>(std::strtoul(argv[2], nullptr, 10))
+               : spymarine::kSimarineTcpPort;
+
+  SimarineClient client;
+  if (!client.connect(argv[1], port, std::chrono::seconds{2})) {
+    return EXIT_FAILURE;
+  }
+
+  const auto discovery = discoverSensors(client);
+  if (!discovery) {
+    return EXIT_FAILURE;
+  }
+
+  std::printf("%zu devices, topology hash %08" PRIx32 "\n",
+              discovery->deviceCount(), discovery->topologyHash());
+  discovery->sensorDefinition().forEach(
+      [](spymarine::SensorId id, spymarine::SensorType type) {
+        std::printf("{%d, spymarine::SensorType::%s},\n", id,
+                    spymarine::kSensorTypeNames[static_cast<size_t>(type)]);
+      });
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,360 @@
+#include "Config.example.hpp"
+#include "FrameCapture.hpp"
+#include "Metrics.hpp"
+#include "PublishBatch.hpp"
+#include "SensorPipeline.hpp"
+#include "WindowScheduler.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  const char* path{nullptr};
+  bool realtime{false};
+  bool quiet{false};
+  PublishBatchPolicy batchPolicy{kPublishBatch};
+};
+
+std::optional<Options> parseOptions(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--realtime") == 0) {
+      options.realtime = true;
+    } else if (std::strcmp(argv[i], "--quiet") == 0) {
+      options.quiet = true;
+    } else if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+      const auto windows = std::atoi(argv[++i]);
+      if (windows < 1) {
+        return std::nullopt;
+      }
+      options.batchPolicy.maxWindows = static_cast<size_t>(windows);
+    } else if (!options.path && argv[i][0] != '-') {
+      options.path = argv[i];
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  if (!options.path) {
+    return std::nullopt;
+  }
+  return options;
+}
+
+// A read only mapping of a whole file
+class MappedFile {
+public:
+  ~MappedFile() {
+    if (mData != MAP_FAILED) {
+      munmap(mData, mSize);
+    }
+  }
+
+  bool open(const char* path) {
+    const auto fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+
+    struct stat status {};
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+      mSize = static_cast<size_t>(status.st_size);
+      mData = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    return mData != MAP_FAILED;
+  }
+
+  std::span<const uint8_t> bytes() const {
+    return {static_cast<const uint8_t*>(mData), mSize};
+  }
+
+private:
+  void* mData{MAP_FAILED};
+  size_t mSize{0};
+};
+
+/* Estimated bytes on the wire to publish a payload with QoS 0 or 1 over TLS
+ * 1.2 with AES-GCM and TCP/IPv4:
+ *
+ *   MQTT fixed header, topic length, topic, packet id with QoS 1 and payload
+ *   29 bytes for the TLS record: 5 header, 8 explicit nonce and 16 tag
+ *   40 bytes of TCP/IP headers per segment of up to 1460 bytes
+ *   40 bytes for the TCP acknowledgement of the broker, which also carries
+ *   the 4 byte PUBACK in its own TLS record with QoS 1
+ */
+size_t wireBytes(const char* topic, size_t payloadSize, int qos) {
+  const auto remainingLength =
+      2 + std::strlen(topic) + (qos > 0 ? 2 : 0) + payloadSize;
+  const auto lengthBytes =
+      remainingLength < 128 ? 1 : (remainingLength < 16384 ? 2 : 3);
+  const auto record = 1 + lengthBytes + remainingLength + 29;
+  const auto segments = (record + 1459) / 1460;
+  return record + 40 * segments + 40 + (qos > 0 ? 4 + 29 : 0);
+}
+
+// Milliseconds since the start of the capture like the receive timestamps
+// of AppMain
+uint32_t sampleTimestamp(Clock::time_point time) {
+  return static_cast<uint32_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          time.time_since_epoch())
+          .count());
+}
+
+/* Counts the publishes of the pipeline and prints them as "<milliseconds
+ * since start> <topic> <payload>", binary payloads in hex. Always connected.
+ */
+class ReplayClient {
+public:
+  struct Counters {
+    size_t publishes{0};
+    size_t publishedBytes{0};
+    size_t wireBytes{0};
+  };
+
+  explicit ReplayClient(bool quiet) : mQuiet{quiet} {}
+
+  // Sets the time of the following publishes
+  void setTime(Clock::time_point now) { mNow = now; }
+
+  bool connected() const { return true; }
+
+  bool publish(const char* topic, std::string_view data, int qos = 0,
+               bool = false) {
+    return publish(topic,
+                   std::span{reinterpret_cast<const uint8_t*>(data.data()),
+                             data.size()},
+                   qos);
+  }
+
+  bool publish(const char* topic, std::span<const uint8_t> data, int qos = 0,
+               bool = false) {
+    mCounters.publishes++;
+    mCounters.publishedBytes += data.size();
+    mCounters.wireBytes += wireBytes(topic, data.size(), qos);
+    if (mQuiet) {
+      return true;
+    }
+
+    std::printf("%lld %s ",
+                static_cast<long long>(
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        mNow.time_since_epoch())
+                        .count()),
+                topic);
+    if (std::strcmp(topic, "/sensors/binary") == 0) {
+      for (const auto byte : data) {
+        std::printf("%02x", byte);
+      }
+    } else {
+      std::printf("%.*s", static_cast<int>(data.size()),
+                  reinterpret_cast<const char*>(data.data()));
+    }
+    std::printf("\n");
+    return true;
+  }
+
+  const Counters& counters() const { return mCounters; }
+
+private:
+  bool mQuiet;
+  Clock::time_point mNow;
+  Counters mCounters;
+};
+
+/* The receive, aggregate and publish path of AppMain driven by the recorded
+ * receive times instead of the device clocks. Windows are aligned to the
+ * start of the capture and binary payloads carry the seconds since then.
+ * The window that is open at the end of the capture is published as well,
+ * followed by a pending batch.
+ */
+class Pipeline {
+public:
+  Pipeline(bool quiet, Clock::time_point start, PublishBatchPolicy batchPolicy)
+      : mClient{quiet}, mScheduler{kSensorUpdateInterval, start},
+        mPublisher{std::make_unique<WindowPublisher<ReplayClient>>(
+            mClient, mWindows->sensorDefinition(), kSensorDeadbands,
+            kSensorMaxSilence,
+            PublishSettings{
+                .json = kPublishJson,
+                .binary = kPublishBinary,
+                .perSensor = kPublishPerSensor,
+                .retainPerSensor = kRetainPerSensor,
+                .statistics = kPublishSensorStatistics,
+                .qos = kPublishQos,
+                .batch = batchPolicy,
+                .interval = kSensorUpdateInterval,
+            },
+            *mMetrics)} {}
+
+  void receive(std::span<const uint8_t> frame, Clock::time_point now) {
+    if (mScheduler.advance(now)) {
+      finishWindow(now);
+    }
+
+    ReceiveBatchCounts counts{};
+    mReceiver->receive(frame, now, sampleTimestamp(now), counts,
+                       [&](const SensorSample& sample) {
+                         mWindows->add(sample);
+                         return true;
+                       });
+  }
+
+  void finishWindow(Clock::time_point now) {
+    mWindowCount++;
+    mClient.setTime(now);
+    mPublisher->publishWindow(mWindows->finishWindow(), windowTime(now),
+                              [](std::span<const uint8_t>) {});
+  }
+
+  // Publishes the batch if it isn't empty
+  void finishBatch(Clock::time_point now) {
+    mClient.setTime(now);
+    mPublisher->finishBatch(windowTime(now), true,
+                            [](std::span<const uint8_t>) {});
+  }
+
+  size_t windowCount() const { return mWindowCount; }
+  const ReplayClient::Counters& counters() const { return mClient.counters(); }
+  const FrameDeduplicator::Counters& frameCounters() const {
+    return mReceiver->frameCounters();
+  }
+  const spymarine::ParseCounters& parseCounters() const {
+    return mReceiver->parseCounters();
+  }
+
+  /* Summaries of the time from receiving the oldest and newest sample of a
+   * window until it was published, in milliseconds
+   */
+  HistogramSummary oldestSampleAges() {
+    return mMetrics->oldestSampleMilliseconds.summarize();
+  }
+  HistogramSummary newestSampleAges() {
+    return mMetrics->newestSampleMilliseconds.summarize();
+  }
+
+private:
+  // The capture starts at the epoch of the steady clock
+  static WindowTime windowTime(Clock::time_point now) {
+    return {now, sampleTimestamp(now),
+            static_cast<uint32_t>(
+                std::chrono::duration_cast<std::chrono::seconds>(
+                    now.time_since_epoch())
+                    .count())};
+  }
+
+  ReplayClient mClient;
+  WindowScheduler<Clock> mScheduler;
+  std::unique_ptr<PipelineMetrics> mMetrics =
+      std::make_unique<PipelineMetrics>();
+  std::unique_ptr<SensorReceiver> mReceiver =
+      std::make_unique<SensorReceiver>(kSensorDefinition,
+                                       kFrameDeduplicationWindow);
+  std::unique_ptr<SensorWindows> mWindows =
+      std::make_unique<SensorWindows>(kSensorDefinition, kDerivedSensors);
+  std::unique_ptr<WindowPublisher<ReplayClient>> mPublisher;
+  size_t mWindowCount{0};
+};
+
+} // namespace
+
+/* Usage: simarine_replay [--realtime] [--quiet] [--batch windows] capture
+ *
+ * Feeds a capture written by CaptureStream through deduplication, parsing,
+ * aggregation, deadband filtering and serialization with the settings of
+ * Config.example.hpp. Prints every publish as "<milliseconds since start>
+ * <topic> <payload>", binary payloads in hex. Runs as fast as possible unless
+ * --realtime is given, --quiet only prints the summary. --batch overrides
+ * kPublishBatch.maxWindows.
+ */
+int main(int argc, char** argv) {
+  const auto options = parseOptions(argc, argv);
+  if (!options) {
+    std::fprintf(stderr, "Usage: simarine_replay [--realtime] [--quiet] "
+                         "[--batch windows] capture\n");
+    return EXIT_FAILURE;
+  }
+
+  MappedFile file;
+  if (!file.open(options->path)) {
+    std::fprintf(stderr, "Couldn't map %s\n", options->path);
+    return EXIT_FAILURE;
+  }
+
+  Pipeline pipeline{options->quiet, Clock::time_point{},
+                    options->batchPolicy};
+
+  // Recorded timestamps wrap after 49 days, only differences are used
+  std::optional<uint32_t> previousTimestamp;
+  Clock::time_point now;
+
+  const auto wallStart = Clock::now();
+  const auto records = readCapture(
+      file.bytes(), [&](uint32_t timestamp, std::span<const uint8_t> frame) {
+        if (previousTimestamp) {
+          now += std::chrono::milliseconds{
+              static_cast<uint32_t>(timestamp - *previousTimestamp)};
+        }
+        previousTimestamp = timestamp;
+
+        if (options->realtime) {
+          std::this_thread::sleep_until(wallStart + now.time_since_epoch());
+        }
+        pipeline.receive(frame, now);
+      });
+
+  if (!records) {
+    std::fprintf(stderr, "%s is not a capture\n", options->path);
+    return EXIT_FAILURE;
+  }
+  pipeline.finishWindow(now);
+  pipeline.finishBatch(now);
+
+  const auto seconds =
+      std::chrono::duration<double>(Clock::now() - wallStart).count();
+  const auto hours =
+      std::chrono::duration<double, std::ratio<3600>>(now.time_since_epoch())
+          .count();
+  const auto& counters = pipeline.counters();
+  const auto oldest = pipeline.oldestSampleAges();
+  const auto newest = pipeline.newestSampleAges();
+  const auto& frameCounters = pipeline.frameCounters();
+  const auto& parseCounters = pipeline.parseCounters();
+  std::fprintf(stderr,
+               "%zu records (%" PRIu32 " duplicates) covering %.1f s replayed "
+               "in %.3f s (%.0f records/s)\n"
+               "rejected: %" PRIu32 " bad magic, %" PRIu32
+               " length mismatch, %" PRIu32 " CRC mismatch, %" PRIu32
+               " truncated value, %" PRIu32 " unknown value type\n"
+               "%zu windows, %zu publishes, %zu bytes\n"
+               "%.0f publishes/hour, ~%zu bytes on the wire (~%.0f/hour)\n"
+               "sample age at publish: newest p50 %" PRIu32 " ms, p99 %" PRIu32
+               " ms, oldest p50 %" PRIu32 " ms, p99 %" PRIu32 " ms\n",
+               *records, frameCounters.duplicates,
+               std::chrono::duration<double>(now.time_since_epoch()).count(),
+               seconds, *records / seconds, parseCounters.badMagic,
+               parseCounters.lengthMismatch, parseCounters.crcMismatch,
+               parseCounters.truncatedValue, parseCounters.unknownValueType,
+               pipeline.windowCount(), counters.publishes,
+               counters.publishedBytes, counters.publishes / hours,
+               counters.wireBytes, counters.wireBytes / hours, newest.p50,
+               newest.p99, oldest.p50, oldest.p99);
+
+  return EXIT_SUCCESS;
+}
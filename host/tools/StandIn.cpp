@@ -0,0 +1,44 @@
+#include "SimarineStandIn.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/* Usage: simarine_standin [--port port] device-type...
+ *
+ * Answers deviceCount and deviceInfo requests on all interfaces like a
+ * Simarine device with the given device types connected, e.g.
+ * `simarine_standin 9 1 9` for two batteries and a voltmeter. Uses the port
+ * of Simarine devices unless --port is given.
+ */
+int main(int argc, char** argv) {
+  uint16_t port = spymarine::kSimarineTcpPort;
+  std::vector<uint8_t> deviceTypes;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+      port = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else {
+      deviceTypes.push_back(
+          static_cast<uint8_t>(std::strtoul(argv[i], nullptr, 10)));
+    }
+  }
+
+  if (deviceTypes.empty()) {
+    std::fprintf(stderr,
+                 "Usage: simarine_standin [--port port] device-type...\n");
+    return EXIT_FAILURE;
+  }
+
+  SimarineStandIn standIn{deviceTypes};
+  if (!standIn.listen(port, false)) {
+    std::fprintf(stderr, "Couldn't listen on port %d\n", port);
+    return EXIT_FAILURE;
+  }
+
+  std::fprintf(stderr, "Serving %zu devices on port %d\n", deviceTypes.size(),
+               standIn.port());
+  standIn.serve();
+
+  return EXIT_SUCCESS;
+}
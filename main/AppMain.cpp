@@ -1,122 +1,510 @@
+#include "CaptureStream.hpp"
 #include "Config.hpp"
+#include "FlashLog.hpp"
 #include "JsonWriter.hpp"
+#include "Metrics.hpp"
 #include "MqttClient.hpp"
+#include "OutboxSender.hpp"
+#include "PartitionFlash.hpp"
+#include "QueryServer.hpp"
+#include "SensorDefinitionCache.hpp"
+#include "SensorPipeline.hpp"
+#include "SensorSnapshot.hpp"
+#include "SensorValuesBinary.hpp"
+#include "SimarineClient.hpp"
+#include "SpscRing.hpp"
 #include "UdpBroadcastServer.hpp"
 #include "WifiConnector.hpp"
+#include "WindowScheduler.hpp"
 #include "spymarine/Parsing.hpp"
 #include "spymarine/Sensor.hpp"
 
+#include "esp_cpu.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_netif_sntp.h"
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "nvs_flash.h"
 
+#include <array>
 #include <chrono>
 #include <cstdio>
 #include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string_view>
-#include <unordered_map>
-#include <vector>
 
 static const char* TAG = "sensor_reporter";
 
-namespace {
+// Fits all metrics with their largest values
+constexpr size_t kStatsBufferSize = 1024;
 
-using SensorValuesMap = std::unordered_map<spymarine::SensorId, double>;
+// The receiving task runs with a higher priority than the main task which
+// aggregates and publishes
+constexpr uint32_t kReceiverStackSize = 4096;
+constexpr UBaseType_t kReceiverPriority = 5;
 
-std::string_view writeSensorValuesJson(JsonBuffer& buffer,
-                                       const SensorValuesMap& values) {
-  JsonWriter writer{buffer};
+// The query task runs with the priority of the main task, see serveQueries.
+// The reply fits all sensors of the snapshot with their largest values.
+constexpr uint32_t kQueryStackSize = 4096;
+constexpr UBaseType_t kQueryPriority = tskIDLE_PRIORITY + 1;
+constexpr size_t kQueryBufferSize = 6144;
+static_assert(kQueryBufferSize >=
+              latestSensorValuesJsonSize(LatestSensorValues::kCapacity));
+static_assert(std::string_view{kQueryRequest}.size() <=
+              QueryServer::kMaxRequestSize);
 
-  writer.startArray();
+// Datagrams drained from the socket per wake up of the receiving task
+constexpr size_t kReceiveBatchSize = 8;
+constexpr size_t kMaxDatagramSize = 1024;
 
-  for (const auto& value : values) {
-    writer.startObject();
-    writer.addObjectKey("sensor_id");
-    writer.addInt(value.first);
-    writer.addObjectKey("value");
-    writer.addDouble(value.second);
-    writer.endObject();
-  }
+// Sensor discovery waits this long for each response and retries after
+// kDiscoveryRetryInterval until the first definition was built
+constexpr auto kDiscoveryTimeout = std::chrono::seconds{2};
+constexpr auto kDiscoveryRetryInterval = std::chrono::seconds{10};
+constexpr uint32_t kDiscoveryStackSize = 4096;
+
+// Records of the outbox are published in batches of up to this size, fits at
+// least one window with all sensors
+constexpr size_t kOutboxBatchSize = 2048;
+static_assert(kOutboxBatchSize >= sensorValuesBinarySize(255));
 
-  writer.endArray();
+// A batch of the outbox that isn't acknowledged within this time is published
+// again, e.g. after the client dropped it with the connection
+constexpr auto kOutboxAcknowledgeTimeout = std::chrono::seconds{30};
 
-  return writer.string();
+constexpr PublishSettings kPublishSettings{
+    .json = kPublishJson,
+    .binary = kPublishBinary,
+    .perSensor = kPublishPerSensor,
+    .retainPerSensor = kRetainPerSensor,
+    .statistics = kPublishSensorStatistics,
+    .qos = kPublishQos,
+    .batch = kPublishBatch,
+    .interval = kSensorUpdateInterval,
 };
 
-class MovingAverageCalculator {
-public:
-  void updateValue(spymarine::SensorId id, const double newValue) {
-    const auto [counter, value] = mCumulativeValues[id];
-    mCumulativeValues[id] = {counter + 1, value + newValue};
-  }
+namespace {
 
-  const SensorValuesMap& calculateMovingAverage() {
-    for (auto& entry : mCumulativeValues) {
-      const auto [counter, value] = entry.second;
-      mAverageValues[entry.first] = value / counter;
-      entry.second = {0, 0.0};
-    }
-    return mAverageValues;
-  }
+// Binary windows that couldn't be published, see kOutboxPartition
+using Outbox = FlashLog<PartitionFlash>;
+
+// Publishes the outbox to /sensors/backlog
+using BacklogSender = OutboxSender<Outbox>;
+
+// Samples passed from the receiving to the publishing task. Holds several
+// seconds worth of samples in case publishing stalls.
+using SampleRing = SpscRing<SensorSample, 512>;
 
-private:
-  std::unordered_map<spymarine::SensorId, std::pair<size_t, double>>
-      mCumulativeValues;
-  SensorValuesMap mAverageValues;
+struct ReceiverContext {
+  size_t udpPort;
+  const spymarine::SensorDefinition& sensorDefinition;
+  SampleRing& ring;
+  PipelineMetrics& metrics;
+  TaskHandle_t consumer;
 };
 
-template <typename SensorFunction>
-void readSensorValues(size_t udpPort,
-                      const spymarine::SensorDefinition& sensorDefinition,
-                      std::chrono::steady_clock::duration movingAverageInterval,
-                      SensorFunction function) {
+uint32_t millisecondsSinceBoot() {
+  return static_cast<uint32_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+/* Receives sensor state messages and pushes the values of the defined sensors
+ * into the ring. Runs in its own task so a slow publish doesn't delay
+ * draining the socket.
+ */
+void receiveSensorSamples(void* arg) {
+  const auto& context = *static_cast<const ReceiverContext*>(arg);
+
   UdpBroadcastServer server;
-  if (server.bind(udpPort)) {
-    MovingAverageCalculator movingAverageCalculator;
-
-    std::vector<uint8_t> recvbuf;
-    recvbuf.resize(1024);
-
-    auto start = std::chrono::steady_clock::now();
-    while (true) {
-      if (const auto buffer = server.receive(recvbuf)) {
-        parseSensorStateMessage(*buffer, sensorDefinition,
-                                [&](spymarine::SensorId id, double value) {
-                                  movingAverageCalculator.updateValue(id,
-                                                                      value);
-                                });
-
-        const auto delta = std::chrono::steady_clock::now() - start;
-        if (delta >= movingAverageInterval) {
-          function(movingAverageCalculator.calculateMovingAverage());
-          start = std::chrono::steady_clock::now();
+  if (!server.bind(context.udpPort)) {
+    esp_restart();
+  }
+
+  FrameBatch batch{kReceiveBatchSize, kMaxDatagramSize};
+
+  // Too large for the task stack
+  const auto receiver = std::make_unique<SensorReceiver>(
+      context.sensorDefinition, kFrameDeduplicationWindow);
+
+  CaptureStream capture{kMaxDatagramSize};
+  auto capturing = *kCaptureAddress != '\0' &&
+                   capture.connect(kCaptureAddress, kCapturePort);
+
+  while (true) {
+    if (server.receiveBatch(batch)) {
+      const auto timestamp = millisecondsSinceBoot();
+      const auto now = SensorReceiver::Clock::now();
+      const auto timed = context.metrics.timesNextBatch();
+      const auto start = timed ? esp_cpu_get_cycle_count() : 0;
+      ReceiveBatchCounts counts{};
+
+      for (const auto frame : batch.frames()) {
+        if (capturing) {
+          capturing = capture.write(timestamp, frame);
         }
-      } else {
-        // receive should never fail for our UDP server, let's restart
-        // to try and recover from this state.
-        esp_restart();
+        receiver->receive(frame, now, timestamp, counts,
+                          [&](const SensorSample& sample) {
+                            return context.ring.push(sample);
+                          });
       }
+
+      context.metrics.recordReceiveBatch(
+          counts, timed ? std::optional{esp_cpu_get_cycle_count() - start}
+                        : std::nullopt);
+
+      if (counts.droppedSamples > 0) {
+        ESP_LOGW(TAG, "Sample ring full, dropped %" PRIu32 " samples",
+                 counts.droppedSamples);
+      }
+
+      const auto& counters = receiver->frameCounters();
+      const auto& parseCounters = receiver->parseCounters();
+      ESP_LOGD(TAG,
+               "%" PRIu32 " frames accepted, %" PRIu32 " duplicates, rejected: "
+               "%" PRIu32 " bad magic, %" PRIu32 " length mismatch, %" PRIu32
+               " CRC mismatch, %" PRIu32 " truncated value, %" PRIu32
+               " unknown value type",
+               counters.accepted, counters.duplicates, parseCounters.badMagic,
+               parseCounters.lengthMismatch, parseCounters.crcMismatch,
+               parseCounters.truncatedValue, parseCounters.unknownValueType);
+
+      xTaskNotifyGive(context.consumer);
+    } else {
+      // receive should never fail for our UDP server, let's restart
+      // to try and recover from this state.
+      esp_restart();
     }
   }
 }
 
+TickType_t toTicks(std::chrono::system_clock::duration duration) {
+  // Rounded up so the task doesn't wake up right before the deadline
+  const auto milliseconds =
+      std::chrono::ceil<std::chrono::milliseconds>(duration).count();
+  return pdMS_TO_TICKS(milliseconds) + 1;
+}
+
+/* Answers queries on kQueryPort with the latest values of the snapshot.
+ *
+ * Reading the snapshot fails while the aggregating task publishes it. The
+ * query task then waits a tick instead of retrying right away, so it doesn't
+ * keep the aggregating task from finishing if it preempted it.
+ */
+void serveQueries(void* arg) {
+  const auto& snapshot = *static_cast<const SensorSnapshot*>(arg);
+
+  QueryServer server{kQueryRequest,
+                     {kQuerySenderInterval, kQueryRepliesPerSecond}};
+  if (!server.bind(kQueryPort)) {
+    vTaskDelete(nullptr);
+  }
+
+  // Too large for the task stack
+  static LatestSensorValues values;
+  static std::array<char, kQueryBufferSize> buffer;
+
+  while (true) {
+    if (!server.receive()) {
+      vTaskDelay(pdMS_TO_TICKS(1000));
+      continue;
+    }
+
+    while (!snapshot.read(values)) {
+      vTaskDelay(1);
+    }
+
+    JsonWriter writer{buffer};
+    writeLatestSensorValuesJson(writer, values, millisecondsSinceBoot());
+    if (writer.overflow()) {
+      ESP_LOGE(TAG, "Query buffer too small for %zu sensors", values.count);
+      continue;
+    }
+    server.reply(writer.string());
+  }
+}
+
+/* Aggregates the samples from the ring and calls function with the sensor
+ * values whenever a reporting window ends. Windows are aligned to multiples
+ * of the interval on the wall clock and end on time even if no samples
+ * arrive. wakeFunction is called every time the task wakes up, e.g. when it
+ * is notified. Must run in the task that was passed to receiveSensorSamples
+ * as consumer.
+ *
+ * The samples, including those of the derived sensors, and windows are also
+ * published to the snapshot, once per wake up and window.
+ *
+ * The CPU cycles spent on aggregating are recorded per sample in metrics and
+ * logged per window at debug level, to compare the cost per sample on the
+ * target with the host benchmark.
+ */
+template <typename SensorFunction, typename WakeFunction>
+void aggregateSensorSamples(SampleRing& ring, SensorWindows& windows,
+                            SensorSnapshot& snapshot, PipelineMetrics& metrics,
+                            std::chrono::system_clock::duration interval,
+                            SensorFunction function,
+                            WakeFunction wakeFunction) {
+  using Clock = std::chrono::system_clock;
+
+  WindowScheduler<Clock> scheduler{interval, Clock::now()};
+  uint32_t samples = 0;
+  uint32_t cycles = 0;
+
+  const auto updateSnapshot = [&](const SensorSample& sample) {
+    snapshot.updateSample(sample);
+  };
+
+  while (true) {
+    ulTaskNotifyTake(pdTRUE,
+                     toTicks(scheduler.timeUntilBoundary(Clock::now())));
+
+    const auto start = esp_cpu_get_cycle_count();
+    uint32_t popped = 0;
+    while (const auto sample = ring.pop()) {
+      windows.add(*sample, updateSnapshot);
+      popped++;
+    }
+    if (popped > 0) {
+      // Wraps around like the counter
+      const auto elapsed = esp_cpu_get_cycle_count() - start;
+      metrics.sampleCycles.record(elapsed / popped);
+      samples += popped;
+      cycles += elapsed;
+      snapshot.publish();
+    }
+
+    if (scheduler.advance(Clock::now())) {
+      ESP_LOGD(TAG, "Aggregated %" PRIu32 " samples in %" PRIu32 " cycles",
+               samples, cycles);
+      samples = 0;
+      cycles = 0;
+      const auto values = windows.finishWindow();
+      snapshot.updateWindow(values);
+      snapshot.publish();
+      function(values);
+    }
+
+    wakeFunction();
+  }
+}
+
+// Seconds since the Unix epoch, only meaningful once the time was
+// synchronized over SNTP
+uint32_t windowTimestamp() {
+  const auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+  return static_cast<uint32_t>(timestamp.count());
+}
+
+void logOutboxCounters(const Outbox& outbox) {
+  const auto& counters = outbox.counters();
+  ESP_LOGI(TAG,
+           "Outbox: %zu pending, %" PRIu32 " stored, %" PRIu32
+           " dropped, %" PRIu32 " corrupted, %" PRIu32 " failed",
+           outbox.pendingRecords(), counters.appended, counters.dropped,
+           counters.corrupted, counters.failedAppends);
+}
+
+// Mounts the outbox or returns nullptr if it is disabled or unavailable
+std::unique_ptr<Outbox> openOutbox() {
+  if (*kOutboxPartition == '\0') {
+    return nullptr;
+  }
+
+  static PartitionFlash flash{kOutboxPartition};
+  if (!flash.valid()) {
+    return nullptr;
+  }
+
+  auto outbox = std::make_unique<Outbox>(flash);
+  if (!outbox->mount()) {
+    ESP_LOGE(TAG, "Couldn't mount the outbox");
+    return nullptr;
+  }
+  logOutboxCounters(*outbox);
+  return outbox;
+}
+
+// Publishes the metrics to /sensors/stats, see kStatsInterval
+void publishStats(MqttClient& client, PipelineMetrics& metrics) {
+  static std::array<char, kStatsBufferSize> buffer;
+
+  JsonWriter writer{buffer};
+  const auto uptime = static_cast<uint32_t>(esp_timer_get_time() / 1'000'000);
+  writeMetricsJson(writer, metrics, uptime, esp_get_minimum_free_heap_size());
+  if (writer.overflow()) {
+    ESP_LOGE(TAG, "Stats buffer too small");
+    return;
+  }
+  client.publish("/sensors/stats", writer.string());
+}
+
+std::unique_ptr<spymarine::SensorDiscovery> discoverSensors() {
+  SimarineClient client;
+  if (!client.connect(kSimarineAddress, spymarine::kSimarineTcpPort,
+                      kDiscoveryTimeout)) {
+    return nullptr;
+  }
+  return discoverSensors(client);
+}
+
+/* Discovers the sensors once more after starting with a cached definition.
+ * Stores the new definition and restarts if the devices changed since it was
+ * cached.
+ */
+void verifyCachedSensorDefinition(void* arg) {
+  const auto cachedHash = *static_cast<const uint32_t*>(arg);
+
+  const auto discovery = discoverSensors();
+  if (!discovery) {
+    ESP_LOGW(TAG, "Couldn't verify the cached sensor definition");
+  } else if (discovery->topologyHash() != cachedHash) {
+    ESP_LOGI(TAG, "Devices changed, restarting with %zu discovered devices",
+             discovery->deviceCount());
+    if (storeSensorDefinition(discovery->topologyHash(),
+                              discovery->sensorDefinition())) {
+      esp_restart();
+    }
+  }
+
+  vTaskDelete(nullptr);
+}
+
+/* Sets sensorDefinition to the cached definition and verifies it in the
+ * background or discovers the sensors, retrying until it succeeds.
+ */
+void loadOrDiscoverSensorDefinition(
+    spymarine::SensorDefinition& sensorDefinition) {
+  if (const auto cached = loadSensorDefinition()) {
+    ESP_LOGI(TAG, "Using the cached sensor definition");
+    sensorDefinition = cached->sensorDefinition;
+
+    static uint32_t cachedHash;
+    cachedHash = cached->topologyHash;
+    xTaskCreate(verifyCachedSensorDefinition, "sensor_discovery",
+                kDiscoveryStackSize, &cachedHash, tskIDLE_PRIORITY + 1,
+                nullptr);
+    return;
+  }
+
+  while (true) {
+    if (const auto discovery = discoverSensors()) {
+      ESP_LOGI(TAG, "Discovered %zu devices", discovery->deviceCount());
+      storeSensorDefinition(discovery->topologyHash(),
+                            discovery->sensorDefinition());
+      sensorDefinition = discovery->sensorDefinition();
+      return;
+    }
+
+    ESP_LOGW(TAG, "Sensor discovery failed, retrying");
+    vTaskDelay(pdMS_TO_TICKS(
+        std::chrono::milliseconds{kDiscoveryRetryInterval}.count()));
+  }
+}
+
 } // namespace
 
 static void start(void) {
   WifiConnector wifiConnector{kWifiSsid, kWifiPassword};
   wifiConnector.waitUntilConnected();
 
+  esp_sntp_config_t sntpConfig = ESP_NETIF_SNTP_DEFAULT_CONFIG(kNtpServer);
+  ESP_ERROR_CHECK(esp_netif_sntp_init(&sntpConfig));
+
+  // Shared by both tasks for the lifetime of the application
+  static PipelineMetrics metrics;
+
   MqttClient client{kMqttBrokerUri, kMqttRootCaCertificate,
                     kMqttDeviceCertificate, kMqttDevicePrivateKey};
-  JsonBuffer jsonBuffer;
-
-  readSensorValues(kSimarineUdpPort, kSensorDefinition, kSensorUpdateInterval,
-                   [&](const SensorValuesMap& sensorValues) {
-                     client.publish(
-                         "/sensors/all",
-                         writeSensorValuesJson(jsonBuffer, sensorValues));
-                   });
+  client.notifyOnConnect(xTaskGetCurrentTaskHandle());
+  client.recordMetrics(metrics.publish, kTraceAcknowledgements);
+
+  const auto outbox = openOutbox();
+  static std::array<uint8_t, kOutboxBatchSize> outboxBuffer;
+  std::optional<BacklogSender> backlogSender;
+  if (outbox) {
+    backlogSender.emplace(*outbox, "/sensors/backlog", outboxBuffer,
+                         kOutboxAcknowledgeTimeout);
+  }
+
+  // The sensors of the devices, used by the receiving task to decode frames
+  static auto deviceDefinition = kSensorDefinition;
+  if (kSensorDiscovery) {
+    loadOrDiscoverSensorDefinition(deviceDefinition);
+  }
+
+  // Aggregates the sensors of the devices and the derived sensors. Used by
+  // the main task only, but too large for its stack.
+  static SensorWindows windows{deviceDefinition, kDerivedSensors};
+  const auto& sensorDefinition = windows.sensorDefinition();
+  if (windows.derivedSensors().skipped() > 0) {
+    ESP_LOGE(TAG, "Skipped %zu derived sensors, see kDerivedSensors",
+             windows.derivedSensors().skipped());
+  }
+
+  // Allocated once, too large for the task stack
+  const auto publisher = std::make_unique<WindowPublisher<MqttClient>>(
+      client, sensorDefinition, kSensorDeadbands, kSensorMaxSilence,
+      kPublishSettings, metrics);
+
+  // Shared with the query task for the lifetime of the application
+  static SensorSnapshot snapshot{sensorDefinition};
+  if (kQueryPort != 0) {
+    xTaskCreate(serveQueries, "query_server", kQueryStackSize, &snapshot,
+                kQueryPriority, nullptr);
+  }
+
+  static SampleRing ring;
+  static ReceiverContext receiverContext{kSimarineUdpPort, deviceDefinition,
+                                         ring, metrics,
+                                         xTaskGetCurrentTaskHandle()};
+  xTaskCreate(receiveSensorSamples, "sensor_receiver", kReceiverStackSize,
+              &receiverContext, kReceiverPriority, nullptr);
+
+  auto nextStats = std::chrono::steady_clock::now() + kStatsInterval;
+
+  aggregateSensorSamples(
+      ring, windows, snapshot, metrics, kSensorUpdateInterval,
+      [&](std::span<SensorValue> sensorValues) {
+        const auto changedValues = publisher->publishWindow(
+            sensorValues,
+            {std::chrono::steady_clock::now(), millisecondsSinceBoot(),
+             windowTimestamp()},
+            [&](std::span<const uint8_t> payload) {
+              if (outbox) {
+                outbox->append(payload);
+                logOutboxCounters(*outbox);
+              }
+            });
+
+        const auto& counters = publisher->deadbandCounters();
+        ESP_LOGI(TAG,
+                 "Reported %zu of %zu sensors, %" PRIu32 " sent and %" PRIu32
+                 " suppressed in total",
+                 changedValues.size(), sensorValues.size(), counters.sent,
+                 counters.suppressed);
+      },
+      [&] {
+        const auto now = std::chrono::steady_clock::now();
+        if (backlogSender) {
+          if (const auto published = backlogSender->send(client, now)) {
+            ESP_LOGI(TAG, "Published %zu windows from the outbox", published);
+            logOutboxCounters(*outbox);
+          }
+        }
+
+        if (kStatsInterval.count() > 0 && client.connected() &&
+            now >= nextStats) {
+          publishStats(client, metrics);
+          nextStats = now + kStatsInterval;
+        }
+      });
 }
 
 extern "C" void app_main(void) {
@@ -0,0 +1,125 @@
+#include "CaptureStream.hpp"
+
+#include "FrameCapture.hpp"
+
+#include "esp_log.h"
+
+#include "lwip/sockets.h"
+
+namespace {
+const auto kTag = "capture_stream";
+} // namespace
+
+CaptureStream::CaptureStream(size_t maxDatagramSize)
+    : mBuffer(captureRecordSize(maxDatagramSize)) {}
+
+CaptureStream::~CaptureStream() { disconnect(); }
+
+bool CaptureStream::connect(const char* address, uint16_t port) {
+  disconnect();
+
+  sockaddr_in saddr{};
+  saddr.sin_family = AF_INET;
+  saddr.sin_port = htons(port);
+  if (inet_pton(AF_INET, address, &saddr.sin_addr) != 1) {
+    ESP_LOGE(kTag, "Invalid capture address %s", address);
+    return false;
+  }
+
+  const auto sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sock < 0) {
+    ESP_LOGE(kTag, "Failed to create socket. Error %d", errno);
+    return false;
+  }
+
+  if (::connect(sock, reinterpret_cast<sockaddr*>(&saddr), sizeof(saddr)) !=
+      0) {
+    ESP_LOGE(kTag, "Failed to connect to %s:%d. Error %d", address, port,
+             errno);
+    close(sock);
+    return false;
+  }
+
+  mSocket = sock;
+  if (!sendAll(kCaptureHeader)) {
+    disconnect();
+    return false;
+  }
+
+  ESP_LOGI(kTag, "Capturing datagrams to %s:%d", address, port);
+  return true;
+}
+
+bool CaptureStream::write(uint32_t timestamp,
+                          std::span<const uint8_t> datagram) {
+  if (!mSocket) {
+    return false;
+  }
+
+  // A partially sent record has to be completed to keep the stream readable
+  if (!sendPending()) {
+    ESP_LOGW(kTag, "Capture connection lost. Error %d", errno);
+    disconnect();
+    return false;
+  }
+  if (mPendingSize > 0) {
+    mDroppedRecords++;
+    return true;
+  }
+
+  const auto record = writeCaptureRecord(mBuffer, timestamp, datagram);
+  if (!record) {
+    mDroppedRecords++;
+    return true;
+  }
+
+  mPendingOffset = 0;
+  mPendingSize = record->size();
+  if (!sendPending()) {
+    ESP_LOGW(kTag, "Capture connection lost. Error %d", errno);
+    disconnect();
+    return false;
+  }
+  if (mPendingOffset == 0 && mPendingSize > 0) {
+    // Nothing of the record fit, drop it as a whole
+    mPendingSize = 0;
+    mDroppedRecords++;
+  }
+
+  return true;
+}
+
+/* Sends as much of the pending record as fits into the send buffer without
+ * blocking. Returns false if the connection was lost.
+ */
+bool CaptureStream::sendPending() {
+  while (mPendingSize > 0) {
+    const auto sent = send(*mSocket, mBuffer.data() + mPendingOffset,
+                           mPendingSize, MSG_DONTWAIT);
+    if (sent < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    mPendingOffset += sent;
+    mPendingSize -= sent;
+  }
+  return true;
+}
+
+bool CaptureStream::sendAll(std::span<const uint8_t> bytes) {
+  while (!bytes.empty()) {
+    const auto sent = send(*mSocket, bytes.data(), bytes.size(), 0);
+    if (sent < 0) {
+      return false;
+    }
+    bytes = bytes.subspan(sent);
+  }
+  return true;
+}
+
+void CaptureStream::disconnect() {
+  if (mSocket) {
+    close(*mSocket);
+    mSocket.reset();
+  }
+  mPendingSize = 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+/*! Streams received datagrams in the format of FrameCapture.hpp to a TCP
+ *  server, e.g. `nc -l 43211 > sensors.smcp` on a computer in the same
+ *  network.
+ *
+ *  Writing never blocks the caller: a record that doesn't fit into the
+ *  socket's send buffer at all is dropped as a whole and counted. The rest of
+ *  a partially sent record is sent by the following writes, which drop their
+ *  own records until it is out, so the capture stays readable. Once the
+ *  connection is lost the stream stays closed.
+ */
+class CaptureStream {
+public:
+  explicit CaptureStream(size_t maxDatagramSize);
+  ~CaptureStream();
+
+  CaptureStream(const CaptureStream&) = delete;
+  CaptureStream& operator=(const CaptureStream&) = delete;
+
+  /* Connects to the IPv4 address and port and sends the capture header.
+   * Returns false on failure.
+   */
+  bool connect(const char* address, uint16_t port);
+
+  /* Appends a record of datagram received at timestamp (milliseconds).
+   * Returns false if the stream is not connected (anymore).
+   */
+  bool write(uint32_t timestamp, std::span<const uint8_t> datagram);
+
+  // Number of records dropped because the send buffer was full
+  uint32_t droppedRecords() const { return mDroppedRecords; }
+
+private:
+  bool sendAll(std::span<const uint8_t> bytes);
+  bool sendPending();
+  void disconnect();
+
+  std::optional<int> mSocket;
+  std::vector<uint8_t> mBuffer;
+  // The part of the record in mBuffer that wasn't sent yet
+  size_t mPendingOffset{0};
+  size_t mPendingSize{0};
+  uint32_t mDroppedRecords{0};
+};
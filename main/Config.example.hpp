@@ -1,7 +1,11 @@
 #pragma once
 
+#include "DeadbandFilter.hpp"
+#include "DerivedSensors.hpp"
+#include "PublishBatch.hpp"
 #include "spymarine/Sensor.hpp"
 
+#include <array>
 #include <chrono>
 
 // The sensor definition contains an entry for each sensor that should be
@@ -9,20 +13,150 @@
 // stable unless the hardware setup or configuration changes. The sensor
 // information can be read using the spymarine Python library
 // https://github.com/christopher-strack/spymarine. Note that the sensor ID is
-// referred to as "state_index" there.
-const spymarine::SensorDefinition kSensorDefinition{
+// referred to as "state_index" there. All types of spymarine::SensorType are
+// supported, see spymarine::SensorTraits for how they are converted.
+constexpr spymarine::SensorDefinition kSensorDefinition{
     {26, spymarine::SensorType::charge},
     {27, spymarine::SensorType::current},
     {33, spymarine::SensorType::charge},
     {35, spymarine::SensorType::voltage},
 };
 
+// Sensors computed on the device from every sample of other sensors and
+// reported like them, more accurately than from the reported means. Inputs
+// can be sensors of kSensorDefinition or earlier derived sensors. The ids
+// of derived sensors must not be used by the devices. An empty
+// std::array<DerivedSensor, 0> disables them.
+constexpr std::array kDerivedSensors{
+    // Battery power in W
+    DerivedSensor::power(200, 35, 27),
+    // Charge in Ah and energy in Wh into the battery since boot, negative
+    // while discharging
+    DerivedSensor::integral(201, 27, spymarine::SensorType::capacity),
+    DerivedSensor::integral(202, 200, spymarine::SensorType::energy),
+    // Change of the state of charge per hour and the time in h until the
+    // battery is empty while discharging
+    DerivedSensor::chargeRate(203, 26),
+    DerivedSensor::timeToEmpty(204, 26, 203),
+};
+
 // UDP port used by the Simarine device
 constexpr auto kSimarineUdpPort = 43210;
 
-// Interval on how often the sensor values are reported over MQTT
+// Build the sensor definition at boot by querying the devices connected to
+// the Simarine device at kSimarineAddress over TCP instead of using
+// kSensorDefinition. The result is cached in NVS so later boots start
+// reporting right away, discovery then runs in the background and restarts
+// the application if the devices changed.
+constexpr auto kSensorDiscovery = false;
+constexpr auto kSimarineAddress = "192.168.1.1";
+
+// Frames that repeat a frame received less than this ago are dropped before
+// parsing so repeated broadcasts don't outweigh others in the average. Zero
+// disables deduplication.
+constexpr auto kFrameDeduplicationWindow = std::chrono::seconds{1};
+
+// All received datagrams are streamed to a TCP server at this IPv4 address if
+// set, e.g. `nc -l 43211 > sensors.smcp`. The capture can be replayed on the
+// host with simarine_replay.
+constexpr auto kCaptureAddress = "";
+constexpr uint16_t kCapturePort = 43211;
+
+// UDP port on which queries are answered with the latest sample and
+// reporting window of each sensor as JSON, for displays in the local network,
+// e.g. `printf latest | nc -u -w1 <device> 43212`. Zero disables the query
+// port, which is the default since anyone who can reach the port gets
+// replies.
+constexpr uint16_t kQueryPort = 0;
+
+// Only datagrams with exactly this content are answered, others are ignored.
+// Choose a secret shared with the displays to keep others out.
+constexpr auto kQueryRequest = "latest";
+
+// Each sender gets at most one reply per kQuerySenderInterval and all
+// senders together at most kQueryRepliesPerSecond. Replies are up to 6 KB,
+// this bounds the traffic spoofed queries can cause.
+constexpr auto kQuerySenderInterval = std::chrono::milliseconds{500};
+constexpr uint32_t kQueryRepliesPerSecond = 4;
+
+// Interval on how often the sensor values are reported over MQTT. Reports are
+// aligned to multiples of the interval on the wall clock, e.g. full minutes.
 constexpr auto kSensorUpdateInterval = std::chrono::minutes{1};
 
+// Sensor values are only reported if they changed by more than their deadband
+// since they were last reported or if they weren't reported for
+// kSensorMaxSilence. Sensors without an entry use the default deadband (first
+// argument) which reports every change.
+constexpr DeadbandDefinition kSensorDeadbands{
+    Deadband{},
+    {
+        {26, {.absolute = 0.005}},
+        {27, {.absolute = 0.1}},
+        {33, {.absolute = 0.005}},
+        {35, {.absolute = 0.02}},
+        {200, {.absolute = 1}},
+        {201, {.absolute = 0.1}},
+        {202, {.absolute = 1}},
+        {203, {.absolute = 0.001}},
+        {204, {.relative = 0.05}},
+    }};
+constexpr auto kSensorMaxSilence = std::chrono::minutes{15};
+
+// Report min, max, last value, standard deviation and sample count of each
+// interval in addition to the mean. Allows a longer update interval without
+// losing short spikes.
+constexpr auto kPublishSensorStatistics = false;
+
+// Publish the sensor values as JSON to /sensors/all and/or in the compact
+// binary format of SensorValuesBinary.hpp to /sensors/binary
+constexpr auto kPublishJson = true;
+constexpr auto kPublishBinary = false;
+
+// QoS of the sensor value publishes to /sensors/all, /sensors/binary and
+// /sensors/batch. With QoS 1 the broker acknowledges every message, which
+// costs about a fifth more bytes on the wire for typical windows.
+constexpr auto kPublishQos = 0;
+
+// Measure the time until the broker acknowledged a publish for the stats,
+// see kStatsInterval. Only publishes with QoS 1 are acknowledged: those to
+// /sensors/backlog and, with kPublishQos of 1, the sensor values.
+constexpr auto kTraceAcknowledgements = false;
+
+// Additionally publish each sensor value to its own topic
+// /sensors/<id>/<type>, e.g. /sensors/35/voltage, as a plain number or, with
+// kPublishSensorStatistics, as an object. Retained messages let subscribers
+// get the latest value right away. These publishes aren't batched.
+constexpr auto kPublishPerSensor = false;
+constexpr auto kRetainPerSensor = true;
+
+// Windows can be collected into one message to save the overhead of a
+// publish over mutual TLS per window. A batch is published once it holds
+// maxWindows windows, before it would exceed maxBytes or before its oldest
+// window would wait longer than maxLatency. JSON batches are published to
+// /sensors/batch as an array of {"timestamp": ..., "sensors": [...]}, binary
+// batches to /sensors/binary as back to back payloads. With maxWindows of 1
+// every window is published on its own.
+constexpr PublishBatchPolicy kPublishBatch{
+    .maxWindows = 1,
+    .maxBytes = 4096,
+    .maxLatency = std::chrono::minutes{15},
+};
+
+// Windows that can't be published while Wifi or the MQTT broker is
+// unavailable are kept in this data partition (see partitions.csv) and
+// published to /sensors/backlog in the binary format once the client
+// reconnects. When the partition is full the oldest windows are dropped. An
+// empty string disables the outbox.
+constexpr auto kOutboxPartition = "outbox";
+
+// Counters and latency histograms of the receive, aggregate and publish path
+// are published to /sensors/stats in this interval, see Metrics.hpp. Zero
+// disables publishing them.
+constexpr auto kStatsInterval = std::chrono::minutes{5};
+
+// Used to timestamp binary sensor values
+constexpr auto kNtpServer = "pool.ntp.org";
+
 constexpr auto kWifiSsid = "[INSERT WIFI SSID]";
 constexpr auto kWifiPassword = "[INSERT WIFI PASSWORD]";
 
@@ -0,0 +1,37 @@
+#include "DeadbandFilter.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+std::span<SensorValue> DeadbandFilter::filter(std::span<SensorValue> values,
+                                              Clock::time_point now) {
+  size_t count = 0;
+
+  for (const auto& value : values) {
+    if (shouldReport(value, now)) {
+      mSlots[value.id] = {true, value.mean(), now};
+      values[count++] = value;
+      mCounters.sent++;
+    } else {
+      mCounters.suppressed++;
+    }
+  }
+
+  return values.first(count);
+}
+
+bool DeadbandFilter::shouldReport(const SensorValue& value,
+                                  Clock::time_point now) const {
+  const auto& slot = mSlots[value.id];
+  if (!slot.reported || now - slot.time >= mMaxSilence) {
+    return true;
+  }
+
+  const auto& deadband = mDeadbands.find(value.id);
+  const auto threshold =
+      std::max(deadband.absolute, deadband.relative * std::fabs(slot.value));
+  const auto change = std::fabs(value.mean() - slot.value);
+
+  // Negated so that NaN values are reported
+  return !(change <= threshold);
+}
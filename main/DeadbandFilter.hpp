@@ -0,0 +1,89 @@
+#pragma once
+
+#include "SensorAggregator.hpp"
+#include "spymarine/Sensor.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <utility>
+
+/* Minimum change of a sensor value that is worth reporting. The threshold is
+ * the larger of absolute and relative times the last reported value. With
+ * both being zero every change is reported.
+ */
+struct Deadband {
+  double absolute{0};
+  double relative{0};
+};
+
+/* A map from sensor id to deadband, built the same way as
+ * spymarine::SensorDefinition. Sensors without an entry use the default
+ * deadband, e.g.
+ * constexpr DeadbandDefinition deadbands{Deadband{}, {{27, {.absolute = 0.1}}}}
+ */
+class DeadbandDefinition {
+public:
+  using Entry = std::pair<spymarine::SensorId, Deadband>;
+
+  constexpr DeadbandDefinition(Deadband defaultDeadband,
+                               std::initializer_list<Entry> entries) {
+    mDeadbands.fill(defaultDeadband);
+    for (const auto& [id, deadband] : entries) {
+      mDeadbands[id] = deadband;
+    }
+  }
+
+  constexpr const Deadband& find(spymarine::SensorId id) const {
+    return mDeadbands[id];
+  }
+
+private:
+  std::array<Deadband, 256> mDeadbands{};
+};
+
+/*! Drops sensor values that didn't change by more than their deadband since
+ *  they were last reported.
+ *
+ *  A value is reported anyway if the sensor was silent for maxSilence so
+ *  consumers can tell a stable sensor from a missing one. Uses a fixed slot
+ *  per sensor id and doesn't allocate.
+ */
+class DeadbandFilter {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Counters {
+    uint32_t sent{0};
+    uint32_t suppressed{0};
+  };
+
+  DeadbandFilter(const DeadbandDefinition& deadbands,
+                 Clock::duration maxSilence)
+      : mDeadbands{deadbands}, mMaxSilence{maxSilence} {}
+
+  /* Removes the values that don't need to be reported at time now by moving
+   * the remaining values to the front. Returns the remaining values.
+   */
+  std::span<SensorValue> filter(std::span<SensorValue> values,
+                                Clock::time_point now);
+
+  // Number of values sent and suppressed since construction
+  const Counters& counters() const { return mCounters; }
+
+private:
+  bool shouldReport(const SensorValue& value, Clock::time_point now) const;
+
+  struct Slot {
+    bool reported{false};
+    double value{0};
+    Clock::time_point time;
+  };
+
+  const DeadbandDefinition& mDeadbands;
+  Clock::duration mMaxSilence;
+  std::array<Slot, 256> mSlots{};
+  Counters mCounters;
+};
@@ -0,0 +1,146 @@
+#include "DerivedSensors.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+constexpr int64_t kMillisecondsPerHour = 3'600'000;
+
+int32_t clampToInt32(int64_t value) {
+  return static_cast<int32_t>(
+      std::clamp<int64_t>(value, std::numeric_limits<int32_t>::min(),
+                          std::numeric_limits<int32_t>::max()));
+}
+
+} // namespace
+
+DerivedSensors::DerivedSensors(std::span<const DerivedSensor> sensors,
+                               spymarine::SensorDefinition& sensorDefinition) {
+  for (const auto& sensor : sensors) {
+    if (mCount == kCapacity || sensorDefinition.find(sensor.id) ||
+        !sensorDefinition.find(sensor.first) ||
+        !sensorDefinition.find(sensor.second)) {
+      mSkipped++;
+      continue;
+    }
+
+    const auto scale = [&](spymarine::SensorId id) -> int64_t {
+      return sensorDefinition.conversion(id).scale();
+    };
+    const int64_t derivedScale =
+        spymarine::kSensorScales[static_cast<size_t>(sensor.type)];
+
+    // Factor from the raw units of the computation to those of the sensor
+    int64_t numerator = derivedScale;
+    int64_t denominator = 1;
+    switch (sensor.kind) {
+    case DerivedSensor::Kind::product:
+      denominator = scale(sensor.first) * scale(sensor.second);
+      break;
+    case DerivedSensor::Kind::integral:
+      denominator = 2 * scale(sensor.first) * kMillisecondsPerHour;
+      break;
+    case DerivedSensor::Kind::rate:
+      numerator = derivedScale * kMillisecondsPerHour;
+      denominator = scale(sensor.first);
+      break;
+    case DerivedSensor::Kind::timeToEmpty:
+      numerator = derivedScale * scale(sensor.second);
+      denominator = scale(sensor.first);
+      break;
+    }
+    const auto divisor = std::gcd(numerator, denominator);
+
+    sensorDefinition.add(sensor.id, sensor.type);
+    mChannels[mCount] = {sensor, numerator / divisor, denominator / divisor,
+                         std::nullopt, std::nullopt, 0, 0, 0, 0};
+    mDependents[sensor.first] |= 1 << mCount;
+    mDependents[sensor.second] |= 1 << mCount;
+    mCount++;
+  }
+}
+
+int32_t DerivedSensors::Channel::convert(int64_t value, int64_t divisor) const {
+  int64_t scaled;
+  int64_t total;
+  if (__builtin_mul_overflow(value, numerator, &scaled) ||
+      __builtin_mul_overflow(denominator, divisor, &total)) {
+    // Far outside of the range of the derived sensor anyway
+    return clampToInt32(std::llround(static_cast<double>(value) * numerator /
+                                     denominator / divisor));
+  }
+
+  const auto quotient = scaled / total;
+  const auto remainder = scaled % total;
+  const auto roundAway = 2 * (remainder < 0 ? -remainder : remainder) >=
+                         (total < 0 ? -total : total);
+  const auto sign = (scaled < 0) != (total < 0) ? -1 : 1;
+  return clampToInt32(quotient + (roundAway ? sign : 0));
+}
+
+std::optional<SensorSample>
+DerivedSensors::Channel::update(const SensorSample& sample) {
+  switch (sensor.kind) {
+  case DerivedSensor::Kind::product:
+  case DerivedSensor::Kind::timeToEmpty:
+    // One sample per frame once both inputs of the frame arrived, a new
+    // sample of one input isn't paired with the previous one of the other
+    if (sample.id == sensor.first) {
+      first = sample.raw;
+      firstFrame = sample.frame;
+    }
+    if (sample.id == sensor.second) {
+      second = sample.raw;
+      secondFrame = sample.frame;
+    }
+    if (!first || !second || firstFrame != secondFrame) {
+      return std::nullopt;
+    }
+
+    if (sensor.kind == DerivedSensor::Kind::product) {
+      return SensorSample{convert(int64_t{*first} * *second),
+                          sample.timestamp, sensor.id, sample.frame};
+    }
+    if (*second >= 0) {
+      return std::nullopt;
+    }
+    return SensorSample{convert(*first, -int64_t{*second}), sample.timestamp,
+                        sensor.id, sample.frame};
+
+  case DerivedSensor::Kind::integral:
+    // first is the previous sample, the area up to it is in sum
+    if (first) {
+      const auto elapsed = sample.timestamp - timestamp;
+      if (elapsed <= sensor.milliseconds) {
+        sum += (int64_t{*first} + sample.raw) * elapsed;
+      }
+    }
+    first = sample.raw;
+    timestamp = sample.timestamp;
+    return SensorSample{convert(sum), sample.timestamp, sensor.id,
+                        sample.frame};
+
+  case DerivedSensor::Kind::rate:
+    // first is the sample the rate is measured from, second the last rate
+    if (!first) {
+      first = sample.raw;
+      timestamp = sample.timestamp;
+      return std::nullopt;
+    }
+    if (const auto elapsed = sample.timestamp - timestamp;
+        elapsed >= std::max<uint32_t>(sensor.milliseconds, 1)) {
+      second = convert(int64_t{sample.raw} - *first, elapsed);
+      first = sample.raw;
+      timestamp = sample.timestamp;
+    }
+    if (!second) {
+      return std::nullopt;
+    }
+    return SensorSample{*second, sample.timestamp, sensor.id, sample.frame};
+  }
+
+  return std::nullopt;
+}
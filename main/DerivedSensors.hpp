@@ -0,0 +1,153 @@
+#pragma once
+
+#include "SensorAggregator.hpp"
+#include "spymarine/Sensor.hpp"
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+/* A sensor that is computed on the device from the samples of other sensors
+ * and reported like them, see DerivedSensors. Declared in Config.hpp with
+ * the functions below, e.g. the power of a battery from its voltage and
+ * current: DerivedSensor::power(200, 35, 27).
+ */
+struct DerivedSensor {
+  enum class Kind : uint8_t {
+    product,
+    integral,
+    rate,
+    timeToEmpty,
+  };
+
+  // Power in W as the product of a voltage and a current sensor that are
+  // reported in the same frames, e.g. of the same battery
+  static constexpr DerivedSensor power(spymarine::SensorId id,
+                                       spymarine::SensorId voltage,
+                                       spymarine::SensorId current) {
+    return {id, Kind::product, spymarine::SensorType::power, voltage, current,
+            0};
+  }
+
+  /* Integral of a sensor over time since boot with the trapezoidal rule,
+   * e.g. the charge in Ah of a current sensor as type capacity or the
+   * energy in Wh of a power sensor as type energy. Gaps between samples
+   * longer than maxGap, e.g. while the device didn't receive anything, are
+   * left out.
+   */
+  static constexpr DerivedSensor
+  integral(spymarine::SensorId id, spymarine::SensorId input,
+           spymarine::SensorType type,
+           std::chrono::milliseconds maxGap = std::chrono::seconds{10}) {
+    return {id, Kind::integral, type, input, input,
+            static_cast<uint32_t>(maxGap.count())};
+  }
+
+  /* Change of a state of charge sensor per hour. The charge only changes in
+   * small steps, so the rate is measured between samples at least period
+   * apart and repeated in between.
+   */
+  static constexpr DerivedSensor
+  chargeRate(spymarine::SensorId id, spymarine::SensorId charge,
+             std::chrono::milliseconds period = std::chrono::minutes{5}) {
+    return {id,     Kind::rate, spymarine::SensorType::chargeRate,
+            charge, charge,     static_cast<uint32_t>(period.count())};
+  }
+
+  /* Time in h until a state of charge sensor reaches zero at the rate of a
+   * chargeRate sensor. Only has samples while the battery is discharging.
+   */
+  static constexpr DerivedSensor timeToEmpty(spymarine::SensorId id,
+                                             spymarine::SensorId charge,
+                                             spymarine::SensorId rate) {
+    return {id,     Kind::timeToEmpty, spymarine::SensorType::duration,
+            charge, rate,              0};
+  }
+
+  spymarine::SensorId id;
+  Kind kind;
+  spymarine::SensorType type;
+  spymarine::SensorId first;
+  spymarine::SensorId second;
+  // maxGap of an integral and period of a rate
+  uint32_t milliseconds;
+};
+
+/*! Computes derived sensors incrementally from the samples of their inputs.
+ *
+ *  Every sample of an input updates the derived sensors that use it in O(1)
+ *  and yields a sample of each of them with the timestamp of the input
+ *  sample. Sensors with two inputs yield a sample once both inputs of a
+ *  frame arrived, i.e. once per frame with the voltage and current of a
+ *  battery. Derived sensors can use earlier derived sensors as inputs,
+ *  e.g. the energy of a power sensor. Values stay in raw units and are
+ *  computed with integers like in SensorAggregator. Doesn't allocate.
+ */
+class DerivedSensors {
+public:
+  static constexpr size_t kCapacity = 16;
+
+  /* Adds the derived sensors to sensorDefinition. Sensors whose id is
+   * already defined or whose inputs aren't defined, either in
+   * sensorDefinition or as an earlier derived sensor, are skipped, as are
+   * sensors beyond kCapacity.
+   */
+  DerivedSensors(std::span<const DerivedSensor> sensors,
+                 spymarine::SensorDefinition& sensorDefinition);
+
+  size_t count() const { return mCount; }
+
+  // Number of sensors that were skipped when they were added
+  size_t skipped() const { return mSkipped; }
+
+  /* Updates the derived sensors that use the sample and calls function with
+   * each of their new samples
+   */
+  template <typename Function>
+  void update(const SensorSample& sample, Function function) {
+    auto dependents = mDependents[sample.id];
+    while (dependents != 0) {
+      const auto index = std::countr_zero(dependents);
+      dependents &= dependents - 1;
+      if (const auto derived = mChannels[index].update(sample)) {
+        function(*derived);
+        // Only feeds later derived sensors, so this ends
+        update(*derived, function);
+      }
+    }
+  }
+
+private:
+  // The state of a derived sensor
+  struct Channel {
+    std::optional<SensorSample> update(const SensorSample& sample);
+
+    // Scales a value in the raw units of the inputs to the raw units of the
+    // derived sensor, which are numerator / (denominator * divisor) times
+    // larger, rounded half away from zero
+    int32_t convert(int64_t value, int64_t divisor = 1) const;
+
+    DerivedSensor sensor;
+    int64_t numerator;
+    int64_t denominator;
+    std::optional<int32_t> first;
+    std::optional<int32_t> second;
+    uint32_t timestamp;
+    // Of an integral in raw units times milliseconds, twice the area
+    int64_t sum;
+    // Frames of the last samples of first and second of a product or time
+    // to empty
+    uint16_t firstFrame;
+    uint16_t secondFrame;
+  };
+
+  std::array<Channel, kCapacity> mChannels{};
+  size_t mCount{0};
+  size_t mSkipped{0};
+  // Bit i is set if channel i uses the sensor as input
+  std::array<uint16_t, 256> mDependents{};
+};
@@ -0,0 +1,465 @@
+#pragma once
+
+#include "spymarine/Crc.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+/*! A bounded, append-only log of small binary records in raw flash. Keeps
+ *  data that can't be sent right away across restarts.
+ *
+ *  Flash is a NOR flash of equally sized sectors that provides sectorSize(),
+ *  sectorCount(), read(offset, bytes), write(offset, bytes) and
+ *  erase(sector), each returning false on failure. Writes can only clear
+ *  bits, erasing sets all bytes of a sector to 0xff.
+ *
+ *  The sectors form a ring. Records are appended to the newest sector and
+ *  once all sectors are used the oldest one is erased, dropping its records.
+ *  Every sector is erased once per pass over the ring, which spreads the
+ *  wear evenly. Layout of a sector, all numbers are little endian:
+ *
+ *    uint32 kFlashLogMagic
+ *    uint32 sequence number, increases by one with every opened sector
+ *    for each record:
+ *      uint8  state, see below
+ *      uint16 payload length
+ *      uint16 CRC of the payload
+ *      payload
+ *    0xff up to the end of the sector
+ *
+ *  A record is written with the erased state and committed by clearing a bit
+ *  of its state afterwards, so a record that was interrupted by a power loss
+ *  is skipped when the log is mounted. Consuming clears another bit. A record
+ *  is delivered again if consuming it was interrupted.
+ */
+constexpr uint32_t kFlashLogMagic = 0x424f4d53;
+constexpr size_t kFlashLogSectorHeaderSize = 8;
+constexpr size_t kFlashLogRecordHeaderSize = 5;
+
+template <typename Flash> class FlashLog {
+public:
+  struct Counters {
+    uint32_t appended{0};
+
+    // Records lost because the log was full
+    uint32_t dropped{0};
+
+    // Records skipped because their payload didn't match the CRC
+    uint32_t corrupted{0};
+
+    // Appends that failed because of a flash error
+    uint32_t failedAppends{0};
+  };
+
+  explicit FlashLog(Flash& flash) : mFlash{flash} {}
+
+  /* Recovers the state of the log from flash. Must be called before any
+   * other method. Returns false if flash can't be read.
+   */
+  bool mount();
+
+  // The largest payload a record can hold
+  size_t maxPayloadSize() const {
+    return mFlash.sectorSize() - kFlashLogSectorHeaderSize -
+           kFlashLogRecordHeaderSize;
+  }
+
+  /* Appends a record, dropping the oldest sector if the log is full. Returns
+   * false if the payload is too large or on flash errors.
+   */
+  bool append(std::span<const uint8_t> payload);
+
+  /* Reads the oldest records that weren't consumed, as many as fit into
+   * buffer, and calls function with the payload of each, oldest first.
+   * Returns the number of records read. Reading again returns the same
+   * records until they are consumed.
+   */
+  template <typename Function>
+  size_t read(std::span<uint8_t> buffer, Function function);
+
+  /* Marks the records returned by the last read as consumed. Returns false
+   * on flash errors, the records might be read again in that case.
+   */
+  bool consume();
+
+  // Number of committed records that weren't consumed yet
+  size_t pendingRecords() const { return mPendingRecords; }
+
+  const Counters& counters() const { return mCounters; }
+
+private:
+  // Record states, each clears one more bit
+  static constexpr uint8_t kRecordWritten = 0xff;
+  static constexpr uint8_t kRecordCommitted = 0xfe;
+  static constexpr uint8_t kRecordConsumed = 0xfc;
+
+  struct Position {
+    size_t sector;
+    size_t offset;
+  };
+
+  struct RecordHeader {
+    uint8_t state;
+    uint16_t length;
+    uint16_t crc;
+  };
+
+  static uint32_t readUInt32(std::span<const uint8_t, 4> bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+           (uint32_t(bytes[3]) << 24);
+  }
+
+  size_t address(Position position) const {
+    return position.sector * mFlash.sectorSize() + position.offset;
+  }
+
+  size_t nextSector(size_t sector) const {
+    return (sector + 1) % mFlash.sectorCount();
+  }
+
+  // Index of a sector of the log counted from the oldest sector
+  size_t ringIndex(size_t sector) const {
+    return (sector + mFlash.sectorCount() - mTailSector) %
+           mFlash.sectorCount();
+  }
+
+  // Returns the sequence number of a sector or std::nullopt if the sector
+  // isn't part of a log
+  std::optional<uint32_t> readSequence(size_t sector);
+
+  std::optional<RecordHeader> readRecordHeader(Position position);
+
+  /* Calls function(position, header) for the records from position to the
+   * end of the log until it returns false. Returns the position at which the
+   * walk stopped, the end of the log if it wasn't stopped.
+   */
+  template <typename Function>
+  std::optional<Position> walk(Position position, Function function);
+
+  bool openSector();
+  bool writeState(Position position, uint8_t state);
+
+  Flash& mFlash;
+
+  // The sector that is appended to and its sequence number
+  std::optional<size_t> mHeadSector;
+  uint32_t mSequence{0};
+  size_t mWriteOffset{0};
+
+  // The oldest sector and the number of sectors in the log
+  size_t mTailSector{0};
+  size_t mSectorCount{0};
+
+  // The oldest record that might not be consumed and the end of the last read
+  Position mReadPosition{0, 0};
+  std::optional<Position> mReadEnd;
+
+  size_t mPendingRecords{0};
+  Counters mCounters;
+};
+
+template <typename Flash>
+std::optional<uint32_t> FlashLog<Flash>::readSequence(size_t sector) {
+  std::array<uint8_t, kFlashLogSectorHeaderSize> header;
+  if (!mFlash.read(address({sector, 0}), header) ||
+      readUInt32(std::span{header}.template first<4>()) != kFlashLogMagic) {
+    return std::nullopt;
+  }
+  return readUInt32(std::span{header}.template last<4>());
+}
+
+template <typename Flash>
+std::optional<typename FlashLog<Flash>::RecordHeader>
+FlashLog<Flash>::readRecordHeader(Position position) {
+  std::array<uint8_t, kFlashLogRecordHeaderSize> header;
+  if (!mFlash.read(address(position), header)) {
+    return std::nullopt;
+  }
+  return RecordHeader{header[0], uint16_t(header[1] | (header[2] << 8)),
+                      uint16_t(header[3] | (header[4] << 8))};
+}
+
+template <typename Flash>
+template <typename Function>
+std::optional<typename FlashLog<Flash>::Position>
+FlashLog<Flash>::walk(Position position, Function function) {
+  if (!mHeadSector) {
+    return position;
+  }
+
+  while (true) {
+    const auto isHead = position.sector == *mHeadSector;
+    const auto end = isHead ? mWriteOffset : mFlash.sectorSize();
+
+    if (position.offset + kFlashLogRecordHeaderSize <= end) {
+      const auto header = readRecordHeader(position);
+      if (!header) {
+        return std::nullopt;
+      }
+
+      const auto erased = header->state == 0xff && header->length == 0xffff &&
+                          header->crc == 0xffff;
+      const auto fits = header->length <= end - position.offset -
+                                              kFlashLogRecordHeaderSize;
+      if (!erased && fits) {
+        if (!function(position, *header)) {
+          return position;
+        }
+        position.offset += kFlashLogRecordHeaderSize + header->length;
+        continue;
+      }
+
+      // An erased header ends the records of the sector, a length that
+      // doesn't fit is the remainder of an interrupted write
+      if (isHead) {
+        return Position{position.sector, erased ? position.offset : end};
+      }
+    } else if (isHead) {
+      return position;
+    }
+
+    position = {nextSector(position.sector), kFlashLogSectorHeaderSize};
+  }
+}
+
+template <typename Flash> bool FlashLog<Flash>::mount() {
+  mHeadSector.reset();
+  mSequence = 0;
+  mSectorCount = 0;
+  mReadEnd.reset();
+  mPendingRecords = 0;
+
+  for (size_t sector = 0; sector < mFlash.sectorCount(); sector++) {
+    const auto sequence = readSequence(sector);
+    if (sequence && (!mHeadSector || *sequence > mSequence)) {
+      mHeadSector = sector;
+      mSequence = *sequence;
+    }
+  }
+
+  if (!mHeadSector) {
+    return true;
+  }
+
+  // Older sectors precede the head with consecutive sequence numbers, other
+  // sectors are left over from before the log wrapped or was reformatted
+  mTailSector = *mHeadSector;
+  mSectorCount = 1;
+  while (mSectorCount < mFlash.sectorCount()) {
+    const auto previous =
+        (mTailSector + mFlash.sectorCount() - 1) % mFlash.sectorCount();
+    const auto sequence = readSequence(previous);
+    if (!sequence || *sequence != mSequence - mSectorCount) {
+      break;
+    }
+    mTailSector = previous;
+    mSectorCount++;
+  }
+
+  // Find the end of the head sector, then the oldest unconsumed record
+  mWriteOffset = mFlash.sectorSize();
+  const auto end = walk({*mHeadSector, kFlashLogSectorHeaderSize},
+                        [](Position, const RecordHeader&) { return true; });
+  if (!end) {
+    return false;
+  }
+  mWriteOffset = end->offset;
+
+  std::optional<Position> first;
+  const auto walked =
+      walk({mTailSector, kFlashLogSectorHeaderSize},
+           [&](Position position, const RecordHeader& header) {
+             if (header.state == kRecordCommitted) {
+               if (!first) {
+                 first = position;
+               }
+               mPendingRecords++;
+             }
+             return true;
+           });
+  if (!walked) {
+    return false;
+  }
+  mReadPosition = first ? *first : *walked;
+
+  return true;
+}
+
+template <typename Flash> bool FlashLog<Flash>::openSector() {
+  const auto sector = mHeadSector ? nextSector(*mHeadSector) : 0;
+
+  if (mHeadSector && mSectorCount == mFlash.sectorCount()) {
+    // The next sector is the oldest one. Records before the read position
+    // are consumed already, so only the ones after it are lost.
+    if (mReadPosition.sector == mTailSector) {
+      uint32_t dropped = 0;
+      walk(mReadPosition, [&](Position position, const RecordHeader& header) {
+        if (position.sector != mTailSector) {
+          return false;
+        }
+        dropped += header.state == kRecordCommitted;
+        return true;
+      });
+
+      mCounters.dropped += dropped;
+      mPendingRecords -= dropped;
+      mReadPosition = {nextSector(mTailSector), kFlashLogSectorHeaderSize};
+      mReadEnd.reset();
+    }
+
+    mTailSector = nextSector(mTailSector);
+    mSectorCount--;
+  }
+
+  std::array<uint8_t, kFlashLogSectorHeaderSize> header;
+  const auto sequence = mHeadSector ? mSequence + 1 : mSequence;
+  for (size_t i = 0; i < 4; i++) {
+    header[i] = static_cast<uint8_t>(kFlashLogMagic >> (8 * i));
+    header[4 + i] = static_cast<uint8_t>(sequence >> (8 * i));
+  }
+
+  // The magic is written last, an interrupted header doesn't look like the
+  // newest sector then
+  const auto bytes = std::span{header};
+  if (!mFlash.erase(sector) ||
+      !mFlash.write(address({sector, 4}), bytes.last(4)) ||
+      !mFlash.write(address({sector, 0}), bytes.first(4))) {
+    return false;
+  }
+
+  if (!mHeadSector) {
+    mTailSector = sector;
+    mReadPosition = {sector, kFlashLogSectorHeaderSize};
+  }
+  mHeadSector = sector;
+  mSequence = sequence;
+  mWriteOffset = kFlashLogSectorHeaderSize;
+  mSectorCount++;
+  return true;
+}
+
+template <typename Flash>
+bool FlashLog<Flash>::writeState(Position position, uint8_t state) {
+  const std::array<uint8_t, 1> bytes{state};
+  return mFlash.write(address(position), bytes);
+}
+
+template <typename Flash>
+bool FlashLog<Flash>::append(std::span<const uint8_t> payload) {
+  if (payload.size() > maxPayloadSize()) {
+    return false;
+  }
+
+  const auto size = kFlashLogRecordHeaderSize + payload.size();
+  if ((!mHeadSector || mWriteOffset + size > mFlash.sectorSize()) &&
+      !openSector()) {
+    mCounters.failedAppends++;
+    return false;
+  }
+
+  spymarine::CrcState crc;
+  crc.update(payload);
+  const std::array<uint8_t, kFlashLogRecordHeaderSize> header{
+      kRecordWritten, static_cast<uint8_t>(payload.size()),
+      static_cast<uint8_t>(payload.size() >> 8),
+      static_cast<uint8_t>(crc.value()),
+      static_cast<uint8_t>(crc.value() >> 8)};
+
+  const Position position{*mHeadSector, mWriteOffset};
+  if (!mFlash.write(address(position), header) ||
+      !mFlash.write(address(position) + header.size(), payload)) {
+    // The state of the sector is unknown, continue in the next one
+    mWriteOffset = mFlash.sectorSize();
+    mCounters.failedAppends++;
+    return false;
+  }
+
+  mWriteOffset += size;
+  if (!writeState(position, kRecordCommitted)) {
+    mCounters.failedAppends++;
+    return false;
+  }
+
+  mCounters.appended++;
+  mPendingRecords++;
+  return true;
+}
+
+template <typename Flash>
+template <typename Function>
+size_t FlashLog<Flash>::read(std::span<uint8_t> buffer, Function function) {
+  size_t count = 0;
+  size_t used = 0;
+
+  mReadEnd = walk(
+      mReadPosition, [&](Position position, const RecordHeader& header) {
+        if (header.state != kRecordCommitted) {
+          return true;
+        }
+        if (header.length > buffer.size() - used) {
+          return false;
+        }
+
+        const auto payload = buffer.subspan(used, header.length);
+        if (!mFlash.read(address(position) + kFlashLogRecordHeaderSize,
+                         payload)) {
+          return false;
+        }
+
+        spymarine::CrcState crc;
+        crc.update(payload);
+        if (crc.value() != header.crc) {
+          // Consumed with the others so it isn't read again
+          mCounters.corrupted++;
+          return true;
+        }
+
+        function(std::span<const uint8_t>{payload});
+        used += header.length;
+        count++;
+        return true;
+      });
+
+  return count;
+}
+
+template <typename Flash> bool FlashLog<Flash>::consume() {
+  if (!mReadEnd) {
+    return true;
+  }
+
+  // Records appended since the read might follow the end of the read
+  const auto end = *mReadEnd;
+  const auto isBeforeEnd = [&](Position position) {
+    const auto index = ringIndex(position.sector);
+    const auto endIndex = ringIndex(end.sector);
+    return index < endIndex ||
+           (index == endIndex && position.offset < end.offset);
+  };
+
+  auto failed = false;
+  walk(mReadPosition, [&](Position position, const RecordHeader& header) {
+    if (!isBeforeEnd(position)) {
+      return false;
+    }
+    if (header.state == kRecordCommitted) {
+      if (!writeState(position, kRecordConsumed)) {
+        failed = true;
+        return false;
+      }
+      mPendingRecords--;
+    }
+    mReadPosition = position;
+    mReadPosition.offset += kFlashLogRecordHeaderSize + header.length;
+    return true;
+  });
+
+  if (!failed) {
+    mReadPosition = end;
+  }
+  mReadEnd.reset();
+  return !failed;
+}
@@ -0,0 +1,25 @@
+#include "FrameCapture.hpp"
+
+#include <algorithm>
+#include <limits>
+
+std::optional<std::span<const uint8_t>>
+writeCaptureRecord(std::span<uint8_t> buffer, uint32_t timestamp,
+                   std::span<const uint8_t> datagram) {
+  const auto size = captureRecordSize(datagram.size());
+  if (buffer.size() < size ||
+      datagram.size() > std::numeric_limits<uint16_t>::max()) {
+    return std::nullopt;
+  }
+
+  buffer[0] = static_cast<uint8_t>(timestamp);
+  buffer[1] = static_cast<uint8_t>(timestamp >> 8);
+  buffer[2] = static_cast<uint8_t>(timestamp >> 16);
+  buffer[3] = static_cast<uint8_t>(timestamp >> 24);
+  buffer[4] = static_cast<uint8_t>(datagram.size());
+  buffer[5] = static_cast<uint8_t>(datagram.size() >> 8);
+  std::copy(datagram.begin(), datagram.end(),
+            buffer.begin() + kCaptureRecordHeaderSize);
+
+  return buffer.first(size);
+}
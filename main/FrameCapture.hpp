@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+/* Recording format for raw Simarine datagrams, used to reproduce field
+ * problems off-device. A capture is a header followed by records. It is only
+ * ever appended to, so a capture can be streamed and a capture that was cut
+ * off is still readable up to its last complete record.
+ *
+ * All numbers are little endian. Layout of version 1:
+ *
+ *   header:
+ *     char[4] magic "SMCP"
+ *     uint8   version
+ *     uint8   reserved, 0
+ *     uint16  reserved, 0
+ *   for each datagram:
+ *     uint32  receive time in milliseconds on a monotonic clock, wraps
+ *     uint16  datagram length
+ *     uint8[] datagram
+ *
+ * Records are not aligned, a memory mapped capture can be read in place with
+ * readCapture.
+ */
+constexpr uint8_t kCaptureVersion = 1;
+constexpr size_t kCaptureHeaderSize = 8;
+constexpr size_t kCaptureRecordHeaderSize = 6;
+
+// The header every capture starts with
+constexpr std::array<uint8_t, kCaptureHeaderSize> kCaptureHeader{
+    'S', 'M', 'C', 'P', kCaptureVersion, 0, 0, 0};
+
+// Size of the record for a datagram of the given length
+constexpr size_t captureRecordSize(size_t datagramSize) {
+  return kCaptureRecordHeaderSize + datagramSize;
+}
+
+/* Encodes a record of datagram into buffer. Returns the written bytes or
+ * std::nullopt if buffer is too small or datagram too large for a record.
+ */
+std::optional<std::span<const uint8_t>>
+writeCaptureRecord(std::span<uint8_t> buffer, uint32_t timestamp,
+                   std::span<const uint8_t> datagram);
+
+/* Reads a capture written as kCaptureHeader followed by
+ * writeCaptureRecord records. Calls
+ * function with the timestamp and datagram of every complete record, an
+ * incomplete record at the end is ignored. Returns the number of records or
+ * std::nullopt if bytes doesn't start with a header of a known version.
+ */
+template <typename Function>
+std::optional<size_t> readCapture(std::span<const uint8_t> bytes,
+                                  Function function);
+
+template <typename Function>
+std::optional<size_t> readCapture(std::span<const uint8_t> bytes,
+                                  Function function) {
+  if (bytes.size() < kCaptureHeaderSize ||
+      !std::equal(kCaptureHeader.begin(), kCaptureHeader.begin() + 5,
+                  bytes.begin())) {
+    return std::nullopt;
+  }
+
+  size_t count = 0;
+  auto records = bytes.subspan(kCaptureHeaderSize);
+
+  while (records.size() >= kCaptureRecordHeaderSize) {
+    const auto timestamp = uint32_t(records[0]) | (uint32_t(records[1]) << 8) |
+                           (uint32_t(records[2]) << 16) |
+                           (uint32_t(records[3]) << 24);
+    const auto length = size_t(records[4]) | (size_t(records[5]) << 8);
+    if (records.size() < captureRecordSize(length)) {
+      break;
+    }
+
+    function(timestamp, records.subspan(kCaptureRecordHeaderSize, length));
+    records = records.subspan(captureRecordSize(length));
+    count++;
+  }
+
+  return count;
+}
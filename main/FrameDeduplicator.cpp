@@ -0,0 +1,47 @@
+#include "FrameDeduplicator.hpp"
+
+#include "spymarine/Parsing.hpp"
+
+std::optional<FrameDeduplicator::Key>
+FrameDeduplicator::key(std::span<const uint8_t> frame) {
+  if (frame.size() < spymarine::kHeaderLength + 2) {
+    return std::nullopt;
+  }
+
+  return Key{
+      static_cast<uint16_t>((frame[frame.size() - 2] << 8) |
+                            frame[frame.size() - 1]),
+      static_cast<uint16_t>(frame.size()),
+      frame[6],
+  };
+}
+
+bool FrameDeduplicator::isDuplicate(std::span<const uint8_t> frame,
+                                    Clock::time_point now) {
+  const auto frameKey = key(frame);
+  if (!frameKey) {
+    return false;
+  }
+
+  for (const auto& entry : mEntries) {
+    if (entry.used && entry.key == *frameKey && now - entry.time < mWindow) {
+      mCounters.duplicates++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void FrameDeduplicator::accept(std::span<const uint8_t> frame,
+                               Clock::time_point now) {
+  mCounters.accepted++;
+  const auto frameKey = key(frame);
+  if (!frameKey) {
+    return;
+  }
+
+  // Replaces the oldest entry, a key that is still in the history but outside
+  // of the window is simply shadowed by the newer entry
+  mEntries[mNextEntry] = {*frameKey, now, true};
+  mNextEntry = (mNextEntry + 1) % kHistorySize;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+/*! Recognizes repeated Simarine frames without parsing them.
+ *
+ *  The Pico broadcasts the same sensor state frame several times. A frame is
+ *  identified by its type, length and the trailing CRC it already carries, so
+ *  neither the CRC nor the values need to be calculated for a repeat. Frames
+ *  are a duplicate if the same key was accepted less than window ago. A frame
+ *  that keeps being repeated is therefore accepted once per window, which
+ *  keeps stable sensors in the aggregated values.
+ *
+ *  The trailing CRC is only checked by the parser, so a frame is only
+ *  remembered with accept() once the parser accepted it. Otherwise a
+ *  corrupted frame would suppress the valid frame with the same key.
+ *
+ *  Remembers the last kHistorySize keys and doesn't allocate. Frames that
+ *  are too short to carry a CRC are never a duplicate and are left to the
+ *  parser to reject.
+ */
+class FrameDeduplicator {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t kHistorySize = 8;
+
+  struct Counters {
+    uint32_t accepted{0};
+    uint32_t duplicates{0};
+  };
+
+  // A window of zero accepts every frame
+  explicit FrameDeduplicator(Clock::duration window) : mWindow{window} {}
+
+  // Returns true if frame repeats a frame that was accepted less than window
+  // before now
+  bool isDuplicate(std::span<const uint8_t> frame, Clock::time_point now);
+
+  // Remembers a frame that isn't a duplicate and was parsed successfully as
+  // accepted at now
+  void accept(std::span<const uint8_t> frame, Clock::time_point now);
+
+  // Number of accepted and duplicate frames since construction
+  const Counters& counters() const { return mCounters; }
+
+private:
+  struct Key {
+    uint16_t crc{0};
+    uint16_t length{0};
+    uint8_t type{0};
+
+    bool operator==(const Key&) const = default;
+  };
+
+  // The key of a frame, nullopt if it is too short to carry a CRC
+  static std::optional<Key> key(std::span<const uint8_t> frame);
+
+  struct Entry {
+    Key key;
+    Clock::time_point time;
+    bool used{false};
+  };
+
+  Clock::duration mWindow;
+  std::array<Entry, kHistorySize> mEntries{};
+  size_t mNextEntry{0};
+  Counters mCounters;
+};
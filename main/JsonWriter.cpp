@@ -1,9 +1,130 @@
 #include "JsonWriter.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+// Large enough for any 64 bit integer with sign and decimal point
+using NumberBuffer = std::array<char, 24>;
+
+constexpr std::string_view kNull = "null";
+
+/* Writes the decimal digits of value right-aligned into the end of buffer.
+ * Returns the position of the first digit.
+ */
+char* formatDigits(uint64_t value, char* end) {
+  do {
+    *--end = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  return end;
+}
+
+std::string_view formatInt(int64_t value, NumberBuffer& buffer) {
+  const auto magnitude = value < 0 ? 0 - static_cast<uint64_t>(value)
+                                   : static_cast<uint64_t>(value);
+  auto begin = formatDigits(magnitude, buffer.end());
+  if (value < 0) {
+    *--begin = '-';
+  }
+  return {begin, buffer.end()};
+}
+
+/* Formats value / 10^decimals exactly, without trailing zeros in the
+ * fractional part.
+ */
+std::string_view formatFixedPoint(int64_t value, unsigned decimals,
+                                  NumberBuffer& buffer) {
+  auto magnitude = value < 0 ? 0 - static_cast<uint64_t>(value)
+                             : static_cast<uint64_t>(value);
+
+  // Drop trailing zeros of the fractional part
+  while (decimals > 0 && magnitude % 10 == 0) {
+    magnitude /= 10;
+    decimals--;
+  }
+
+  auto begin = buffer.end();
+  for (; decimals > 0; decimals--) {
+    *--begin = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  }
+  if (begin != buffer.end()) {
+    *--begin = '.';
+  }
+  begin = formatDigits(magnitude, begin);
+  if (value < 0) {
+    *--begin = '-';
+  }
+  return {begin, buffer.end()};
+}
+
+// 10^kDoubleDecimals
+constexpr int64_t kDecimalScale = [] {
+  int64_t scale = 1;
+  for (unsigned i = 0; i < JsonWriter::kDoubleDecimals; i++) {
+    scale *= 10;
+  }
+  return scale;
+}();
+
+std::string_view formatDouble(double value, NumberBuffer& buffer) {
+  constexpr auto kScale = static_cast<double>(kDecimalScale);
+  // Largest magnitude that still fits into int64_t after scaling
+  constexpr double kMaxScaled = 9.2e18;
+
+  const auto scaled = std::round(value * kScale);
+  if (!std::isfinite(scaled) || std::fabs(scaled) >= kMaxScaled) {
+    return kNull;
+  }
+  return formatFixedPoint(static_cast<int64_t>(scaled),
+                          JsonWriter::kDoubleDecimals, buffer);
+}
+
+/* Formats numerator / denominator rounded half away from zero to
+ * kDoubleDecimals fractional digits by long division. The denominator has
+ * to be below UINT64_MAX / 10.
+ */
+std::string_view formatFraction(int64_t numerator, uint64_t denominator,
+                                NumberBuffer& buffer) {
+  constexpr int64_t kMaxIntegral =
+      std::numeric_limits<int64_t>::max() / kDecimalScale;
+
+  const auto magnitude = numerator < 0 ? 0 - static_cast<uint64_t>(numerator)
+                                       : static_cast<uint64_t>(numerator);
+  if (denominator == 0 || magnitude / denominator >= kMaxIntegral) {
+    return kNull;
+  }
+
+  auto scaled = magnitude / denominator;
+  auto remainder = magnitude % denominator;
+  for (unsigned i = 0; i < JsonWriter::kDoubleDecimals; i++) {
+    // remainder < denominator, which is far below UINT64_MAX / 10 for any
+    // count of samples times a sensor scale
+    remainder *= 10;
+    scaled = scaled * 10 + remainder / denominator;
+    remainder %= denominator;
+  }
+  if (remainder >= denominator - remainder) {
+    scaled++;
+  }
+
+  const auto value = static_cast<int64_t>(scaled);
+  return formatFixedPoint(numerator < 0 ? -value : value,
+                          JsonWriter::kDoubleDecimals, buffer);
+}
+
+} // namespace
+
 void JsonWriter::startArray() {
-  handleComma();
+  handleCommaForValue();
   writeChar('[');
   mCommaRequired = false;
+  mExpectObjectValue = false;
 }
 
 void JsonWriter::endArray() {
@@ -12,9 +133,10 @@ void JsonWriter::endArray() {
 }
 
 void JsonWriter::startObject() {
-  handleComma();
+  handleCommaForValue();
   writeChar('{');
   mCommaRequired = false;
+  mExpectObjectValue = false;
 }
 
 void JsonWriter::endObject() {
@@ -33,56 +155,66 @@ void JsonWriter::addObjectKey(std::string_view key) {
   mExpectObjectValue = true;
 }
 
-void JsonWriter::addInt(int value) {
+void JsonWriter::addInt(int64_t value) {
   handleCommaForValue();
-  writeFormattedValue("%d", value);
+  NumberBuffer buffer;
+  writeData(formatInt(value, buffer));
   mCommaRequired = true;
 }
 
 void JsonWriter::addDouble(double value) {
   handleCommaForValue();
-  writeFormattedValue("%g", value);
+  NumberBuffer buffer;
+  writeData(formatDouble(value, buffer));
   mCommaRequired = true;
 }
 
-std::string_view JsonWriter::string() const { return {mBuffer.data(), mPos}; }
-void JsonWriter::writeData(std::span<const char> data) {
-  reserve(data.size());
-  std::copy(data.begin(), data.end(), mBuffer.begin() + mPos);
-  mPos += data.size();
+void JsonWriter::addFixedPoint(int64_t numerator, uint64_t denominator) {
+  handleCommaForValue();
+  NumberBuffer buffer;
+  writeData(formatFraction(numerator, denominator, buffer));
+  mCommaRequired = true;
 }
 
-void JsonWriter::writeChar(char c) { writeData(std::array<const char, 1>{c}); }
-
-template <typename T>
-void JsonWriter::writeFormattedValue(const char* formatString, T value) {
-  auto write = [&]() {
-    std::span<char> writeBuffer{mBuffer.data() + mPos,
-                                mBuffer.size() - mPos + 1};
-    return std::snprintf(writeBuffer.data(), writeBuffer.size(), formatString,
-                         value);
-  };
+void JsonWriter::addNull() {
+  handleCommaForValue();
+  writeData(kNull);
+  mCommaRequired = true;
+}
 
-  const auto length = write();
+std::string_view JsonWriter::string() const {
+  return {mStorage.data(), mPos};
+}
 
-  if (reserve(length)) {
-    // Formatted value didn't fit the first time so let's write it again
-    write();
+void JsonWriter::writeData(std::span<const char> data) {
+  if (reserve(data.size())) {
+    std::copy(data.begin(), data.end(), mStorage.begin() + mPos);
+    mPos += data.size();
   }
-
-  mPos += length;
 }
 
-template void JsonWriter::writeFormattedValue<int>(const char* formatString,
-                                                   int value);
-template void JsonWriter::writeFormattedValue<double>(const char* formatString,
-                                                      double value);
+void JsonWriter::writeChar(char c) {
+  if (reserve(1)) {
+    mStorage[mPos++] = c;
+  }
+}
 
 bool JsonWriter::reserve(size_t size) {
-  if (mBuffer.size() - mPos < size) {
-    mBuffer.resize(mPos + size);
+  if (mOverflow) {
+    return false;
+  }
+
+  if (mStorage.size() - mPos >= size) {
+    return true;
+  }
+
+  if (mpBuffer) {
+    mpBuffer->resize(std::max(mPos + size, 2 * mpBuffer->size()));
+    mStorage = *mpBuffer;
     return true;
   }
+
+  mOverflow = true;
   return false;
 }
 
@@ -1,22 +1,37 @@
 #pragma once
 
-#include <cstdio>
+#include <cstddef>
+#include <cstdint>
 #include <span>
 #include <string_view>
 #include <vector>
 
-/*! A simple JSON string writer that reuses a buffer to reduce
- *  allocations.
+/*! A simple JSON string writer that either writes into a fixed buffer
+ *  or reuses a growable buffer to reduce allocations.
  *
  *  Strings are not escaped.
  *  Inputs are not validated.
  *  Order of methods are not validated.
+ *
+ *  Numbers are formatted without printf. Doubles are written in fixed-point
+ *  notation with up to kDoubleDecimals fractional digits, trailing zeros are
+ *  removed. Non-finite doubles and doubles too large for fixed-point notation
+ *  are written as null. Fractions of integers are written the same way, but
+ *  rounded exactly.
  */
 using JsonBuffer = std::vector<char>;
 
 class JsonWriter {
 public:
-  explicit JsonWriter(JsonBuffer& buffer) : mBuffer{buffer} {}
+  static constexpr unsigned kDoubleDecimals = 6;
+
+  // Writes into buffer and grows it if needed
+  explicit JsonWriter(JsonBuffer& buffer)
+      : mpBuffer{&buffer}, mStorage{buffer} {}
+
+  // Writes into buffer without allocating. Sets overflow() if the buffer is
+  // too small, all further writes are dropped in that case.
+  explicit JsonWriter(std::span<char> buffer) : mStorage{buffer} {}
 
   void startArray();
   void endArray();
@@ -25,25 +40,35 @@ public:
   void endObject();
 
   void addObjectKey(std::string_view key);
-  void addInt(int value);
+  void addInt(int64_t value);
   void addDouble(double value);
 
+  /* Writes numerator / denominator exactly rounded to kDoubleDecimals
+   * fractional digits, without converting to double. Writes null if the
+   * denominator is 0 or the value is too large.
+   */
+  void addFixedPoint(int64_t numerator, uint64_t denominator);
+
+  void addNull();
+
+  // True if a fixed buffer was too small for the written data
+  bool overflow() const { return mOverflow; }
+
   std::string_view string() const;
 
 private:
   void writeData(std::span<const char> data);
   void writeChar(char c);
 
-  template <typename T>
-  void writeFormattedValue(const char* formatString, T value);
-
   bool reserve(size_t size);
 
   void handleCommaForValue();
   void handleComma();
 
-  JsonBuffer& mBuffer;
+  JsonBuffer* mpBuffer{nullptr};
+  std::span<char> mStorage;
   size_t mPos{0};
+  bool mOverflow{false};
   bool mCommaRequired{false};
   bool mExpectObjectValue{false};
 };
@@ -0,0 +1,119 @@
+#include "Metrics.hpp"
+
+#include <string_view>
+#include <utility>
+
+namespace {
+
+// Largest value of a bucket
+uint32_t upperBound(size_t bucket) {
+  return bucket == 0 ? 0 : static_cast<uint32_t>((uint64_t{1} << bucket) - 1);
+}
+
+void writeCounter(JsonWriter& writer, std::string_view name,
+                  const MetricCounter& counter) {
+  writer.addObjectKey(name);
+  writer.addInt(counter.value());
+}
+
+/* With optional, a histogram without values is written as null, i.e. not
+ * measured, instead of a count of 0
+ */
+void writeHistogram(JsonWriter& writer, std::string_view name,
+                    MetricHistogram& histogram, bool optional = false) {
+  const auto summary = histogram.summarize();
+  writer.addObjectKey(name);
+  if (optional && summary.count == 0) {
+    writer.addNull();
+    return;
+  }
+  writer.startObject();
+  writer.addObjectKey("count");
+  writer.addInt(summary.count);
+  writer.addObjectKey("p50");
+  writer.addInt(summary.p50);
+  writer.addObjectKey("p90");
+  writer.addInt(summary.p90);
+  writer.addObjectKey("p99");
+  writer.addInt(summary.p99);
+  writer.addObjectKey("max");
+  writer.addInt(summary.max);
+  writer.endObject();
+}
+
+} // namespace
+
+HistogramSummary MetricHistogram::summarize() {
+  std::array<uint32_t, kBucketCount> counts;
+  uint32_t total = 0;
+  for (size_t i = 0; i < kBucketCount; i++) {
+    const auto value = mBuckets[i].load(std::memory_order_relaxed);
+    counts[i] = value - mReported[i];
+    mReported[i] = value;
+    total += counts[i];
+  }
+
+  HistogramSummary summary{total, 0, 0, 0, 0};
+  if (total == 0) {
+    return summary;
+  }
+
+  // Ranks of the quantiles, rounded up
+  const auto rank = [&](uint32_t percent) {
+    return static_cast<uint32_t>((uint64_t{total} * percent + 99) / 100);
+  };
+  const std::array<std::pair<uint32_t*, uint32_t>, 3> quantiles{{
+      {&summary.p50, rank(50)},
+      {&summary.p90, rank(90)},
+      {&summary.p99, rank(99)},
+  }};
+
+  uint32_t cumulative = 0;
+  for (size_t i = 0; i < kBucketCount; i++) {
+    if (counts[i] == 0) {
+      continue;
+    }
+    cumulative += counts[i];
+    for (const auto& [quantile, quantileRank] : quantiles) {
+      if (*quantile == 0 && cumulative >= quantileRank) {
+        *quantile = upperBound(i);
+      }
+    }
+    summary.max = upperBound(i);
+  }
+
+  return summary;
+}
+
+void writeMetricsJson(JsonWriter& writer, PipelineMetrics& metrics,
+                      uint32_t uptimeSeconds, uint32_t minimumFreeHeap) {
+  writer.startObject();
+  writer.addObjectKey("uptime");
+  writer.addInt(uptimeSeconds);
+  writer.addObjectKey("min_free_heap");
+  writer.addInt(minimumFreeHeap);
+
+  writeCounter(writer, "batches", metrics.batches);
+  writeCounter(writer, "datagrams", metrics.datagrams);
+  writeCounter(writer, "duplicates", metrics.duplicates);
+  writeCounter(writer, "rejected_frames", metrics.rejectedFrames);
+  writeCounter(writer, "crc_mismatches", metrics.crcMismatches);
+  writeCounter(writer, "samples", metrics.samples);
+  writeCounter(writer, "dropped_samples", metrics.droppedSamples);
+  writeHistogram(writer, "frame_cycles", metrics.frameCycles);
+
+  writeHistogram(writer, "sample_cycles", metrics.sampleCycles);
+  writeHistogram(writer, "serialize_cycles", metrics.serializeCycles);
+  writeHistogram(writer, "oldest_sample_ms", metrics.oldestSampleMilliseconds);
+  writeHistogram(writer, "newest_sample_ms", metrics.newestSampleMilliseconds);
+  writeCounter(writer, "publishes", metrics.publish.publishes);
+  writeCounter(writer, "failed_publishes", metrics.publish.failedPublishes);
+  writeCounter(writer, "published_bytes", metrics.publish.publishedBytes);
+  writeHistogram(writer, "publish_us", metrics.publish.publishMicroseconds);
+  // Publishes with QoS 0 or without tracing have no acknowledgement latency
+  writeHistogram(writer, "ack_us", metrics.publish.acknowledgeMicroseconds,
+                 true);
+  writeCounter(writer, "untracked_acks",
+               metrics.publish.untrackedAcknowledgements);
+  writer.endObject();
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "JsonWriter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+/*! A counter that is updated by a single task and read by any task.
+ *
+ *  Updates are a relaxed load and store instead of a read-modify-write, so
+ *  they cost about as much as incrementing a plain integer and never block.
+ *  Updates from several tasks would lose increments, counters updated by
+ *  several tasks have to use addShared instead.
+ */
+class MetricCounter {
+public:
+  void add(uint32_t count = 1) {
+    mValue.store(mValue.load(std::memory_order_relaxed) + count,
+                 std::memory_order_relaxed);
+  }
+
+  // Like add, but safe to call from several tasks
+  void addShared(uint32_t count = 1) {
+    mValue.fetch_add(count, std::memory_order_relaxed);
+  }
+
+  uint32_t value() const { return mValue.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint32_t> mValue{0};
+};
+
+// Summary of the values recorded by a MetricHistogram in an interval
+struct HistogramSummary {
+  uint32_t count;
+  uint32_t p50;
+  uint32_t p90;
+  uint32_t p99;
+  uint32_t max;
+};
+
+/*! Distribution of values, e.g. durations in CPU cycles, in fixed buckets
+ *  with power of two bounds: bucket 0 counts zeros and bucket i the values
+ *  from 2^(i - 1) to 2^i - 1. Quantiles are reported as the upper bound of
+ *  their bucket, so they are at most twice the actual value.
+ *
+ *  Like MetricCounter, values are recorded by a single task with record or
+ *  by several tasks with recordShared. A single reporting task summarizes
+ *  them, the buckets are never reset so recording doesn't race with
+ *  reporting.
+ */
+class MetricHistogram {
+public:
+  static constexpr size_t kBucketCount = 33;
+
+  void record(uint32_t value) {
+    auto& bucket = mBuckets[std::bit_width(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+  }
+
+  // Like record, but safe to call from several tasks
+  void recordShared(uint32_t value) {
+    mBuckets[std::bit_width(value)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Summarizes the values recorded since the last call
+  HistogramSummary summarize();
+
+private:
+  std::array<std::atomic<uint32_t>, kBucketCount> mBuckets{};
+  std::array<uint32_t, kBucketCount> mReported{};
+};
+
+// Metrics of MqttClient::publish, updated by the publishing task unless
+// noted otherwise
+struct PublishMetrics {
+  MetricCounter publishes;
+  MetricCounter failedPublishes;
+  MetricCounter publishedBytes;
+  MetricHistogram publishMicroseconds;
+
+  // Updated by the publishing or the MQTT task, whichever completes the
+  // match, so with recordShared and addShared only.
+
+  // From handing a message with QoS 1 or 2 to the client until the broker
+  // acknowledged it, only if acknowledgements are traced
+  MetricHistogram acknowledgeMicroseconds;
+  // Publishes and acknowledgements that were never matched
+  MetricCounter untrackedAcknowledgements;
+};
+
+// What the receiving task counted in a batch of datagrams
+struct ReceiveBatchCounts {
+  uint32_t datagrams;
+  uint32_t duplicates;
+  uint32_t rejectedFrames;
+  uint32_t crcMismatches;
+  uint32_t samples;
+  uint32_t droppedSamples;
+};
+
+/*! Metrics of the receive, aggregate and publish path. Durations are in CPU
+ *  cycles unless their name says otherwise.
+ */
+struct PipelineMetrics {
+  // One in kTimedBatchInterval batches is timed for frameCycles, reading
+  // the cycle counter twice per batch costs more than all the counters
+  static constexpr uint32_t kTimedBatchInterval = 32;
+
+  // True if the next batch has to be timed, see recordReceiveBatch
+  bool timesNextBatch() const {
+    return batches.value() % kTimedBatchInterval == 0;
+  }
+
+  /* Records a batch of datagrams and, if timesNextBatch() was true before
+   * it, the number of cycles it took. Called once per batch to keep the
+   * cost off the per frame path.
+   */
+  void recordReceiveBatch(const ReceiveBatchCounts& counts,
+                          std::optional<uint32_t> cycles = std::nullopt) {
+    if (cycles) {
+      frameCycles.record(*cycles / std::max<uint32_t>(counts.datagrams, 1));
+    }
+    batches.add();
+    datagrams.add(counts.datagrams);
+    duplicates.add(counts.duplicates);
+    rejectedFrames.add(counts.rejectedFrames);
+    crcMismatches.add(counts.crcMismatches);
+    samples.add(counts.samples);
+    droppedSamples.add(counts.droppedSamples);
+  }
+
+  // Updated by the receiving task, per batch of datagrams
+  MetricCounter batches;
+  MetricCounter datagrams;
+  MetricCounter duplicates;
+  MetricCounter rejectedFrames;
+  MetricCounter crcMismatches;
+  MetricCounter samples;
+  MetricCounter droppedSamples;
+  // Deduplicating, decoding and queueing a frame, averaged over its batch,
+  // of one in kTimedBatchInterval batches
+  MetricHistogram frameCycles;
+
+  // Updated by the aggregating and publishing task
+  // Aggregating a sample, averaged over the samples of a wake up
+  MetricHistogram sampleCycles;
+  // Serializing the JSON payload of a window
+  MetricHistogram serializeCycles;
+  // Time from receiving the oldest and newest sample of a window until it is
+  // handed to the MQTT client
+  MetricHistogram oldestSampleMilliseconds;
+  MetricHistogram newestSampleMilliseconds;
+  PublishMetrics publish;
+};
+
+/* Writes the metrics as a flat JSON object, histograms as objects with
+ * count, p50, p90, p99 and max of the values since the last call. Counters
+ * are totals since boot. Must only be called by one task.
+ *
+ *   {"uptime": 3600, "min_free_heap": 123456, "datagrams": 36000, ...,
+ *    "frame_cycles": {"count": 4500, "p50": 8191, ...}, ...}
+ */
+void writeMetricsJson(JsonWriter& writer, PipelineMetrics& metrics,
+                      uint32_t uptimeSeconds, uint32_t minimumFreeHeap);
@@ -1,7 +1,9 @@
 #include "MqttClient.hpp"
 
 #include "esp_log.h"
+#include "esp_timer.h"
 
+#include <algorithm>
 #include <cstdint>
 
 namespace {
@@ -14,16 +16,42 @@ void logError(const char* message, int errorCode) {
   }
 }
 
-void eventHandler(void* handlerArgs, esp_event_base_t base, int32_t eventId,
-                  void* eventData) {
+// Microseconds since boot, wrapping around after about 71 minutes
+uint32_t microseconds() {
+  return static_cast<uint32_t>(esp_timer_get_time());
+}
+
+} // namespace
+
+void MqttClient::eventHandler(void* handlerArgs, esp_event_base_t base,
+                              int32_t eventId, void* eventData) {
+  auto& client = *static_cast<MqttClient*>(handlerArgs);
   const auto event = reinterpret_cast<esp_mqtt_event_handle_t>(eventData);
   switch (static_cast<esp_mqtt_event_id_t>(eventId)) {
   case MQTT_EVENT_CONNECTED:
     ESP_LOGI(TAG, "MQTT client connected");
+    client.mConnected = true;
+    if (const auto task = client.mConnectTask.load()) {
+      xTaskNotifyGive(task);
+    }
     break;
   case MQTT_EVENT_DISCONNECTED:
     ESP_LOGI(TAG, "MQTT client disconnected");
+    client.mConnected = false;
+    break;
+  case MQTT_EVENT_PUBLISHED: {
+    const auto now = microseconds();
+    taskENTER_CRITICAL(&client.mTrackerLock);
+    client.mAcknowledged[client.mNextAcknowledged] = event->msg_id;
+    client.mNextAcknowledged =
+        (client.mNextAcknowledged + 1) % client.mAcknowledged.size();
+    if (client.mMetrics && client.mTraceAcknowledgements) {
+      client.recordAcknowledgement(
+          client.mTracker.acknowledged(event->msg_id, now));
+    }
+    taskEXIT_CRITICAL(&client.mTrackerLock);
     break;
+  }
   case MQTT_EVENT_ERROR:
     ESP_LOGI(TAG, "MQTT client error");
     if (event->error_handle->error_type == MQTT_ERROR_TYPE_TCP_TRANSPORT) {
@@ -42,12 +70,13 @@ void eventHandler(void* handlerArgs, esp_event_base_t base, int32_t eventId,
   }
 }
 
-} // namespace
-
 MqttClient::MqttClient(const char* brokerUri, const char* rootCaCertificate,
                        const char* deviceCertificate,
                        const char* devicePrivateKey)
     : mClient{nullptr} {
+  // Message ids are positive
+  mAcknowledged.fill(-1);
+
   esp_mqtt_client_config_t config{};
 
   config.broker.address.uri = brokerUri;
@@ -58,7 +87,7 @@ MqttClient::MqttClient(const char* brokerUri, const char* rootCaCertificate,
   mClient = esp_mqtt_client_init(&config);
 
   ESP_ERROR_CHECK(esp_mqtt_client_register_event(mClient, MQTT_EVENT_ANY,
-                                                 eventHandler, nullptr));
+                                                 eventHandler, this));
 
   ESP_ERROR_CHECK(esp_mqtt_client_start(mClient));
 }
@@ -69,9 +98,73 @@ MqttClient::~MqttClient() {
   ESP_ERROR_CHECK(esp_mqtt_client_stop(mClient));
 }
 
-void MqttClient::publish(const char* topic, std::string_view data) {
-  if (esp_mqtt_client_publish(mClient, topic, data.data(), data.size(), 0, 0) <
-      0) {
+/* Records the latency of a matched acknowledgement and how many entries the
+ * tracker dropped. Called with mTrackerLock held.
+ */
+void MqttClient::recordAcknowledgement(std::optional<uint32_t> latency) {
+  if (latency) {
+    mMetrics->acknowledgeMicroseconds.recordShared(*latency);
+  }
+  // Only updated here, so it follows the count of the tracker
+  auto& untracked = mMetrics->untrackedAcknowledgements;
+  untracked.addShared(mTracker.dropped() - untracked.value());
+}
+
+bool MqttClient::publish(const char* topic, std::string_view data, int qos,
+                         bool retain) {
+  return send(topic, data, qos, retain) >= 0;
+}
+
+bool MqttClient::publish(const char* topic, std::span<const uint8_t> data,
+                         int qos, bool retain) {
+  return publish(topic,
+                 std::string_view{reinterpret_cast<const char*>(data.data()),
+                                  data.size()},
+                 qos, retain);
+}
+
+std::optional<int>
+MqttClient::publishAcknowledged(const char* topic,
+                                std::span<const uint8_t> data) {
+  const auto messageId = send(
+      topic,
+      std::string_view{reinterpret_cast<const char*>(data.data()), data.size()},
+      1, false);
+  return messageId >= 0 ? std::optional{messageId} : std::nullopt;
+}
+
+bool MqttClient::acknowledged(int messageId) {
+  taskENTER_CRITICAL(&mTrackerLock);
+  const auto found = std::find(mAcknowledged.begin(), mAcknowledged.end(),
+                               messageId) != mAcknowledged.end();
+  taskEXIT_CRITICAL(&mTrackerLock);
+  return found;
+}
+
+int MqttClient::send(const char* topic, std::string_view data, int qos,
+                     bool retain) {
+  const auto start = microseconds();
+  const auto messageId = esp_mqtt_client_publish(mClient, topic, data.data(),
+                                                 data.size(), qos, retain);
+  const auto published = messageId >= 0;
+
+  if (mMetrics) {
+    mMetrics->publishMicroseconds.record(microseconds() - start);
+    if (published && mTraceAcknowledgements) {
+      taskENTER_CRITICAL(&mTrackerLock);
+      recordAcknowledgement(mTracker.published(messageId, qos, start));
+      taskEXIT_CRITICAL(&mTrackerLock);
+    }
+    if (published) {
+      mMetrics->publishes.add();
+      mMetrics->publishedBytes.add(data.size());
+    } else {
+      mMetrics->failedPublishes.add();
+    }
+  }
+
+  if (!published) {
     ESP_LOGE(TAG, "Couldn't publish message");
   }
+  return messageId;
 }
@@ -1,15 +1,79 @@
+#include "Metrics.hpp"
+#include "PublishTracker.hpp"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "mqtt_client.h"
 
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
 #include <string_view>
 
 class MqttClient {
 public:
+  static constexpr size_t kAcknowledgedCapacity = 16;
+
   MqttClient(const char* brokerUri, const char* rootCaCertificate,
              const char* deviceCertificate, const char* devicePrivateKey);
   ~MqttClient();
 
-  void publish(const char* topic, std::string_view data);
+  /* Returns false if the message couldn't be sent or, for QoS 1 and 2,
+   * queued for sending. The broker keeps the last retained message of a
+   * topic for new subscribers.
+   */
+  bool publish(const char* topic, std::string_view data, int qos = 0,
+               bool retain = false);
+  bool publish(const char* topic, std::span<const uint8_t> data, int qos = 0,
+               bool retain = false);
+
+  /* Publishes data with QoS 1 and returns the id of the message for
+   * acknowledged(), or std::nullopt if it couldn't be queued.
+   */
+  std::optional<int> publishAcknowledged(const char* topic,
+                                         std::span<const uint8_t> data);
+
+  /* True once the broker acknowledged the message with the given id. Only
+   * the last kAcknowledgedCapacity acknowledgements are kept.
+   */
+  bool acknowledged(int messageId);
+
+  bool connected() const { return mConnected; }
+
+  // Notifies task with xTaskNotifyGive whenever the client (re)connects
+  void notifyOnConnect(TaskHandle_t task) { mConnectTask = task; }
+
+  /* Counts publishes and their duration in metrics, which has to outlive
+   * the client. Publishing has to happen in a single task then. With
+   * traceAcknowledgements the time until the broker acknowledged a message
+   * with QoS 1 or 2 is measured as well.
+   */
+  void recordMetrics(PublishMetrics& metrics,
+                     bool traceAcknowledgements = false) {
+    mTraceAcknowledgements = traceAcknowledgements;
+    mMetrics = &metrics;
+  }
 
 private:
+  static void eventHandler(void* handlerArgs, esp_event_base_t base,
+                           int32_t eventId, void* eventData);
+
+  // Returns the id of the message or a negative value on failure
+  int send(const char* topic, std::string_view data, int qos, bool retain);
+  void recordAcknowledgement(std::optional<uint32_t> latency);
+
   esp_mqtt_client_handle_t mClient;
+  std::atomic<bool> mConnected{false};
+  std::atomic<TaskHandle_t> mConnectTask{nullptr};
+  PublishMetrics* mMetrics{nullptr};
+  bool mTraceAcknowledgements{false};
+  // Shared by the publishing and the MQTT task
+  portMUX_TYPE mTrackerLock = portMUX_INITIALIZER_UNLOCKED;
+  PublishTracker mTracker;
+  // Ids of the last acknowledged messages, the oldest one is overwritten
+  std::array<int, kAcknowledgedCapacity> mAcknowledged;
+  size_t mNextAcknowledged{0};
 };
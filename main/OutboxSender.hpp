@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <span>
+
+/*! Publishes the records of an outbox, a FlashLog, with QoS 1 and removes
+ *  them once the broker acknowledged them, so windows are only lost if the
+ *  outbox overflows. Records are concatenated into batches that fit into
+ *  buffer, one batch is in flight at a time.
+ *
+ *  Client provides connected(), publishAcknowledged(topic, bytes), which
+ *  returns the id of the message or std::nullopt if it wasn't queued, and
+ *  acknowledged(id) like MqttClient. A batch that isn't acknowledged within
+ *  the timeout, e.g. because the client dropped it with the connection, is
+ *  published again. Records are delivered at least once.
+ *
+ *  Doesn't block: send() publishes at most one batch and returns, the task
+ *  calls it again on its next wake up.
+ */
+template <typename Log> class OutboxSender {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  OutboxSender(Log& log, const char* topic, std::span<uint8_t> buffer,
+               Clock::duration timeout)
+      : mLog{log}, mTopic{topic}, mBuffer{buffer}, mTimeout{timeout} {}
+
+  /* Consumes the batch in flight if it was acknowledged and publishes the
+   * next one if there is none in flight. Returns the number of records
+   * consumed.
+   */
+  template <typename Client>
+  size_t send(Client& client, Clock::time_point now) {
+    size_t consumed = 0;
+    if (mInFlight) {
+      if (client.acknowledged(mInFlight->messageId)) {
+        // Consuming also skips corrupted records. On flash errors the
+        // records are published again.
+        consumed = mLog.consume() ? mInFlight->records : 0;
+        mInFlight.reset();
+      } else if (now - mInFlight->published >= mTimeout) {
+        mInFlight.reset();
+      } else {
+        return 0;
+      }
+    }
+
+    if (!client.connected() || mLog.pendingRecords() == 0) {
+      return consumed;
+    }
+
+    // Payloads are read back to back into the buffer
+    size_t size = 0;
+    const auto records =
+        mLog.read(mBuffer, [&](std::span<const uint8_t> payload) {
+          size += payload.size();
+        });
+    if (records == 0) {
+      // Only corrupted records were read, skip them
+      mLog.consume();
+      return consumed;
+    }
+
+    if (const auto messageId =
+            client.publishAcknowledged(mTopic, mBuffer.first(size))) {
+      mInFlight = InFlight{*messageId, now, records};
+    }
+    return consumed;
+  }
+
+  // True while a batch waits for its acknowledgement
+  bool inFlight() const { return mInFlight.has_value(); }
+
+private:
+  struct InFlight {
+    int messageId;
+    Clock::time_point published;
+    size_t records;
+  };
+
+  Log& mLog;
+  const char* mTopic;
+  std::span<uint8_t> mBuffer;
+  Clock::duration mTimeout;
+  std::optional<InFlight> mInFlight;
+};
@@ -0,0 +1,49 @@
+#include "PartitionFlash.hpp"
+
+#include "esp_log.h"
+
+namespace {
+const auto kTag = "partition_flash";
+} // namespace
+
+PartitionFlash::PartitionFlash(const char* label)
+    : mPartition{esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                          ESP_PARTITION_SUBTYPE_ANY, label)} {
+  if (!mPartition) {
+    ESP_LOGW(kTag, "No data partition %s", label);
+  }
+}
+
+size_t PartitionFlash::sectorCount() const {
+  return mPartition ? mPartition->size / SPI_FLASH_SEC_SIZE : 0;
+}
+
+bool PartitionFlash::read(size_t offset, std::span<uint8_t> bytes) {
+  const auto err =
+      esp_partition_read(mPartition, offset, bytes.data(), bytes.size());
+  if (err != ESP_OK) {
+    ESP_LOGE(kTag, "Failed to read at 0x%zx. Error %d", offset, err);
+    return false;
+  }
+  return true;
+}
+
+bool PartitionFlash::write(size_t offset, std::span<const uint8_t> bytes) {
+  const auto err =
+      esp_partition_write(mPartition, offset, bytes.data(), bytes.size());
+  if (err != ESP_OK) {
+    ESP_LOGE(kTag, "Failed to write at 0x%zx. Error %d", offset, err);
+    return false;
+  }
+  return true;
+}
+
+bool PartitionFlash::erase(size_t sector) {
+  const auto err = esp_partition_erase_range(
+      mPartition, sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE);
+  if (err != ESP_OK) {
+    ESP_LOGE(kTag, "Failed to erase sector %zu. Error %d", sector, err);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "esp_partition.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/*! A data partition as flash for FlashLog. Sectors are the 4 KiB erase
+ *  blocks of the partition.
+ */
+class PartitionFlash {
+public:
+  /* Opens the data partition with the given label. valid() is false if
+   * there is no such partition.
+   */
+  explicit PartitionFlash(const char* label);
+
+  bool valid() const { return mPartition != nullptr; }
+
+  size_t sectorSize() const { return SPI_FLASH_SEC_SIZE; }
+  size_t sectorCount() const;
+
+  bool read(size_t offset, std::span<uint8_t> bytes);
+  bool write(size_t offset, std::span<const uint8_t> bytes);
+  bool erase(size_t sector);
+
+private:
+  const esp_partition_t* mPartition;
+};
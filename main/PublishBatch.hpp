@@ -0,0 +1,120 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/* When to publish a batch of reporting windows: once it holds maxWindows
+ * windows, before it would exceed maxBytes or before its oldest window would
+ * wait longer than maxLatency. maxWindows of 1 publishes every window on its
+ * own.
+ */
+struct PublishBatchPolicy {
+  size_t maxWindows;
+  size_t maxBytes;
+  std::chrono::seconds maxLatency;
+};
+
+/*! Collects the payloads of several reporting windows into one message, so
+ *  the per message overhead of MQTT, TLS records and radio wake ups is paid
+ *  once per batch.
+ *
+ *  Payloads are joined with separator and enclosed in prefix and suffix,
+ *  e.g. "[", "," and "]" for a JSON array. Binary payloads that carry their
+ *  own size are simply concatenated. Windows are only added at window
+ *  boundaries, so the latency bound is checked against the next boundary.
+ *
+ *  Clock is a template parameter so batching can be driven by a recorded
+ *  clock on the host.
+ */
+template <typename Clock> class PublishBatch {
+public:
+  using TimePoint = typename Clock::time_point;
+
+  PublishBatch(PublishBatchPolicy policy, std::string_view prefix,
+               std::string_view separator, std::string_view suffix)
+      : mPolicy{policy}, mPrefix{prefix}, mSeparator{separator},
+        mSuffix{suffix} {
+    // Allocated once, a single window larger than maxBytes still grows it
+    mBytes.reserve(policy.maxBytes);
+  }
+
+  /* True if a payload of the given size can be added without exceeding
+   * maxBytes. A payload always fits into an empty batch.
+   */
+  bool fits(size_t payloadSize) const {
+    return mWindowCount == 0 || mBytes.size() + mSeparator.size() +
+                                        payloadSize + mSuffix.size() <=
+                                    mPolicy.maxBytes;
+  }
+
+  /* Adds the payload of a window that ended at time now. Returns false if it
+   * doesn't fit, the batch has to be published first then.
+   */
+  bool add(std::string_view payload, TimePoint now) {
+    if (!fits(payload.size())) {
+      return false;
+    }
+
+    if (mWindowCount == 0) {
+      mBytes.assign(mPrefix.begin(), mPrefix.end());
+      mOldest = now;
+    } else {
+      mBytes.insert(mBytes.end(), mSeparator.begin(), mSeparator.end());
+    }
+
+    mBytes.insert(mBytes.end(), payload.begin(), payload.end());
+    mWindowCount++;
+    return true;
+  }
+
+  bool add(std::span<const uint8_t> payload, TimePoint now) {
+    return add(std::string_view{reinterpret_cast<const char*>(payload.data()),
+                                payload.size()},
+               now);
+  }
+
+  /* True if the batch has to be published now because it is full or its
+   * oldest window would wait too long for the boundary of the next window.
+   */
+  bool due(TimePoint nextBoundary) const {
+    return mWindowCount > 0 &&
+           (mWindowCount >= mPolicy.maxWindows ||
+            nextBoundary - mOldest > mPolicy.maxLatency);
+  }
+
+  size_t windowCount() const { return mWindowCount; }
+
+  /* The message of all windows added so far, empty if there are none. No
+   * windows can be added until the batch is cleared.
+   */
+  std::string_view finish() {
+    if (mWindowCount == 0) {
+      return {};
+    }
+    if (!mFinished) {
+      mBytes.insert(mBytes.end(), mSuffix.begin(), mSuffix.end());
+      mFinished = true;
+    }
+    return {mBytes.data(), mBytes.size()};
+  }
+
+  void clear() {
+    mBytes.clear();
+    mWindowCount = 0;
+    mFinished = false;
+  }
+
+private:
+  PublishBatchPolicy mPolicy;
+  std::string_view mPrefix;
+  std::string_view mSeparator;
+  std::string_view mSuffix;
+  std::vector<char> mBytes;
+  size_t mWindowCount{0};
+  bool mFinished{false};
+  TimePoint mOldest{};
+};
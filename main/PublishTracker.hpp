@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+/*! Matches publishes with QoS 1 or 2 to their acknowledgement by the broker
+ *  to measure the time in between. Publishes with QoS 0 are never
+ *  acknowledged, their latency isn't measured.
+ *
+ *  The acknowledgement is reported by the MQTT task and can arrive before
+ *  the publishing task got to record its publish, so whichever of both
+ *  comes second completes the match. Up to kCapacity publishes are tracked,
+ *  the oldest one is dropped when another arrives, e.g. because its
+ *  acknowledgement was lost with the connection.
+ *
+ *  Times are in microseconds and wrap around. Not thread safe.
+ */
+class PublishTracker {
+public:
+  static constexpr size_t kCapacity = 16;
+
+  /* Records that the message with the given id and QoS was handed to the
+   * client at time. Returns the latency if it was already acknowledged.
+   * Messages with QoS 0 aren't tracked and never have a latency.
+   */
+  std::optional<uint32_t> published(int messageId, int qos, uint32_t time) {
+    if (qos == 0) {
+      return std::nullopt;
+    }
+    return match(messageId, time, false);
+  }
+
+  /* Records that the message with the given id was acknowledged at time.
+   * Returns the latency if it was already published.
+   */
+  std::optional<uint32_t> acknowledged(int messageId, uint32_t time) {
+    return match(messageId, time, true);
+  }
+
+  // Number of publishes and acknowledgements dropped before their match
+  uint32_t dropped() const { return mDropped; }
+
+private:
+  struct Entry {
+    int messageId;
+    uint32_t time;
+    // Order of insertion, the smallest one is dropped first
+    uint32_t sequence;
+    bool acknowledged;
+    bool used;
+  };
+
+  std::optional<uint32_t> match(int messageId, uint32_t time,
+                                bool acknowledged) {
+    // A free entry or else the oldest one
+    auto* target = &mEntries.front();
+    for (auto& entry : mEntries) {
+      if (!entry.used) {
+        target = &entry;
+        continue;
+      }
+      if (entry.messageId == messageId && entry.acknowledged != acknowledged) {
+        entry.used = false;
+        return acknowledged ? time - entry.time : entry.time - time;
+      }
+      if (target->used &&
+          static_cast<int32_t>(entry.sequence - target->sequence) < 0) {
+        target = &entry;
+      }
+    }
+
+    mDropped += target->used;
+    *target = {messageId, time, mSequence++, acknowledged, true};
+    return std::nullopt;
+  }
+
+  std::array<Entry, kCapacity> mEntries{};
+  uint32_t mSequence{0};
+  uint32_t mDropped{0};
+};
@@ -0,0 +1,107 @@
+#include "QueryServer.hpp"
+
+#include "esp_log.h"
+
+#include <array>
+
+namespace {
+const auto kTag = "query_server";
+} // namespace
+
+bool QueryLimiter::allow(uint32_t address, Clock::time_point now) {
+  // The sender if it's known or else a free entry or the oldest one
+  auto* target = &mSenders.front();
+  for (auto& sender : mSenders) {
+    if (sender.used && sender.address == address) {
+      target = &sender;
+      break;
+    }
+    if (!sender.used || (target->used && sender.replied < target->replied)) {
+      target = &sender;
+    }
+  }
+  if (target->used && target->address == address &&
+      now - target->replied < mSenderInterval) {
+    return false;
+  }
+
+  if (now - mSecond >= std::chrono::seconds{1}) {
+    mSecond = now;
+    mReplies = 0;
+  }
+  if (mReplies == mMaxReplies) {
+    return false;
+  }
+
+  mReplies++;
+  *target = {address, now, true};
+  return true;
+}
+
+QueryServer::~QueryServer() {
+  if (mSocket) {
+    close(*mSocket);
+  }
+}
+
+bool QueryServer::bind(uint16_t port) {
+  const auto sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_IP);
+  if (sock < 0) {
+    ESP_LOGE(kTag, "Failed to create socket. Error %d", errno);
+    return false;
+  }
+
+  sockaddr_in address{};
+  address.sin_family = PF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (::bind(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ==
+      -1) {
+    ESP_LOGE(kTag, "Failed to bind socket. Error %d", errno);
+    close(sock);
+    return false;
+  }
+
+  mSocket = sock;
+  return true;
+}
+
+bool QueryServer::receive() {
+  if (!mSocket) {
+    return false;
+  }
+
+  // One byte more than a request so longer datagrams don't match
+  std::array<char, kMaxRequestSize + 1> buffer;
+  while (true) {
+    socklen_t senderSize = sizeof(mSender);
+    const auto size =
+        recvfrom(*mSocket, buffer.data(), buffer.size(), 0,
+                 reinterpret_cast<sockaddr*>(&mSender), &senderSize);
+    if (size < 0) {
+      ESP_LOGE(kTag, "recvfrom failed: errno %d", errno);
+      return false;
+    }
+
+    if (std::string_view{buffer.data(), static_cast<size_t>(size)} ==
+            mRequest &&
+        mLimiter.allow(mSender.sin_addr.s_addr, QueryLimiter::Clock::now())) {
+      return true;
+    }
+    mIgnored++;
+  }
+}
+
+bool QueryServer::reply(std::string_view payload) {
+  if (!mSocket) {
+    return false;
+  }
+
+  if (sendto(*mSocket, payload.data(), payload.size(), 0,
+             reinterpret_cast<const sockaddr*>(&mSender), sizeof(mSender)) <
+      0) {
+    ESP_LOGW(kTag, "sendto failed: errno %d", errno);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "lwip/sockets.h"
+
+/*! Limits the replies of QueryServer. A reply is a hundred times as large as
+ *  a query and UDP senders can be spoofed, so without a limit the server
+ *  would amplify floods towards others.
+ *
+ *  Each sender gets at most one reply per senderInterval, the last
+ *  kSenderCapacity senders are remembered. All senders together get at most
+ *  maxReplies replies per second. Not thread safe.
+ */
+class QueryLimiter {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t kSenderCapacity = 8;
+
+  QueryLimiter(Clock::duration senderInterval, uint32_t maxReplies)
+      : mSenderInterval{senderInterval}, mMaxReplies{maxReplies} {}
+
+  // True if the sender with the given IPv4 address may get a reply at now
+  bool allow(uint32_t address, Clock::time_point now);
+
+private:
+  struct Sender {
+    uint32_t address;
+    Clock::time_point replied;
+    bool used;
+  };
+
+  Clock::duration mSenderInterval;
+  uint32_t mMaxReplies;
+  std::array<Sender, kSenderCapacity> mSenders{};
+  // Start of the current second and the replies in it
+  Clock::time_point mSecond{};
+  uint32_t mReplies{0};
+};
+
+/*! Answers queries on a UDP port, e.g. from a display in the local network
+ *  that wants the latest sensor values without a round trip through the
+ *  MQTT broker. Only datagrams whose content is exactly request are queries
+ *  and their senders are limited by limiter, other datagrams are ignored.
+ *  The reply goes back to the sender of the query.
+ */
+class QueryServer {
+public:
+  // Longer datagrams are never queries
+  static constexpr size_t kMaxRequestSize = 63;
+
+  QueryServer(std::string_view request, QueryLimiter limiter)
+      : mRequest{request}, mLimiter{limiter} {}
+  ~QueryServer();
+
+  bool bind(uint16_t port);
+
+  // Waits for the next query, returns false on error
+  bool receive();
+
+  // Sends the reply to the sender of the last query
+  bool reply(std::string_view payload);
+
+  // Datagrams that weren't queries or whose sender was limited
+  uint32_t ignored() const { return mIgnored; }
+
+private:
+  std::string_view mRequest;
+  QueryLimiter mLimiter;
+  std::optional<int> mSocket;
+  sockaddr_in mSender{};
+  uint32_t mIgnored{0};
+};
@@ -0,0 +1,94 @@
+#include "SensorAggregator.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+std::optional<SampleTimes> sampleTimes(std::span<const SensorValue> values) {
+  if (values.empty()) {
+    return std::nullopt;
+  }
+
+  // Compared by their signed difference, which survives wrapping around
+  SampleTimes times{values.front().firstTimestamp,
+                    values.front().lastTimestamp};
+  for (const auto& value : values) {
+    if (static_cast<int32_t>(value.firstTimestamp - times.first) < 0) {
+      times.first = value.firstTimestamp;
+    }
+    if (static_cast<int32_t>(value.lastTimestamp - times.last) > 0) {
+      times.last = value.lastTimestamp;
+    }
+  }
+  return times;
+}
+
+void SensorAggregator::updateValue(spymarine::SensorId id, int32_t raw,
+                                   uint32_t timestamp) {
+  auto& slot = mSlots[id];
+
+  if (slot.count == 0) {
+    slot.first = raw;
+    slot.min = raw;
+    slot.max = raw;
+    slot.firstTimestamp = timestamp;
+  } else {
+    slot.min = std::min(slot.min, raw);
+    slot.max = std::max(slot.max, raw);
+  }
+
+  slot.count++;
+  const auto delta = int64_t{raw} - slot.first;
+  const auto magnitude = static_cast<uint64_t>(delta < 0 ? -delta : delta);
+  // Below 2^32, so a single square always fits
+  const auto square = magnitude * magnitude;
+  slot.sum += delta;
+  slot.overflow |=
+      slot.sumOfSquares > std::numeric_limits<uint64_t>::max() - square;
+  slot.sumOfSquares += square;
+  slot.last = raw;
+  slot.lastTimestamp = timestamp;
+
+  mActiveSlots[id / kWordBits] |= uint32_t{1} << (id % kWordBits);
+}
+
+std::span<SensorValue> SensorAggregator::finishWindow(
+    const spymarine::SensorDefinition& sensorDefinition) {
+  size_t count = 0;
+
+  for (size_t word = 0; word < mActiveSlots.size(); word++) {
+    for (auto bits = mActiveSlots[word]; bits != 0; bits &= bits - 1) {
+      const auto id = word * kWordBits + std::countr_zero(bits);
+      auto& slot = mSlots[id];
+      const auto scale =
+          sensorDefinition.conversion(static_cast<spymarine::SensorId>(id))
+              .scale();
+
+      // Once per window, the only floating point arithmetic
+      auto variance = std::numeric_limits<double>::quiet_NaN();
+      if (!slot.overflow) {
+        const auto n = static_cast<double>(slot.count);
+        const auto mean = static_cast<double>(slot.sum) / n;
+        variance = std::max(
+            0.0, static_cast<double>(slot.sumOfSquares) / n - mean * mean);
+        variance /= static_cast<double>(scale) * scale;
+      }
+
+      mValues[count++] = {static_cast<spymarine::SensorId>(id),
+                          slot.count,
+                          scale,
+                          int64_t{slot.first} * slot.count + slot.sum,
+                          slot.min,
+                          slot.max,
+                          slot.last,
+                          variance,
+                          slot.firstTimestamp,
+                          slot.lastTimestamp};
+      slot = {};
+    }
+    mActiveSlots[word] = 0;
+  }
+
+  return std::span{mValues.data(), count};
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "spymarine/Sensor.hpp"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+/* A single decoded sensor value as passed from the receiving to the
+ * aggregating task. The value is in raw units of the sensor, see
+ * SensorConversion::scale. The timestamp is in milliseconds of the steady
+ * clock and wraps around.
+ *
+ * The frames of a receive batch share their timestamp, frame tells them
+ * apart: it counts the decoded frames and wraps around. Derived samples
+ * carry the frame of their input.
+ */
+struct SensorSample {
+  int32_t raw;
+  uint32_t timestamp;
+  spymarine::SensorId id;
+  uint16_t frame;
+};
+// frame fits into the padding, the ring doesn't grow
+static_assert(sizeof(SensorSample) == 12);
+
+/* The value of a sensor as reported over MQTT. Besides the mean, the
+ * statistics of all samples in the reporting window are available.
+ *
+ * Values are kept in raw units of the sensor as long as possible, the
+ * value in units is raw / scale and the mean is sum / (count * scale). They
+ * are only converted to decimal when they are serialized, rounded exactly
+ * instead of carrying the rounding errors of double arithmetic.
+ */
+struct SensorValue {
+  spymarine::SensorId id;
+  uint32_t count;
+  uint32_t scale;
+  int64_t sum;
+  int32_t min;
+  int32_t max;
+  int32_t last;
+  // In units squared, NaN if the samples were too far apart to sum up
+  double variance;
+  // Receive times of the first and last sample, like SensorSample
+  uint32_t firstTimestamp;
+  uint32_t lastTimestamp;
+
+  // The mean in units, for comparisons that don't need to be exact
+  double mean() const {
+    return static_cast<double>(sum) / (static_cast<double>(count) * scale);
+  }
+};
+
+// Receive times of the oldest and newest sample of a window
+struct SampleTimes {
+  uint32_t first;
+  uint32_t last;
+};
+
+/* Returns the receive times of the oldest and newest sample of the values or
+ * std::nullopt if there are none. Handles timestamps that wrapped around
+ * within the window.
+ */
+std::optional<SampleTimes> sampleTimes(std::span<const SensorValue> values);
+
+/*! Aggregates sensor values over a reporting window.
+ *
+ *  Calculates sum, min, max, last value and variance in a single pass with
+ *  constant memory per sensor, using integer arithmetic only. The variance
+ *  is calculated from the sums of the samples and their squares, shifted by
+ *  the first sample of the window so the squares stay small. Uses a fixed
+ *  slot per sensor id so nothing is allocated after construction. The
+ *  instance is large (several KiB) and should not be placed on a task stack.
+ */
+class SensorAggregator {
+public:
+  void updateValue(spymarine::SensorId id, int32_t raw, uint32_t timestamp);
+
+  /* Returns the statistics of every sensor that received values since the
+   * last call and starts a new window. The scale of each value is taken
+   * from sensorDefinition. The values are in sensor id order and stay valid
+   * until the next call. They may be modified by the caller.
+   */
+  std::span<SensorValue>
+  finishWindow(const spymarine::SensorDefinition& sensorDefinition);
+
+private:
+  struct Slot {
+    uint32_t count;
+    int32_t first;
+    int32_t min;
+    int32_t max;
+    int32_t last;
+    uint32_t firstTimestamp;
+    uint32_t lastTimestamp;
+    bool overflow;
+    // Of the differences to first
+    int64_t sum;
+    uint64_t sumOfSquares;
+  };
+
+  static constexpr size_t kSlotCount = 256;
+  static constexpr size_t kWordBits = 32;
+
+  std::array<Slot, kSlotCount> mSlots{};
+  std::array<uint32_t, kSlotCount / kWordBits> mActiveSlots{};
+  std::array<SensorValue, kSlotCount> mValues{};
+};
@@ -0,0 +1,89 @@
+#include "SensorDefinitionCache.hpp"
+
+#include "spymarine/Devices.hpp"
+
+#include "esp_log.h"
+#include "nvs.h"
+
+#include <array>
+
+namespace {
+
+const auto kTag = "sensor_cache";
+
+constexpr auto kNamespace = "spymarine";
+constexpr auto kKey = "sensors";
+
+/* Layout of the blob:
+ *
+ *   uint8  spymarine::kDeviceLayoutsVersion
+ *   uint32 topology hash, little endian
+ *   uint8  sensor type of each of the 256 sensor ids, kUndefined if the
+ *          sensor isn't defined
+ */
+constexpr size_t kBlobSize = 1 + 4 + 256;
+constexpr uint8_t kUndefined = 0xff;
+
+using Blob = std::array<uint8_t, kBlobSize>;
+
+} // namespace
+
+std::unique_ptr<CachedSensorDefinition> loadSensorDefinition() {
+  nvs_handle_t handle;
+  if (nvs_open(kNamespace, NVS_READONLY, &handle) != ESP_OK) {
+    return nullptr;
+  }
+
+  Blob blob;
+  size_t size = blob.size();
+  const auto err = nvs_get_blob(handle, kKey, blob.data(), &size);
+  nvs_close(handle);
+
+  if (err != ESP_OK || size != blob.size() ||
+      blob[0] != spymarine::kDeviceLayoutsVersion) {
+    return nullptr;
+  }
+
+  auto cached = std::make_unique<CachedSensorDefinition>();
+  cached->topologyHash = blob[1] | (blob[2] << 8) | (blob[3] << 16) |
+                         (uint32_t(blob[4]) << 24);
+  for (size_t id = 0; id < 256; id++) {
+    if (const auto type = spymarine::toSensorType(blob[5 + id])) {
+      cached->sensorDefinition.add(static_cast<spymarine::SensorId>(id),
+                                   *type);
+    }
+  }
+
+  return cached;
+}
+
+bool storeSensorDefinition(
+    uint32_t topologyHash,
+    const spymarine::SensorDefinition& sensorDefinition) {
+  Blob blob;
+  blob.fill(kUndefined);
+  blob[0] = spymarine::kDeviceLayoutsVersion;
+  for (size_t i = 0; i < 4; i++) {
+    blob[1 + i] = static_cast<uint8_t>(topologyHash >> (8 * i));
+  }
+  sensorDefinition.forEach(
+      [&](spymarine::SensorId id, spymarine::SensorType type) {
+        blob[5 + id] = static_cast<uint8_t>(type);
+      });
+
+  nvs_handle_t handle;
+  auto err = nvs_open(kNamespace, NVS_READWRITE, &handle);
+  if (err == ESP_OK) {
+    err = nvs_set_blob(handle, kKey, blob.data(), blob.size());
+    if (err == ESP_OK) {
+      err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+  }
+
+  if (err != ESP_OK) {
+    ESP_LOGE(kTag, "Failed to store the sensor definition. Error %d", err);
+    return false;
+  }
+  return true;
+}
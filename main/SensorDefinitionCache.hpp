@@ -0,0 +1,25 @@
+#pragma once
+
+#include "spymarine/Sensor.hpp"
+
+#include <cstdint>
+#include <memory>
+
+/* A discovered sensor definition and the topology hash of the devices it was
+ * built from, see spymarine::SensorDiscovery
+ */
+struct CachedSensorDefinition {
+  uint32_t topologyHash;
+  spymarine::SensorDefinition sensorDefinition;
+};
+
+/* Loads the sensor definition stored in NVS. Allocated as it's too large for
+ * a task stack. Returns nullptr if none was stored or it was stored with
+ * other device layouts.
+ */
+std::unique_ptr<CachedSensorDefinition> loadSensorDefinition();
+
+/* Stores the sensor definition in NVS. Returns false on failure.
+ */
+bool storeSensorDefinition(uint32_t topologyHash,
+                           const spymarine::SensorDefinition& sensorDefinition);
@@ -0,0 +1,437 @@
+#pragma once
+
+#include "DeadbandFilter.hpp"
+#include "DerivedSensors.hpp"
+#include "FrameDeduplicator.hpp"
+#include "JsonWriter.hpp"
+#include "Metrics.hpp"
+#include "PublishBatch.hpp"
+#include "SensorAggregator.hpp"
+#include "SensorTopics.hpp"
+#include "SensorValuesBinary.hpp"
+#include "SensorValuesJson.hpp"
+#include "spymarine/Sensor.hpp"
+#include "spymarine/SensorStateDecoder.hpp"
+
+#include "esp_cpu.h"
+#include "esp_log.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+
+/* The steps from a received frame to a published window, shared by the tasks
+ * of AppMain and simarine_replay so a replay runs exactly the code of the
+ * device:
+ *
+ *   SensorReceiver   skips repeated frames and decodes sensor state frames
+ *   SensorWindows    aggregates samples and derived sensors into windows
+ *   WindowPublisher  filters, serializes and publishes or batches windows
+ *
+ * None of them depend on ESP-IDF beyond logging and the cycle counter.
+ */
+
+/*! Skips repeated frames, decodes sensor state frames and passes on the
+ *  samples of the sensors in sensorDefinition. Doesn't allocate.
+ */
+class SensorReceiver {
+public:
+  using Clock = FrameDeduplicator::Clock;
+
+  SensorReceiver(const spymarine::SensorDefinition& sensorDefinition,
+                 Clock::duration deduplicationWindow)
+      : mSensorDefinition{sensorDefinition},
+        mDeduplicator{deduplicationWindow} {}
+
+  /* Passes the samples of frame, received at now and timestamp in
+   * milliseconds like SensorSample::timestamp, to function, which returns
+   * false if it dropped the sample. Adds the frame to counts.
+   */
+  template <typename SampleFunction>
+  void receive(std::span<const uint8_t> frame, Clock::time_point now,
+               uint32_t timestamp, ReceiveBatchCounts& counts,
+               SampleFunction function) {
+    counts.datagrams++;
+    if (mDeduplicator.isDuplicate(frame, now)) {
+      counts.duplicates++;
+      return;
+    }
+
+    const auto crcMismatches = mParseCounters.crcMismatch;
+    const auto decoded = spymarine::decodeSensorState(
+        frame, mSensorDefinition, mReadings, mParseCounters);
+    counts.crcMismatches += mParseCounters.crcMismatch - crcMismatches;
+    if (!decoded) {
+      counts.rejectedFrames++;
+      return;
+    }
+
+    mDeduplicator.accept(frame, now);
+    mFrame++;
+    for (const auto& reading : *decoded) {
+      if (!function(
+              SensorSample{reading.raw, timestamp, reading.id, mFrame})) {
+        counts.droppedSamples++;
+      }
+    }
+    counts.samples += decoded->size();
+  }
+
+  // Accepted and duplicate frames since construction
+  const FrameDeduplicator::Counters& frameCounters() const {
+    return mDeduplicator.counters();
+  }
+
+  // Reasons for rejected frames since construction
+  const spymarine::ParseCounters& parseCounters() const {
+    return mParseCounters;
+  }
+
+private:
+  const spymarine::SensorDefinition& mSensorDefinition;
+  FrameDeduplicator mDeduplicator;
+  spymarine::ParseCounters mParseCounters;
+  std::array<spymarine::SensorReading, 256> mReadings;
+  // SensorSample::frame of the last decoded frame
+  uint16_t mFrame{0};
+};
+
+/*! Aggregates the samples of the devices and of the derived sensors into
+ *  reporting windows.
+ *
+ *  Owns the definition of the reported sensors, the sensors of the devices
+ *  extended by the derived sensors. Frames have to be decoded with the
+ *  definition of the devices only, see SensorReceiver.
+ */
+class SensorWindows {
+public:
+  SensorWindows(const spymarine::SensorDefinition& deviceDefinition,
+                std::span<const DerivedSensor> derivedSensors)
+      : mSensorDefinition{deviceDefinition},
+        mDerivedSensors{derivedSensors, mSensorDefinition},
+        mAggregator{std::make_unique<SensorAggregator>()} {}
+
+  // The sensors of the devices and the derived sensors
+  const spymarine::SensorDefinition& sensorDefinition() const {
+    return mSensorDefinition;
+  }
+
+  const DerivedSensors& derivedSensors() const { return mDerivedSensors; }
+
+  /* Adds a sample of a device to the window and updates the derived
+   * sensors. Calls function with the sample and each derived sample.
+   */
+  template <typename Function>
+  void add(const SensorSample& sample, Function function) {
+    const auto aggregate = [&](const SensorSample& added) {
+      mAggregator->updateValue(added.id, added.raw, added.timestamp);
+      function(added);
+    };
+    aggregate(sample);
+    mDerivedSensors.update(sample, aggregate);
+  }
+
+  void add(const SensorSample& sample) {
+    add(sample, [](const SensorSample&) {});
+  }
+
+  // Ends the window, see SensorAggregator::finishWindow
+  std::span<SensorValue> finishWindow() {
+    return mAggregator->finishWindow(mSensorDefinition);
+  }
+
+private:
+  spymarine::SensorDefinition mSensorDefinition;
+  DerivedSensors mDerivedSensors;
+  std::unique_ptr<SensorAggregator> mAggregator;
+};
+
+// What and how WindowPublisher publishes, see Config.hpp
+struct PublishSettings {
+  bool json;
+  bool binary;
+  bool perSensor;
+  bool retainPerSensor;
+  bool statistics;
+  int qos;
+  PublishBatchPolicy batch;
+  // kSensorUpdateInterval, a batch is published before its oldest window
+  // would wait longer than batch.maxLatency for the next window
+  std::chrono::milliseconds interval;
+};
+
+// The end of a window in the clocks of the pipeline
+struct WindowTime {
+  // Of the deadband filter and the batches
+  std::chrono::steady_clock::time_point now;
+  // Like SensorSample::timestamp, for the age of the samples
+  uint32_t milliseconds;
+  // Carried in binary payloads and JSON batches, seconds since the Unix
+  // epoch on the device
+  uint32_t timestamp;
+};
+
+/*! Drops the values of a window that stayed within their deadband and
+ *  publishes the rest with Client, which has the publish and connected
+ *  functions of MqttClient: to /sensors/all as JSON, to /sensors/binary, per
+ *  sensor or collected into batches, as set in PublishSettings.
+ *
+ *  Windows that can't be published are handed to a store function in the
+ *  binary format, e.g. to keep them in the outbox. Records the serializing
+ *  cost and the sample ages of published windows in metrics.
+ */
+template <typename Client> class WindowPublisher {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Fits about 30 sensors including statistics
+  static constexpr size_t kJsonBufferSize = 4096;
+
+  WindowPublisher(Client& client,
+                  const spymarine::SensorDefinition& sensorDefinition,
+                  const DeadbandDefinition& deadbands,
+                  Clock::duration maxSilence, PublishSettings settings,
+                  PipelineMetrics& metrics)
+      : mClient{client}, mSensorDefinition{sensorDefinition},
+        mSettings{settings}, mMetrics{metrics},
+        mDeadbandFilter{std::make_unique<DeadbandFilter>(deadbands,
+                                                         maxSilence)},
+        mTopics{settings.perSensor
+                    ? std::make_unique<SensorTopics>(sensorDefinition)
+                    : nullptr},
+        mBatches{settings.batch.maxWindows > 1
+                     ? std::make_unique<Batches>(settings.batch)
+                     : nullptr} {}
+
+  /* Publishes or batches the values of the window that ended at time and
+   * returns the values that were reported, the others are dropped by the
+   * deadband filter. Calls store with the binary payload of every window
+   * that couldn't be published.
+   */
+  template <typename StoreFunction>
+  std::span<const SensorValue> publishWindow(std::span<SensorValue> values,
+                                             const WindowTime& time,
+                                             StoreFunction store) {
+    const auto changedValues = mDeadbandFilter->filter(values, time.now);
+
+    if (mBatches) {
+      if (mSettings.perSensor && mClient.connected()) {
+        publishPerSensor(changedValues);
+      }
+      if (!changedValues.empty()) {
+        batchWindow(changedValues, time, store);
+      }
+      finishBatch(time, false, store);
+      return changedValues;
+    }
+
+    if (changedValues.empty()) {
+      return changedValues;
+    }
+
+    auto published = mClient.connected();
+    if (published && mSettings.json) {
+      published = publishJson(changedValues);
+    }
+    if (published && mSettings.binary) {
+      const auto payload = encodeBinary(changedValues, time.timestamp);
+      published = !payload ||
+                  mClient.publish("/sensors/binary", *payload, mSettings.qos);
+    }
+    if (published && mSettings.perSensor) {
+      published = publishPerSensor(changedValues);
+    }
+
+    if (published) {
+      recordSampleAges(*sampleTimes(changedValues), time);
+    } else if (const auto payload =
+                   encodeBinary(changedValues, time.timestamp)) {
+      store(*payload);
+    }
+    return changedValues;
+  }
+
+  /* Publishes the batch if it has to be published before the next window
+   * or, with force, if it isn't empty. Calls store with the binary payloads
+   * of its windows if it can't be published.
+   */
+  template <typename StoreFunction>
+  void finishBatch(const WindowTime& time, bool force, StoreFunction store) {
+    if (!mBatches ||
+        !(force ? mBatches->binary.windowCount() > 0
+                : mBatches->binary.due(time.now + mSettings.interval))) {
+      return;
+    }
+    publishBatches(time, store);
+  }
+
+  // Values reported and dropped by the deadband filter since construction
+  const DeadbandFilter::Counters& deadbandCounters() const {
+    return mDeadbandFilter->counters();
+  }
+
+private:
+  static constexpr const char* kTag = "window_publisher";
+
+  // Windows collected for a batched publish
+  struct Batches {
+    explicit Batches(PublishBatchPolicy policy)
+        : json{policy, "[", ",", "]"}, binary{policy, "", "", ""} {}
+
+    PublishBatch<Clock> json;
+
+    // Also collected without binary publishing, the windows are stored in
+    // the binary format if the batch can't be published
+    PublishBatch<Clock> binary;
+
+    // Receive times of the oldest and newest sample in the batches
+    std::optional<SampleTimes> sampleTimes;
+  };
+
+  // Records how long the samples waited until they were handed to the client
+  void recordSampleAges(SampleTimes times, const WindowTime& time) {
+    mMetrics.oldestSampleMilliseconds.record(time.milliseconds - times.first);
+    mMetrics.newestSampleMilliseconds.record(time.milliseconds - times.last);
+  }
+
+  // Returns false if the values couldn't be published
+  bool publishJson(std::span<const SensorValue> values) {
+    const auto start = esp_cpu_get_cycle_count();
+    JsonWriter writer{mJsonBuffer};
+    writeSensorValuesJson(writer, values, mSettings.statistics);
+    mMetrics.serializeCycles.record(esp_cpu_get_cycle_count() - start);
+
+    if (writer.overflow()) {
+      // Retrying won't help, don't keep the values for later
+      ESP_LOGE(kTag, "JSON buffer too small for %zu sensors", values.size());
+      return true;
+    }
+    return mClient.publish("/sensors/all", writer.string(), mSettings.qos);
+  }
+
+  /* Publishes every value to the topic of its sensor. Returns false if a
+   * value couldn't be published.
+   */
+  bool publishPerSensor(std::span<const SensorValue> values) {
+    for (const auto& value : values) {
+      const auto topic = mTopics->topic(value.id);
+      if (!topic) {
+        continue;
+      }
+
+      std::array<char, 256> buffer;
+      JsonWriter writer{buffer};
+      writeSensorValueJson(writer, value, mSettings.statistics);
+      if (!mClient.publish(topic, writer.string(), 0,
+                           mSettings.retainPerSensor)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::optional<std::span<const uint8_t>>
+  encodeBinary(std::span<const SensorValue> values, uint32_t timestamp) {
+    const auto payload = writeSensorValuesBinary(mBinaryBuffer, values,
+                                                 mSensorDefinition, timestamp);
+    if (!payload) {
+      ESP_LOGE(kTag, "Couldn't encode %zu sensors", values.size());
+    }
+    return payload;
+  }
+
+  /* Adds the values of a window to the batches. Publishes the batches first
+   * if the window doesn't fit anymore.
+   */
+  template <typename StoreFunction>
+  void batchWindow(std::span<const SensorValue> values,
+                   const WindowTime& time, StoreFunction store) {
+    const auto binary = encodeBinary(values, time.timestamp);
+    if (!binary) {
+      return;
+    }
+
+    JsonWriter writer{mJsonBuffer};
+    if (mSettings.json) {
+      const auto start = esp_cpu_get_cycle_count();
+      writeSensorWindowJson(writer, values, time.timestamp,
+                            mSettings.statistics);
+      mMetrics.serializeCycles.record(esp_cpu_get_cycle_count() - start);
+      if (writer.overflow()) {
+        ESP_LOGE(kTag, "JSON buffer too small for %zu sensors",
+                 values.size());
+        return;
+      }
+    }
+    const auto json = writer.string();
+
+    if (!mBatches->json.fits(json.size()) ||
+        !mBatches->binary.fits(binary->size())) {
+      publishBatches(time, store);
+    }
+    if (mSettings.json) {
+      mBatches->json.add(json, time.now);
+    }
+    mBatches->binary.add(*binary, time.now);
+
+    // Windows are added in order, so the oldest sample is in the first one
+    if (const auto times = sampleTimes(values)) {
+      if (mBatches->sampleTimes) {
+        mBatches->sampleTimes->last = times->last;
+      } else {
+        mBatches->sampleTimes = times;
+      }
+    }
+  }
+
+  /* Publishes the batches, or stores their windows if they can't be
+   * published, and clears them
+   */
+  template <typename StoreFunction>
+  void publishBatches(const WindowTime& time, StoreFunction store) {
+    auto& batches = *mBatches;
+
+    auto published = mClient.connected();
+    if (published && mSettings.json) {
+      published = mClient.publish("/sensors/batch", batches.json.finish(),
+                                  mSettings.qos);
+    }
+    if (published && mSettings.binary) {
+      published = mClient.publish("/sensors/binary", batches.binary.finish(),
+                                  mSettings.qos);
+    }
+
+    if (published) {
+      ESP_LOGD(kTag, "Published a batch of %zu windows",
+               batches.binary.windowCount());
+      if (batches.sampleTimes) {
+        recordSampleAges(*batches.sampleTimes, time);
+      }
+    } else {
+      const auto payloads = batches.binary.finish();
+      splitSensorValuesBinary(
+          std::span{reinterpret_cast<const uint8_t*>(payloads.data()),
+                    payloads.size()},
+          store);
+    }
+
+    batches.json.clear();
+    batches.binary.clear();
+    batches.sampleTimes.reset();
+  }
+
+  Client& mClient;
+  const spymarine::SensorDefinition& mSensorDefinition;
+  PublishSettings mSettings;
+  PipelineMetrics& mMetrics;
+  std::unique_ptr<DeadbandFilter> mDeadbandFilter;
+  std::unique_ptr<SensorTopics> mTopics;
+  std::unique_ptr<Batches> mBatches;
+  std::array<char, kJsonBufferSize> mJsonBuffer;
+  std::array<uint8_t, sensorValuesBinarySize(255)> mBinaryBuffer;
+};
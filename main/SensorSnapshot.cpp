@@ -0,0 +1,82 @@
+#include "SensorSnapshot.hpp"
+
+SensorSnapshot::SensorSnapshot(
+    const spymarine::SensorDefinition& sensorDefinition)
+    : mValues{} {
+  mIndices.fill(kNoIndex);
+  sensorDefinition.forEach([&](spymarine::SensorId id, spymarine::SensorType) {
+    if (mValues.count == LatestSensorValues::kCapacity) {
+      return;
+    }
+    mIndices[id] = static_cast<uint8_t>(mValues.count);
+    auto& value = mValues.sensors[mValues.count++];
+    value.id = id;
+    value.scale = sensorDefinition.conversion(id).scale();
+  });
+  publish();
+}
+
+void SensorSnapshot::updateSample(const SensorSample& sample) {
+  const auto index = mIndices[sample.id];
+  if (index == kNoIndex) {
+    return;
+  }
+
+  auto& value = mValues.sensors[index];
+  value.samples++;
+  value.raw = sample.raw;
+  value.timestamp = sample.timestamp;
+}
+
+void SensorSnapshot::updateWindow(std::span<const SensorValue> values) {
+  for (const auto& window : values) {
+    const auto index = mIndices[window.id];
+    if (index != kNoIndex) {
+      mValues.sensors[index].window = window;
+    }
+  }
+}
+
+void writeLatestSensorValuesJson(JsonWriter& writer,
+                                 const LatestSensorValues& values,
+                                 uint32_t now) {
+  writer.startObject();
+  writer.addObjectKey("now");
+  writer.addInt(now);
+  writer.addObjectKey("sensors");
+  writer.startArray();
+
+  for (size_t i = 0; i < values.count; i++) {
+    const auto& value = values.sensors[i];
+    if (value.samples == 0) {
+      continue;
+    }
+
+    writer.startObject();
+    writer.addObjectKey("sensor_id");
+    writer.addInt(value.id);
+    writer.addObjectKey("value");
+    writer.addFixedPoint(value.raw, value.scale);
+    writer.addObjectKey("age_ms");
+    writer.addInt(static_cast<uint32_t>(now - value.timestamp));
+
+    const auto& window = value.window;
+    if (window.count > 0) {
+      writer.addObjectKey("mean");
+      writer.addFixedPoint(window.sum, uint64_t{window.count} * window.scale);
+      writer.addObjectKey("min");
+      writer.addFixedPoint(window.min, window.scale);
+      writer.addObjectKey("max");
+      writer.addFixedPoint(window.max, window.scale);
+      writer.addObjectKey("count");
+      writer.addInt(window.count);
+      writer.addObjectKey("mean_age_ms");
+      writer.addInt(static_cast<uint32_t>(now - window.lastTimestamp));
+    }
+
+    writer.endObject();
+  }
+
+  writer.endArray();
+  writer.endObject();
+}
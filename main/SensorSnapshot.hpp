@@ -0,0 +1,106 @@
+#pragma once
+
+#include "JsonWriter.hpp"
+#include "SensorAggregator.hpp"
+#include "Seqlock.hpp"
+#include "spymarine/Sensor.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+// The latest sample and reporting window of a sensor
+struct LatestSensorValue {
+  spymarine::SensorId id;
+  uint32_t scale;
+  // Samples received since boot, the other values are only set if non zero
+  uint32_t samples;
+  // The latest sample in units of scale and its receive time like
+  // SensorSample::timestamp
+  int32_t raw;
+  uint32_t timestamp;
+  // The last reporting window with samples of the sensor, count is zero
+  // until the first window ended
+  SensorValue window;
+};
+
+// The latest values of the first kCapacity defined sensors in id order
+struct LatestSensorValues {
+  static constexpr size_t kCapacity = 32;
+
+  size_t count;
+  std::array<LatestSensorValue, kCapacity> sensors;
+};
+
+/*! The latest sample and reporting window of every sensor, updated by the
+ *  aggregating task and read by any task, e.g. to answer local queries
+ *  without going through the MQTT broker.
+ *
+ *  The aggregating task updates its own copy and publishes it with
+ *  publish(), which never blocks. Readers get a consistent copy of the last
+ *  published values or retry, see Seqlock.
+ */
+class SensorSnapshot {
+public:
+  explicit SensorSnapshot(const spymarine::SensorDefinition& sensorDefinition);
+
+  // Only called by the aggregating task, O(1)
+  void updateSample(const SensorSample& sample);
+
+  // Only called by the aggregating task with the values of a window
+  void updateWindow(std::span<const SensorValue> values);
+
+  // Makes the updates so far visible to readers
+  void publish() { mPublished.store(mValues); }
+
+  /* Copies the last published values into values and returns true, or
+   * returns false if they were published at the same time. Can be called by
+   * any task.
+   */
+  bool read(LatestSensorValues& values) const {
+    return mPublished.tryLoad(values);
+  }
+
+private:
+  static constexpr uint8_t kNoIndex = 0xff;
+
+  // Index of each sensor in mValues
+  std::array<uint8_t, 256> mIndices;
+  LatestSensorValues mValues;
+  Seqlock<LatestSensorValues> mPublished;
+};
+
+/* Writes the values as an object with the time of the query in
+ * milliseconds since boot and, per sensor, the latest sample as "value",
+ * the mean, min, max and sample count of the last window and the time since
+ * their last sample:
+ *
+ *   {"now": 3600000, "sensors": [{"sensor_id": 35, "value": 12.41,
+ *    "age_ms": 120, "mean": 12.4, "min": 12.38, "max": 12.43, "count": 60,
+ *    "mean_age_ms": 20120}, ...]}
+ *
+ * Window values are left out until the first window ended, sensors without
+ * samples since boot are left out entirely.
+ */
+void writeLatestSensorValuesJson(JsonWriter& writer,
+                                 const LatestSensorValues& values,
+                                 uint32_t now);
+
+// Upper bound of the size of writeLatestSensorValuesJson for sensorCount
+// sensors
+constexpr size_t latestSensorValuesJsonSize(size_t sensorCount) {
+  // Longest numbers: sensor ids, counts and ages, and int32 values or means
+  // with sign, decimal point and fractional digits
+  constexpr size_t kIdSize = 3;
+  constexpr size_t kUInt32Size = 10;
+  constexpr size_t kValueSize = 12 + JsonWriter::kDoubleDecimals;
+  constexpr std::string_view kObject = R"({"now":,"sensors":[]})";
+  constexpr std::string_view kSensor =
+      R"({"sensor_id":,"value":,"age_ms":,"mean":,"min":,"max":,"count":,)"
+      R"("mean_age_ms":},)";
+  return kObject.size() + kUInt32Size +
+         sensorCount *
+             (kSensor.size() + kIdSize + 4 * kValueSize + 3 * kUInt32Size);
+}
@@ -0,0 +1,13 @@
+#include "SensorTopics.hpp"
+
+#include <cstdio>
+
+SensorTopics::SensorTopics(
+    const spymarine::SensorDefinition& sensorDefinition) {
+  sensorDefinition.forEach(
+      [&](spymarine::SensorId id, spymarine::SensorType type) {
+        std::snprintf(mTopics[id].data(), mTopics[id].size(),
+                      "/sensors/%d/%s", id,
+                      spymarine::kSensorTypeNames[static_cast<size_t>(type)]);
+      });
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "spymarine/Sensor.hpp"
+
+#include <array>
+#include <cstddef>
+
+/*! MQTT topics of the sensors in per sensor mode, "/sensors/<id>/<type>",
+ *  e.g. /sensors/35/voltage. The topics of all defined sensors are formatted
+ *  once so publishing a value only looks up its topic. The instance is large
+ *  (8 KiB) and should not be placed on a task stack.
+ */
+class SensorTopics {
+public:
+  // Fits the longest topic, "/sensors/255/temperature"
+  static constexpr size_t kMaxTopicSize = 32;
+
+  explicit SensorTopics(const spymarine::SensorDefinition& sensorDefinition);
+
+  // The topic of a defined sensor or nullptr if the sensor isn't defined
+  const char* topic(spymarine::SensorId id) const {
+    return mTopics[id][0] != '\0' ? mTopics[id].data() : nullptr;
+  }
+
+private:
+  std::array<std::array<char, kMaxTopicSize>, 256> mTopics{};
+};
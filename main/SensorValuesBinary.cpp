@@ -0,0 +1,69 @@
+#include "SensorValuesBinary.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+void writeUInt32(uint32_t value, std::span<uint8_t, 4> bytes) {
+  for (auto& byte : bytes) {
+    byte = static_cast<uint8_t>(value);
+    value >>= 8;
+  }
+}
+
+/* The mean in units of the binary format, rounded half away from zero
+ * without leaving integer arithmetic
+ */
+int64_t toRaw(const SensorValue& value, spymarine::SensorType type) {
+  const auto numerator = value.sum * spymarine::sensorBinaryScale(type);
+  const auto denominator = int64_t{value.count} * value.scale;
+  const auto half = numerator < 0 ? -denominator / 2 : denominator / 2;
+  return (numerator + half) / denominator;
+}
+
+} // namespace
+
+std::optional<std::span<const uint8_t>>
+writeSensorValuesBinary(std::span<uint8_t> buffer,
+                        std::span<const SensorValue> values,
+                        const spymarine::SensorDefinition& sensorDefinition,
+                        uint32_t timestamp) {
+  if (buffer.size() < kSensorValuesBinaryHeaderSize) {
+    return std::nullopt;
+  }
+
+  auto out = buffer.subspan(kSensorValuesBinaryHeaderSize);
+  uint8_t count = 0;
+
+  for (const auto& value : values) {
+    const auto type = sensorDefinition.find(value.id);
+    if (!type) {
+      continue;
+    }
+
+    if (out.size() < kSensorValuesBinaryValueSize ||
+        count == std::numeric_limits<uint8_t>::max()) {
+      return std::nullopt;
+    }
+
+    const auto exact = toRaw(value, *type);
+    const auto raw = static_cast<uint16_t>(
+        std::clamp<int64_t>(exact, std::numeric_limits<int16_t>::min(),
+                            std::numeric_limits<int16_t>::max()));
+    const auto saturated = static_cast<int16_t>(raw) != exact;
+    out[0] = value.id;
+    out[1] = static_cast<uint8_t>(*type) |
+             (saturated ? kSensorValuesBinarySaturated : 0);
+    out[2] = static_cast<uint8_t>(raw);
+    out[3] = static_cast<uint8_t>(raw >> 8);
+    out = out.subspan(kSensorValuesBinaryValueSize);
+    count++;
+  }
+
+  buffer[0] = kSensorValuesBinaryVersion;
+  buffer[1] = count;
+  writeUInt32(timestamp, buffer.subspan<2, 4>());
+
+  return buffer.first(sensorValuesBinarySize(count));
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "SensorAggregator.hpp"
+#include "spymarine/Sensor.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+
+/* Compact binary encoding of sensor values as an alternative to JSON when
+ * payload size matters, e.g. on metered connections.
+ *
+ * All numbers are little endian. Layout of version 1:
+ *
+ *   uint8  version
+ *   uint8  number of values
+ *   uint32 timestamp in seconds since the Unix epoch
+ *   for each value:
+ *     uint8  sensor id
+ *     uint8  sensor type (spymarine::SensorType), or'ed with
+ *            kSensorValuesBinarySaturated if the mean was clamped
+ *     int16  mean value in units of 1 / spymarine::sensorBinaryScale of
+ *            the sensor type
+ *
+ * Only the mean is encoded, statistics are JSON only.
+ */
+constexpr uint8_t kSensorValuesBinaryVersion = 1;
+// The mean didn't fit into int16, e.g. a running total since boot, and the
+// encoded value is its bound
+constexpr uint8_t kSensorValuesBinarySaturated = 0x80;
+constexpr size_t kSensorValuesBinaryHeaderSize = 6;
+constexpr size_t kSensorValuesBinaryValueSize = 4;
+
+// Size of a payload holding the given number of values
+constexpr size_t sensorValuesBinarySize(size_t valueCount) {
+  return kSensorValuesBinaryHeaderSize +
+         valueCount * kSensorValuesBinaryValueSize;
+}
+
+/* Encodes the values into buffer. Values without a type in sensorDefinition
+ * are skipped, values outside of the int16 range are clamped and flagged as
+ * saturated. Returns the written bytes or std::nullopt if buffer is too
+ * small.
+ */
+std::optional<std::span<const uint8_t>>
+writeSensorValuesBinary(std::span<uint8_t> buffer,
+                        std::span<const SensorValue> values,
+                        const spymarine::SensorDefinition& sensorDefinition,
+                        uint32_t timestamp);
+
+/* Decodes a payload written by writeSensorValuesBinary. Calls function with
+ * the sensor id, sensor type and value of every entry, saturated values are
+ * plus or minus infinity. Returns the timestamp or std::nullopt if the
+ * payload is malformed or of an unknown version.
+ */
+template <typename Function>
+std::optional<uint32_t> readSensorValuesBinary(std::span<const uint8_t> bytes,
+                                               Function function);
+
+/* Calls function with each payload of back to back payloads as published in
+ * batches and to /sensors/backlog. Payloads are delimited by their number of
+ * values only, their content isn't validated. Returns false if the last
+ * payload is truncated.
+ */
+template <typename Function>
+bool splitSensorValuesBinary(std::span<const uint8_t> bytes,
+                             Function function);
+
+template <typename Function>
+std::optional<uint32_t> readSensorValuesBinary(std::span<const uint8_t> bytes,
+                                               Function function) {
+  if (bytes.size() < kSensorValuesBinaryHeaderSize ||
+      bytes[0] != kSensorValuesBinaryVersion ||
+      bytes.size() != sensorValuesBinarySize(bytes[1])) {
+    return std::nullopt;
+  }
+
+  const auto timestamp = uint32_t(bytes[2]) | (uint32_t(bytes[3]) << 8) |
+                         (uint32_t(bytes[4]) << 16) |
+                         (uint32_t(bytes[5]) << 24);
+
+  for (auto value = bytes.subspan(kSensorValuesBinaryHeaderSize);
+       !value.empty(); value = value.subspan(kSensorValuesBinaryValueSize)) {
+    if (!spymarine::toSensorType(value[1] & ~kSensorValuesBinarySaturated)) {
+      return std::nullopt;
+    }
+  }
+
+  for (auto value = bytes.subspan(kSensorValuesBinaryHeaderSize);
+       !value.empty(); value = value.subspan(kSensorValuesBinaryValueSize)) {
+    const auto type = static_cast<spymarine::SensorType>(
+        value[1] & ~kSensorValuesBinarySaturated);
+    const auto raw = static_cast<int16_t>(value[2] | (value[3] << 8));
+    if (value[1] & kSensorValuesBinarySaturated) {
+      function(spymarine::SensorId{value[0]}, type,
+               raw < 0 ? -std::numeric_limits<double>::infinity()
+                       : std::numeric_limits<double>::infinity());
+      continue;
+    }
+    function(spymarine::SensorId{value[0]}, type,
+             static_cast<double>(raw) / spymarine::sensorBinaryScale(type));
+  }
+
+  return timestamp;
+}
+
+template <typename Function>
+bool splitSensorValuesBinary(std::span<const uint8_t> bytes,
+                             Function function) {
+  while (!bytes.empty()) {
+    if (bytes.size() < kSensorValuesBinaryHeaderSize ||
+        bytes.size() < sensorValuesBinarySize(bytes[1])) {
+      return false;
+    }
+    const auto size = sensorValuesBinarySize(bytes[1]);
+    function(bytes.first(size));
+    bytes = bytes.subspan(size);
+  }
+  return true;
+}
@@ -0,0 +1,72 @@
+#include "SensorValuesJson.hpp"
+
+#include <cmath>
+
+namespace {
+
+// The mean, the only value that isn't an exact decimal
+void writeMean(JsonWriter& writer, const SensorValue& value) {
+  writer.addFixedPoint(value.sum, uint64_t{value.count} * value.scale);
+}
+
+void writeStatistics(JsonWriter& writer, const SensorValue& value) {
+  writer.addObjectKey("min");
+  writer.addFixedPoint(value.min, value.scale);
+  writer.addObjectKey("max");
+  writer.addFixedPoint(value.max, value.scale);
+  writer.addObjectKey("last");
+  writer.addFixedPoint(value.last, value.scale);
+  writer.addObjectKey("stddev");
+  writer.addDouble(std::sqrt(value.variance));
+  writer.addObjectKey("count");
+  writer.addInt(value.count);
+}
+
+} // namespace
+
+void writeSensorValuesJson(JsonWriter& writer,
+                           std::span<const SensorValue> values,
+                           bool includeStatistics) {
+  writer.startArray();
+
+  for (const auto& value : values) {
+    writer.startObject();
+    writer.addObjectKey("sensor_id");
+    writer.addInt(value.id);
+    writer.addObjectKey("value");
+    writeMean(writer, value);
+
+    if (includeStatistics) {
+      writeStatistics(writer, value);
+    }
+
+    writer.endObject();
+  }
+
+  writer.endArray();
+}
+
+void writeSensorValueJson(JsonWriter& writer, const SensorValue& value,
+                          bool includeStatistics) {
+  if (!includeStatistics) {
+    writeMean(writer, value);
+    return;
+  }
+
+  writer.startObject();
+  writer.addObjectKey("value");
+  writeMean(writer, value);
+  writeStatistics(writer, value);
+  writer.endObject();
+}
+
+void writeSensorWindowJson(JsonWriter& writer,
+                           std::span<const SensorValue> values,
+                           uint32_t timestamp, bool includeStatistics) {
+  writer.startObject();
+  writer.addObjectKey("timestamp");
+  writer.addInt(timestamp);
+  writer.addObjectKey("sensors");
+  writeSensorValuesJson(writer, values, includeStatistics);
+  writer.endObject();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "JsonWriter.hpp"
+#include "SensorAggregator.hpp"
+
+#include <cstdint>
+#include <span>
+
+/* Writes the sensor values as a JSON array of objects containing the sensor
+ * id and the mean value. If includeStatistics is set, min, max, last value,
+ * standard deviation and sample count of the reporting window are added to
+ * each object.
+ */
+void writeSensorValuesJson(JsonWriter& writer,
+                           std::span<const SensorValue> values,
+                           bool includeStatistics = false);
+
+/* Writes the value of a single sensor as published to its own topic: the
+ * mean as a plain number or, if includeStatistics is set, an object with the
+ * mean as "value" and the statistics like in writeSensorValuesJson.
+ */
+void writeSensorValueJson(JsonWriter& writer, const SensorValue& value,
+                          bool includeStatistics = false);
+
+/* Writes the sensor values of a reporting window as an object with the end
+ * of the window in seconds since the Unix epoch, as used in batches of
+ * several windows:
+ *
+ *   {"timestamp": 1700000000, "sensors": [...]}
+ *
+ * The sensors are written like by writeSensorValuesJson.
+ */
+void writeSensorWindowJson(JsonWriter& writer,
+                           std::span<const SensorValue> values,
+                           uint32_t timestamp, bool includeStatistics = false);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*! A value written by exactly one thread and read by any number of threads
+ *  without locks.
+ *
+ *  store() never blocks or waits for readers. A read copies the value and
+ *  checks the sequence number the writer increments before and after every
+ *  store, so tryLoad() fails instead of returning a value that was written
+ *  while it was copied. Readers retry then, on FreeRTOS they should yield
+ *  before retrying in case they preempted the writer.
+ *
+ *  The value is kept in relaxed atomic words so concurrent copies aren't
+ *  data races.
+ */
+template <typename T> class Seqlock {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "Values are copied byte by byte");
+
+public:
+  void store(const T& value) {
+    const auto sequence = mSequence.load(std::memory_order_relaxed);
+    mSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const auto bytes = reinterpret_cast<const uint8_t*>(&value);
+    for (size_t i = 0; i < kWordCount; i++) {
+      uint32_t word = 0;
+      std::memcpy(&word, bytes + i * sizeof(word), wordSize(i));
+      mWords[i].store(word, std::memory_order_relaxed);
+    }
+
+    mSequence.store(sequence + 2, std::memory_order_release);
+  }
+
+  /* Copies the value into value and returns true, or returns false if a
+   * store was in progress, leaving value partly overwritten.
+   */
+  bool tryLoad(T& value) const {
+    const auto sequence = mSequence.load(std::memory_order_acquire);
+    if (sequence & 1) {
+      return false;
+    }
+
+    const auto bytes = reinterpret_cast<uint8_t*>(&value);
+    for (size_t i = 0; i < kWordCount; i++) {
+      const auto word = mWords[i].load(std::memory_order_relaxed);
+      std::memcpy(bytes + i * sizeof(word), &word, wordSize(i));
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return mSequence.load(std::memory_order_relaxed) == sequence;
+  }
+
+private:
+  static constexpr size_t kWordCount = (sizeof(T) + 3) / 4;
+
+  // The last word may only be partly used by the value
+  static constexpr size_t wordSize(size_t index) {
+    return std::min<size_t>(4, sizeof(T) - index * 4);
+  }
+
+  std::atomic<uint32_t> mSequence{0};
+  std::array<std::atomic<uint32_t>, kWordCount> mWords{};
+};
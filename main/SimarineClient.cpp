@@ -0,0 +1,167 @@
+#include "SimarineClient.hpp"
+
+#include "esp_log.h"
+
+#include "lwip/sockets.h"
+
+#include <array>
+
+namespace {
+const auto kTag = "simarine_client";
+
+// Device info responses hold a couple of strings, a frame larger than this
+// is treated as a protocol error
+constexpr size_t kMaxResponseSize = 1024;
+
+// Frames of other types, e.g. unsolicited updates, skipped per request
+constexpr int kMaxSkippedFrames = 8;
+} // namespace
+
+SimarineClient::SimarineClient() : mBuffer(kMaxResponseSize) {}
+
+SimarineClient::~SimarineClient() { disconnect(); }
+
+bool SimarineClient::connect(const char* address, uint16_t port,
+                             std::chrono::milliseconds timeout) {
+  disconnect();
+
+  sockaddr_in saddr{};
+  saddr.sin_family = AF_INET;
+  saddr.sin_port = htons(port);
+  if (inet_pton(AF_INET, address, &saddr.sin_addr) != 1) {
+    ESP_LOGE(kTag, "Invalid address %s", address);
+    return false;
+  }
+
+  const auto sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sock < 0) {
+    ESP_LOGE(kTag, "Failed to create socket. Error %d", errno);
+    return false;
+  }
+
+  timeval tv{};
+  tv.tv_sec = timeout.count() / 1000;
+  tv.tv_usec = (timeout.count() % 1000) * 1000;
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+  if (::connect(sock, reinterpret_cast<sockaddr*>(&saddr), sizeof(saddr)) !=
+      0) {
+    ESP_LOGE(kTag, "Failed to connect to %s:%d. Error %d", address, port,
+             errno);
+    close(sock);
+    return false;
+  }
+
+  mSocket = sock;
+  return true;
+}
+
+std::optional<spymarine::Message>
+SimarineClient::request(std::span<const uint8_t> request) {
+  if (!mSocket) {
+    return std::nullopt;
+  }
+
+  for (auto bytes = request; !bytes.empty();) {
+    const auto sent = send(*mSocket, bytes.data(), bytes.size(), 0);
+    if (sent <= 0) {
+      ESP_LOGW(kTag, "Failed to send request. Error %d", errno);
+      disconnect();
+      return std::nullopt;
+    }
+    bytes = bytes.subspan(sent);
+  }
+
+  const auto requestHeader = spymarine::parseHeader(request);
+  const std::span buffer{mBuffer};
+
+  for (int i = 0; i <= kMaxSkippedFrames; i++) {
+    const auto headerBytes = buffer.first(spymarine::kHeaderLength);
+    if (!receiveAll(headerBytes)) {
+      return std::nullopt;
+    }
+
+    // The length counts the bytes after the header plus one
+    const auto header = spymarine::parseHeader(headerBytes);
+    const size_t size =
+        header ? header->length + spymarine::kHeaderLength - 1 : 0;
+    if (!header || size < spymarine::kHeaderLength || size > buffer.size()) {
+      ESP_LOGW(kTag, "Received an invalid frame");
+      disconnect();
+      return std::nullopt;
+    }
+
+    const auto frame = buffer.first(size);
+    if (!receiveAll(frame.subspan(spymarine::kHeaderLength))) {
+      return std::nullopt;
+    }
+
+    if (requestHeader && header->type == requestHeader->type) {
+      const auto message = spymarine::parseMessage(frame);
+      if (!message) {
+        ESP_LOGW(kTag, "Received a corrupted response");
+      }
+      return message;
+    }
+  }
+
+  ESP_LOGW(kTag, "No response to request of type %d",
+           requestHeader ? requestHeader->type : 0);
+  return std::nullopt;
+}
+
+bool SimarineClient::receiveAll(std::span<uint8_t> bytes) {
+  while (!bytes.empty()) {
+    const auto received = recv(*mSocket, bytes.data(), bytes.size(), 0);
+    if (received <= 0) {
+      ESP_LOGW(kTag, "Failed to receive response. Error %d", errno);
+      disconnect();
+      return false;
+    }
+    bytes = bytes.subspan(received);
+  }
+  return true;
+}
+
+void SimarineClient::disconnect() {
+  if (mSocket) {
+    close(*mSocket);
+    mSocket.reset();
+  }
+}
+
+std::unique_ptr<spymarine::SensorDiscovery>
+discoverSensors(SimarineClient& client) {
+  std::array<uint8_t, spymarine::kDeviceRequestSize> request;
+
+  const auto countResponse =
+      client.request(spymarine::writeDeviceCountRequest(request));
+  const auto deviceCount =
+      countResponse ? spymarine::parseDeviceCount(*countResponse)
+                    : std::nullopt;
+  if (!deviceCount) {
+    ESP_LOGW(kTag, "Couldn't read the device count");
+    return nullptr;
+  }
+
+  auto discovery = std::make_unique<spymarine::SensorDiscovery>();
+  for (unsigned index = 0; index < *deviceCount; index++) {
+    const auto infoResponse = client.request(spymarine::writeDeviceInfoRequest(
+        request, static_cast<uint8_t>(index)));
+    const auto deviceType =
+        infoResponse ? spymarine::parseDeviceType(*infoResponse)
+                     : std::nullopt;
+    if (!deviceType) {
+      ESP_LOGW(kTag, "Couldn't read the type of device %u", index);
+      return nullptr;
+    }
+    if (!discovery->addDevice(*deviceType)) {
+      ESP_LOGW(kTag, "Device %u has an unknown type %d or too many sensors",
+               index, *deviceType);
+      return nullptr;
+    }
+  }
+
+  return discovery;
+}
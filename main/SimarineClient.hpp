@@ -0,0 +1,52 @@
+#pragma once
+
+#include "spymarine/Devices.hpp"
+#include "spymarine/Parsing.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+/*! Requests information from a Simarine device over TCP.
+ *
+ *  Responses are read frame by frame using the length in the header, frames
+ *  of other types than the request are skipped. Every read waits at most
+ *  for the timeout given to connect.
+ */
+class SimarineClient {
+public:
+  SimarineClient();
+  ~SimarineClient();
+
+  SimarineClient(const SimarineClient&) = delete;
+  SimarineClient& operator=(const SimarineClient&) = delete;
+
+  /* Connects to the IPv4 address and port. Returns false on failure.
+   */
+  bool connect(const char* address, uint16_t port,
+               std::chrono::milliseconds timeout);
+
+  /* Sends request and returns the first response of the same message type.
+   * The message points into a buffer that is reused by the next request.
+   * Returns std::nullopt on timeout or if the connection is lost.
+   */
+  std::optional<spymarine::Message> request(std::span<const uint8_t> request);
+
+private:
+  bool receiveAll(std::span<uint8_t> bytes);
+  void disconnect();
+
+  std::optional<int> mSocket;
+  std::vector<uint8_t> mBuffer;
+};
+
+/* Queries the number and types of all devices connected to the Simarine
+ * device and builds the sensor definition from them. Allocated as it's too
+ * large for a task stack. Returns nullptr if a request fails or a device type
+ * is unknown.
+ */
+std::unique_ptr<spymarine::SensorDiscovery>
+discoverSensors(SimarineClient& client);
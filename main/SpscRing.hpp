@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+/*! Lock-free ring buffer for exactly one producer and one consumer thread.
+ *
+ *  push() may only be called from the producer and pop() only from the
+ *  consumer. Neither blocks, push() fails if the ring is full. Capacity must
+ *  be a power of two.
+ */
+template <typename T, size_t Capacity> class SpscRing {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+public:
+  bool push(const T& value) {
+    const auto head = mHead.load(std::memory_order_relaxed);
+    if (head - mCachedTail == Capacity) {
+      mCachedTail = mTail.load(std::memory_order_acquire);
+      if (head - mCachedTail == Capacity) {
+        return false;
+      }
+    }
+
+    mItems[head & kMask] = value;
+    mHead.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::optional<T> pop() {
+    const auto tail = mTail.load(std::memory_order_relaxed);
+    if (tail == mCachedHead) {
+      mCachedHead = mHead.load(std::memory_order_acquire);
+      if (tail == mCachedHead) {
+        return std::nullopt;
+      }
+    }
+
+    const auto value = mItems[tail & kMask];
+    mTail.store(tail + 1, std::memory_order_release);
+    return value;
+  }
+
+  static constexpr size_t capacity() { return Capacity; }
+
+private:
+  static constexpr size_t kMask = Capacity - 1;
+  // Keeps the indices written by different threads on separate cache lines
+  static constexpr size_t kCacheLineSize = 64;
+
+  // Written by the producer
+  alignas(kCacheLineSize) std::atomic<size_t> mHead{0};
+  size_t mCachedTail{0};
+
+  // Written by the consumer
+  alignas(kCacheLineSize) std::atomic<size_t> mTail{0};
+  size_t mCachedHead{0};
+
+  alignas(kCacheLineSize) std::array<T, Capacity> mItems{};
+};
@@ -2,6 +2,8 @@
 
 #include "esp_log.h"
 #include "esp_netif.h"
+#include <algorithm>
+#include <array>
 #include <optional>
 #include <sys/select.h>
 
@@ -19,8 +21,7 @@ std::optional<int> createBroadcastSocket(const size_t port) {
     return std::nullopt;
   }
 
-  sockaddr_in saddr;
-  saddr.sin_len = 0;
+  sockaddr_in saddr{};
   saddr.sin_family = PF_INET;
   saddr.sin_port = htons(port);
   saddr.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -35,8 +36,17 @@ std::optional<int> createBroadcastSocket(const size_t port) {
 
   return sock;
 }
+
+bool isWouldBlock(int error) {
+  return error == EAGAIN || error == EWOULDBLOCK;
+}
+
 } // namespace
 
+FrameBatch::FrameBatch(size_t capacity, size_t frameSize)
+    : mBuffer(capacity * frameSize), mFrameSize{frameSize},
+      mFrames(capacity) {}
+
 UdpBroadcastServer::~UdpBroadcastServer() {
   ESP_LOGE(kTag, "Shutting down socket...");
   if (mSocket) {
@@ -82,3 +92,89 @@ UdpBroadcastServer::receive(std::span<uint8_t> buffer) {
 
   return std::nullopt;
 }
+
+bool UdpBroadcastServer::receiveBatch(
+    FrameBatch& batch, std::optional<std::chrono::milliseconds> timeout) {
+  batch.mCount = 0;
+
+  if (!mSocket) {
+    return false;
+  }
+
+  const auto socket = *mSocket;
+
+  fd_set rfds;
+  FD_ZERO(&rfds);
+  FD_SET(socket, &rfds);
+
+  timeval tv{};
+  if (timeout) {
+    tv.tv_sec = timeout->count() / 1000;
+    tv.tv_usec = (timeout->count() % 1000) * 1000;
+  }
+
+  const auto s =
+      select(socket + 1, &rfds, nullptr, nullptr, timeout ? &tv : nullptr);
+  if (s < 0) {
+    ESP_LOGE(kTag, "Select failed: errno %d", errno);
+    return false;
+  } else if (s == 0) {
+    return true;
+  }
+
+#if defined(__linux__)
+  constexpr size_t kMessagesPerCall = 16;
+  std::array<mmsghdr, kMessagesPerCall> messages;
+  std::array<iovec, kMessagesPerCall> vectors;
+
+  while (batch.mCount < batch.capacity()) {
+    const auto count =
+        std::min(kMessagesPerCall, batch.capacity() - batch.mCount);
+    for (size_t i = 0; i < count; i++) {
+      const auto buffer = batch.buffer(batch.mCount + i);
+      vectors[i] = {buffer.data(), buffer.size()};
+      messages[i] = {};
+      messages[i].msg_hdr.msg_iov = &vectors[i];
+      messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    const int received = recvmmsg(socket, messages.data(), count,
+                                   MSG_DONTWAIT, nullptr);
+    if (received < 0) {
+      if (isWouldBlock(errno)) {
+        break;
+      }
+      ESP_LOGE(kTag, "broadcast recvmmsg failed: errno %d", errno);
+      return false;
+    }
+
+    for (int i = 0; i < received; i++) {
+      batch.mFrames[batch.mCount] =
+          batch.buffer(batch.mCount).first(messages[i].msg_len);
+      batch.mCount++;
+    }
+
+    if (static_cast<size_t>(received) < count) {
+      break;
+    }
+  }
+#else
+  while (batch.mCount < batch.capacity()) {
+    const auto buffer = batch.buffer(batch.mCount);
+    const int bytesReceived = recvfrom(socket, buffer.data(), buffer.size(),
+                                       MSG_DONTWAIT, nullptr, nullptr);
+    if (bytesReceived < 0) {
+      if (isWouldBlock(errno)) {
+        break;
+      }
+      ESP_LOGE(kTag, "broadcast recvfrom failed: errno %d", errno);
+      return false;
+    }
+
+    batch.mFrames[batch.mCount] = buffer.first(bytesReceived);
+    batch.mCount++;
+  }
+#endif
+
+  return true;
+}
@@ -1,10 +1,39 @@
 #pragma once
 
+#include <chrono>
 #include <optional>
 #include <span>
+#include <vector>
 
 #include <cstdint>
 
+/*! Preallocated buffers for a batch of datagrams received with
+ *  UdpBroadcastServer::receiveBatch.
+ */
+class FrameBatch {
+public:
+  FrameBatch(size_t capacity, size_t frameSize);
+
+  size_t capacity() const { return mFrames.size(); }
+
+  // The datagrams received by the last call to receiveBatch
+  std::span<const std::span<uint8_t>> frames() const {
+    return {mFrames.data(), mCount};
+  }
+
+private:
+  friend class UdpBroadcastServer;
+
+  std::span<uint8_t> buffer(size_t index) {
+    return {mBuffer.data() + index * mFrameSize, mFrameSize};
+  }
+
+  std::vector<uint8_t> mBuffer;
+  size_t mFrameSize;
+  std::vector<std::span<uint8_t>> mFrames;
+  size_t mCount{0};
+};
+
 class UdpBroadcastServer {
 public:
   UdpBroadcastServer() = default;
@@ -14,6 +43,14 @@ public:
 
   std::optional<std::span<uint8_t>> receive(std::span<uint8_t> buffer);
 
+  /* Waits up to timeout (forever if not set) for a datagram and then drains
+   * all pending datagrams without blocking until the batch is full. Uses
+   * recvmmsg where available. Returns false on error, the received datagrams
+   * are available from batch.frames() which is empty on timeout.
+   */
+  bool receiveBatch(FrameBatch& batch,
+                    std::optional<std::chrono::milliseconds> timeout = {});
+
 private:
   std::optional<int> mSocket;
 };
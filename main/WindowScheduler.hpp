@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+
+/*! Determines the boundaries of reporting windows.
+ *
+ *  Boundaries are aligned to multiples of the interval since the epoch of
+ *  Clock, e.g. full minutes of the wall clock, so windows end on a
+ *  predictable cadence independent of when samples arrive. Windows that were
+ *  missed entirely are skipped. If the clock jumps, e.g. when the time is
+ *  synchronized over SNTP, the boundaries are realigned.
+ *
+ *  Clock is a template parameter so the scheduler can be driven by a
+ *  recorded or simulated clock.
+ */
+template <typename Clock> class WindowScheduler {
+public:
+  using Duration = typename Clock::duration;
+  using TimePoint = typename Clock::time_point;
+
+  WindowScheduler(Duration interval, TimePoint now)
+      : mInterval{interval}, mNextBoundary{boundaryAfter(now)} {}
+
+  // Time until the current window ends, zero if it already ended
+  Duration timeUntilBoundary(TimePoint now) const {
+    return now >= mNextBoundary ? Duration::zero() : mNextBoundary - now;
+  }
+
+  /* Returns true if the current window ended at time now and moves on to the
+   * window containing now.
+   */
+  bool advance(TimePoint now) {
+    if (now >= mNextBoundary) {
+      mNextBoundary = boundaryAfter(now);
+      return true;
+    }
+
+    if (mNextBoundary - now > mInterval) {
+      // The clock went backwards
+      mNextBoundary = boundaryAfter(now);
+    }
+    return false;
+  }
+
+  TimePoint nextBoundary() const { return mNextBoundary; }
+
+private:
+  TimePoint boundaryAfter(TimePoint now) const {
+    const auto sinceEpoch = now.time_since_epoch();
+    auto remainder = sinceEpoch % mInterval;
+    if (remainder < Duration::zero()) {
+      remainder += mInterval;
+    }
+    return TimePoint{sinceEpoch - remainder + mInterval};
+  }
+
+  Duration mInterval;
+  TimePoint mNextBoundary;
+};
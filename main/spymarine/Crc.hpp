@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/* Number of bytes processed per table lookup round. 1 uses a single 256 entry
+ * table (512 bytes), 4 and 8 use slice-by-N with N tables, trading flash for
+ * fewer dependent operations per byte. The CRC bounds the cost of decoding a
+ * frame, so the default spends 4 KiB on the 8 tables.
+ */
+#ifndef SPYMARINE_CRC_SLICES
+#define SPYMARINE_CRC_SLICES 8
+#endif
+
+namespace spymarine {
+
+namespace detail {
+
+constexpr uint16_t kCrcPolynomial = 0x1189;
+
+template <size_t Slices>
+using CrcTables = std::array<std::array<uint16_t, 256>, Slices>;
+
+/* Table k holds the CRC of a byte followed by k zero bytes. Table 0 is the
+ * classic byte-wise table.
+ */
+template <size_t Slices> constexpr CrcTables<Slices> makeCrcTables() {
+  CrcTables<Slices> tables{};
+
+  for (unsigned byte = 0; byte < 256; byte++) {
+    auto crc = static_cast<uint16_t>(byte << 8);
+    for (int i = 0; i < 8; i++) {
+      if (crc & 0x8000) {
+        crc = static_cast<uint16_t>((crc << 1) ^ kCrcPolynomial);
+      } else {
+        crc = static_cast<uint16_t>(crc << 1);
+      }
+    }
+    tables[0][byte] = crc;
+  }
+
+  for (size_t slice = 1; slice < Slices; slice++) {
+    for (unsigned byte = 0; byte < 256; byte++) {
+      const auto previous = tables[slice - 1][byte];
+      tables[slice][byte] =
+          static_cast<uint16_t>((previous << 8) ^ tables[0][previous >> 8]);
+    }
+  }
+
+  return tables;
+}
+
+template <size_t Slices>
+inline constexpr CrcTables<Slices> kCrcTables = makeCrcTables<Slices>();
+
+} // namespace detail
+
+/* Incremental CRC as accepted by Simarine devices. Bytes can be fed in any
+ * number of chunks, the result is the same as calculating the CRC over all
+ * bytes at once.
+ */
+template <size_t Slices> class BasicCrcState {
+  static_assert(Slices == 1 || Slices == 4 || Slices == 8,
+                "Supported slice counts are 1, 4 and 8");
+
+public:
+  // Bytes processed per round, spans of a multiple of it have no remainder
+  static constexpr size_t kSlices = Slices;
+
+  constexpr void update(uint8_t byte) {
+    const auto& table = detail::kCrcTables<Slices>[0];
+    mCrc = static_cast<uint16_t>((mCrc << 8) ^ table[(mCrc >> 8) ^ byte]);
+  }
+
+  constexpr void update(std::span<const uint8_t> bytes) {
+    if constexpr (Slices > 1) {
+      const auto& tables = detail::kCrcTables<Slices>;
+      while (bytes.size() >= Slices) {
+        // The first two bytes are combined with the current CRC, the others
+        // are looked up on their own. The byte at index i is processed with
+        // the table for the number of bytes that follow it.
+        const auto crc =
+            static_cast<uint16_t>(mCrc ^ ((bytes[0] << 8) | bytes[1]));
+        uint16_t next = tables[Slices - 1][crc >> 8] ^
+                        tables[Slices - 2][crc & 0xff];
+        for (size_t i = 2; i < Slices; i++) {
+          next ^= tables[Slices - 1 - i][bytes[i]];
+        }
+        mCrc = next;
+        bytes = bytes.subspan(Slices);
+      }
+    }
+
+    for (const auto byte : bytes) {
+      update(byte);
+    }
+  }
+
+  constexpr uint16_t value() const { return mCrc; }
+
+private:
+  uint16_t mCrc{0};
+};
+
+using CrcState = BasicCrcState<SPYMARINE_CRC_SLICES>;
+
+} // namespace spymarine
@@ -0,0 +1,113 @@
+#include "Devices.hpp"
+
+#include <algorithm>
+
+namespace spymarine {
+
+namespace {
+
+// Id of the number holding the device index of a request
+constexpr uint8_t kDeviceIndexValueId = 0;
+
+// Id of the number holding the device count or device type of a response
+constexpr uint8_t kResponseValueId = 1;
+
+std::span<const uint8_t>
+writeDeviceRequest(std::span<uint8_t, kDeviceRequestSize> buffer,
+                   MessageType type, uint8_t deviceIndex) {
+  constexpr auto length = kDeviceRequestSize - kHeaderLength + 1;
+  const std::array<uint8_t, kDeviceRequestSize - 2> frame{
+      // Header
+      0x00, 0x00, 0x00, 0x00, 0x00, 0xff, static_cast<uint8_t>(type), 0x85,
+      0xde, 0xc3, 0x46, static_cast<uint8_t>(length >> 8),
+      static_cast<uint8_t>(length), 0xff,
+      // The device index as a number value
+      kDeviceIndexValueId, 0x01, 0x00, 0x00, 0x00, deviceIndex, 0xff};
+
+  std::copy(frame.begin(), frame.end(), buffer.begin());
+
+  // The CRC doesn't cover the first byte and the byte in front of the CRC
+  const auto value = crc(buffer.subspan(1, kDeviceRequestSize - 4));
+  buffer[kDeviceRequestSize - 2] = static_cast<uint8_t>(value >> 8);
+  buffer[kDeviceRequestSize - 1] = static_cast<uint8_t>(value);
+
+  return buffer;
+}
+
+// Returns the low byte of the number with the given id
+std::optional<uint8_t> findNumber(const Message& message, uint8_t id) {
+  std::optional<uint8_t> result;
+  const auto error = parseValues(
+      message.data,
+      [&](uint8_t valueId, Number number) {
+        if (valueId == id && !result) {
+          result = static_cast<uint8_t>(number.firstWord());
+        }
+      },
+      [](uint8_t, std::string_view) {});
+
+  if (error) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+} // namespace
+
+std::span<const uint8_t>
+writeDeviceCountRequest(std::span<uint8_t, kDeviceRequestSize> buffer) {
+  return writeDeviceRequest(buffer, MessageType::deviceCount, 0);
+}
+
+std::span<const uint8_t>
+writeDeviceInfoRequest(std::span<uint8_t, kDeviceRequestSize> buffer,
+                       uint8_t deviceIndex) {
+  return writeDeviceRequest(buffer, MessageType::deviceInfo, deviceIndex);
+}
+
+std::optional<uint8_t> parseDeviceRequest(const Message& message) {
+  if (message.type != MessageType::deviceCount &&
+      message.type != MessageType::deviceInfo) {
+    return std::nullopt;
+  }
+  return findNumber(message, kDeviceIndexValueId);
+}
+
+std::optional<uint8_t> parseDeviceCount(const Message& message) {
+  if (message.type != MessageType::deviceCount) {
+    return std::nullopt;
+  }
+  return findNumber(message, kResponseValueId);
+}
+
+std::optional<uint8_t> parseDeviceType(const Message& message) {
+  if (message.type != MessageType::deviceInfo) {
+    return std::nullopt;
+  }
+  return findNumber(message, kResponseValueId);
+}
+
+bool SensorDiscovery::addDevice(uint8_t deviceType) {
+  const auto layout =
+      std::find_if(kDeviceLayouts.begin(), kDeviceLayouts.end(),
+                   [&](const auto& layout) {
+                     return layout.deviceType == deviceType;
+                   });
+  if (layout == kDeviceLayouts.end() ||
+      mNextId + layout->stateCount > 256) {
+    return false;
+  }
+
+  for (size_t i = 0; i < layout->sensorCount; i++) {
+    const auto& sensor = layout->sensors[i];
+    mDefinition.add(static_cast<SensorId>(mNextId + sensor.offset),
+                    sensor.type);
+  }
+  mNextId += layout->stateCount;
+  mDeviceCount++;
+
+  mHash = (mHash ^ deviceType) * 16777619u;
+  return true;
+}
+
+} // namespace spymarine
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "Parsing.hpp"
+#include "Sensor.hpp"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace spymarine {
+
+/* TCP port on which a Simarine device answers deviceCount and deviceInfo
+ * requests
+ */
+constexpr uint16_t kSimarineTcpPort = 5001;
+
+// Size of a deviceCount or deviceInfo request
+constexpr size_t kDeviceRequestSize = kHeaderLength + 7 + 2;
+
+/* Writes a request for the number of connected devices into buffer and
+ * returns the written bytes.
+ */
+std::span<const uint8_t>
+writeDeviceCountRequest(std::span<uint8_t, kDeviceRequestSize> buffer);
+
+/* Writes a request for the information about the device at index into
+ * buffer and returns the written bytes. Devices are indexed from 0 to the
+ * device count.
+ */
+std::span<const uint8_t>
+writeDeviceInfoRequest(std::span<uint8_t, kDeviceRequestSize> buffer,
+                       uint8_t deviceIndex);
+
+/* Returns the device index of a deviceCount or deviceInfo request or
+ * std::nullopt if the message isn't a valid request.
+ */
+std::optional<uint8_t> parseDeviceRequest(const Message& message);
+
+/* Returns the number of devices of a deviceCount response or std::nullopt if
+ * the message isn't a valid response.
+ */
+std::optional<uint8_t> parseDeviceCount(const Message& message);
+
+/* Returns the device type of a deviceInfo response or std::nullopt if the
+ * message isn't a valid response.
+ */
+std::optional<uint8_t> parseDeviceType(const Message& message);
+
+/* A sensor of a device, offset is relative to the first sensor id of the
+ * device
+ */
+struct DeviceSensor {
+  uint8_t offset;
+  SensorType type;
+};
+
+/* The sensor ids a device occupies in sensor state messages. Every device
+ * occupies stateCount consecutive ids in the order of the device indices,
+ * sensors lists the ids that are reported.
+ */
+struct DeviceLayout {
+  uint8_t deviceType;
+  uint8_t stateCount;
+  uint8_t sensorCount;
+  std::array<DeviceSensor, 4> sensors;
+};
+
+/* Layouts of the known device types. The protocol is reverse engineered,
+ * the battery layout matches the sensors of Config.example.hpp and the
+ * others might need adjustments for some devices. Discovery fails for
+ * unknown types as the ids of all following devices would be off.
+ */
+inline constexpr std::array kDeviceLayouts{
+    // Null device, an unused slot
+    DeviceLayout{0, 0, 0, {}},
+    // Voltmeter
+    DeviceLayout{1, 1, 1, {{{0, SensorType::voltage}}}},
+    // Ammeter
+    DeviceLayout{2, 2, 1, {{{0, SensorType::current}}}},
+    // Thermometer
+    DeviceLayout{3, 1, 1, {{{0, SensorType::temperature}}}},
+    // Barometer
+    DeviceLayout{5, 2, 1, {{{0, SensorType::barometer}}}},
+    // Ohmmeter
+    DeviceLayout{6, 1, 1, {{{0, SensorType::resistance}}}},
+    // Tank
+    DeviceLayout{8,
+                 2,
+                 2,
+                 {{{0, SensorType::tankLevel}, {1, SensorType::tankVolume}}}},
+    // Battery
+    DeviceLayout{9,
+                 5,
+                 4,
+                 {{{0, SensorType::charge},
+                   {1, SensorType::current},
+                   {2, SensorType::voltage},
+                   {3, SensorType::capacity}}}},
+};
+
+// Changes whenever kDeviceLayouts changes so cached definitions are rebuilt
+constexpr uint8_t kDeviceLayoutsVersion = 1;
+
+/* Builds a sensor definition from the types of all connected devices in the
+ * order of their indices. The topology hash identifies the sequence of
+ * device types, e.g. to detect whether a cached definition is still valid.
+ */
+class SensorDiscovery {
+public:
+  /* Adds the device with the next index. Returns false if the type is
+   * unknown or the devices occupy more ids than a sensor state message can
+   * address.
+   */
+  bool addDevice(uint8_t deviceType);
+
+  size_t deviceCount() const { return mDeviceCount; }
+  const SensorDefinition& sensorDefinition() const { return mDefinition; }
+  uint32_t topologyHash() const { return mHash; }
+
+private:
+  SensorDefinition mDefinition;
+  size_t mDeviceCount{0};
+  unsigned mNextId{0};
+
+  // FNV-1a
+  uint32_t mHash{2166136261u};
+};
+
+} // namespace spymarine
@@ -1,4 +1,5 @@
 #include "Parsing.hpp"
+#include "Crc.hpp"
 
 #include <algorithm>
 #include <cstring>
@@ -51,41 +52,77 @@ std::optional<Header> parseHeader(const std::span<const uint8_t> bytes) {
 }
 
 uint16_t crc(const std::span<const uint8_t> bytes) {
-  const uint16_t poly = 0x1189;
-  uint16_t crc = 0;
-
-  for (auto byte : bytes) {
-    crc ^= byte << 8;
-    for (int i = 0; i < 8; i++) {
-      if (crc & 0x8000) {
-        crc = (crc << 1) ^ poly;
-      } else {
-        crc <<= 1;
-      }
-    }
-  }
+  CrcState state;
+  state.update(bytes);
+  return state.value();
+}
 
-  return crc;
+void ParseCounters::count(const ParseError error) {
+  switch (error) {
+  case ParseError::badMagic:
+    badMagic++;
+    break;
+  case ParseError::lengthMismatch:
+    lengthMismatch++;
+    break;
+  case ParseError::crcMismatch:
+    crcMismatch++;
+    break;
+  case ParseError::truncatedValue:
+    truncatedValue++;
+    break;
+  case ParseError::unknownValueType:
+    unknownValueType++;
+    break;
+  }
 }
 
-std::optional<Message> parseMessage(const std::span<const uint8_t> bytes) {
-  const auto header = parseHeader(bytes);
-  const auto dataLength = bytes.size() - kHeaderLength + 1;
+namespace {
+
+// The smallest frame that holds a header and a CRC
+constexpr size_t kMinMessageLength = kHeaderLength + 2;
 
-  if (header->length != dataLength) {
+std::optional<Message> parseMessage(const std::span<const uint8_t> bytes,
+                                    ParseCounters* counters) {
+  const auto reject = [&](ParseError error) -> std::optional<Message> {
+    if (counters) {
+      counters->count(error);
+    }
     return std::nullopt;
+  };
+
+  const auto header = parseHeader(bytes);
+  if (!header) {
+    return reject(bytes.size() < kHeaderLength ? ParseError::lengthMismatch
+                                               : ParseError::badMagic);
   }
 
-  const auto calculatedCrc = crc(std::span{bytes.begin() + 1, bytes.end() - 3});
-  const auto receivedCrc =
-      toUInt16(std::span<const uint8_t, 2>{bytes.end() - 2, 2});
+  if (bytes.size() < kMinMessageLength ||
+      header->length != bytes.size() - kHeaderLength + 1) {
+    return reject(ParseError::lengthMismatch);
+  }
+
+  const auto calculatedCrc = crc(bytes.subspan(1, bytes.size() - 4));
+  const auto receivedCrc = toUInt16(bytes.last<2>());
 
   if (calculatedCrc != receivedCrc) {
-    return std::nullopt;
+    return reject(ParseError::crcMismatch);
   }
 
-  return Message{static_cast<MessageType>(header->type),
-                 std::span{bytes.begin() + kHeaderLength, bytes.end() - 2}};
+  return Message{
+      static_cast<MessageType>(header->type),
+      bytes.subspan(kHeaderLength, bytes.size() - kMinMessageLength)};
+}
+
+} // namespace
+
+std::optional<Message> parseMessage(const std::span<const uint8_t> bytes) {
+  return parseMessage(bytes, nullptr);
+}
+
+std::optional<Message> parseMessage(const std::span<const uint8_t> bytes,
+                                    ParseCounters& counters) {
+  return parseMessage(bytes, &counters);
 }
 
 } // namespace spymarine
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <iosfwd>
 #include <optional>
 #include <span>
@@ -51,27 +52,69 @@ bool operator!=(const Message& lhs, const Message& rhs);
  */
 std::optional<Header> parseHeader(std::span<const uint8_t> bytes);
 
-/* Calculate a CRC as accepted by Simarine devices.
+/* Calculate a CRC as accepted by Simarine devices. Use CrcState from
+ * Crc.hpp to calculate it incrementally.
  *
  * Original source: https://github.com/htool/pico2signalk
  * Copyright Erik Bosman / @brainsmoke
  */
 uint16_t crc(const std::span<const uint8_t> bytes);
 
+/* Reasons for rejecting a message or its values
+ */
+enum class ParseError : uint8_t {
+  // The frame doesn't start with a known header
+  badMagic,
+
+  // The length in the header doesn't match the frame size
+  lengthMismatch,
+
+  // The CRC of the frame doesn't match the received CRC
+  crcMismatch,
+
+  // A value extends beyond the end of the message
+  truncatedValue,
+
+  // A value has a type that is neither number nor string
+  unknownValueType,
+};
+
+/* Number of rejected messages per reason
+ */
+struct ParseCounters {
+  uint32_t badMagic{0};
+  uint32_t lengthMismatch{0};
+  uint32_t crcMismatch{0};
+  uint32_t truncatedValue{0};
+  uint32_t unknownValueType{0};
+
+  void count(ParseError error);
+};
+
 /* Parse a message from a Simarine device. Returns a Message on success.
  * Returns std::nullopt if the given data is not a valid or known Simarine
- * Message.
+ * Message. Never reads outside of bytes.
  */
 std::optional<Message> parseMessage(std::span<const uint8_t> bytes);
 
+// Same as above, counts the reason if the message is rejected
+std::optional<Message> parseMessage(std::span<const uint8_t> bytes,
+                                    ParseCounters& counters);
+
 /* A number in a message. The number still needs to be interpreted based on the
  * type of information it holds.
  */
 struct Number {
   std::span<const uint8_t, 4> bytes;
 
-  int16_t firstWord() const { return (bytes[2] << 8) | bytes[3]; }
-  int16_t secondWord() const { return (bytes[0] << 8) | bytes[1]; }
+  constexpr int16_t firstWord() const { return (bytes[2] << 8) | bytes[3]; }
+  constexpr int16_t secondWord() const { return (bytes[0] << 8) | bytes[1]; }
+
+  // All 4 bytes as one number, the second word being the upper half
+  constexpr uint32_t unsignedValue() const {
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) |
+           (uint32_t(bytes[2]) << 8) | bytes[3];
+  }
 };
 
 /* Parses a list of values that a message might hold. The value has an id and
@@ -80,58 +123,83 @@ struct Number {
  * number as its arguments.
  * Calls stringFunction for each string that is found in bytes with the id and
  * string as its arguments.
+ * Stops at the first value that is truncated or of an unknown type and returns
+ * the reason, the values before it have been passed to the functions. Never
+ * reads outside of bytes.
  */
 template <typename NumberFunction, typename StringFunction>
-void parseValues(std::span<const uint8_t> bytes, NumberFunction numberFunction,
-                 StringFunction stringFunction);
+std::optional<ParseError> parseValues(std::span<const uint8_t> bytes,
+                                      NumberFunction numberFunction,
+                                      StringFunction stringFunction);
 
 namespace detail {
+
+// Sizes of the values including id, type and the trailing 0xff
+constexpr size_t kNumberValueSize = 7;
+constexpr size_t kExtendedNumberValueSize = 12;
+
+// Strings start after id, type and 5 unknown bytes and end with 0, 0xff
+constexpr size_t kStringOffset = 7;
+
+/* Parses the value at the start of bytes and returns the bytes after it.
+ * Returns an empty span and sets error if the value can't be parsed.
+ */
 template <typename NumberFunction, typename StringFunction>
 std::span<const uint8_t> parseValue(const std::span<const uint8_t> bytes,
-                                    NumberFunction numberFunction,
-                                    StringFunction stringFunction) {
-  if (bytes.size() < 2) {
-    return {};
-  }
-
-  const auto id = bytes[0];
-  const auto type = bytes[1];
-  if (type == 1) {
-    if (bytes.size() >= 6) {
-      numberFunction(id, Number{bytes.subspan<2, 4>()});
-      return bytes.subspan(7);
-    }
-  } else if (type == 3) {
-    if (bytes.size() >= 11) {
-      numberFunction(id, Number{bytes.subspan<7, 4>()});
-      return bytes.subspan(12);
-    }
-  } else if (type == 4) {
-    const auto data = bytes.subspan(7);
-    const auto it = std::find(data.begin(), data.end(), uint8_t{0});
-    if (it != data.end()) {
-      const auto pos = std::distance(data.begin(), it);
-
-      // It looks like a custom encoding is used for strings. Special
-      // characters will unfortunately not works as expected.
-      const auto str =
-          std::string_view{reinterpret_cast<const char*>(data.data()),
-                           static_cast<std::string_view::size_type>(pos)};
-      stringFunction(id, str);
-
-      return bytes.subspan(7 + pos + 2);
+                                    NumberFunction& numberFunction,
+                                    StringFunction& stringFunction,
+                                    std::optional<ParseError>& error) {
+  if (bytes.size() >= 2) {
+    const auto id = bytes[0];
+    const auto type = bytes[1];
+
+    if (type == 1) {
+      if (bytes.size() >= kNumberValueSize) {
+        numberFunction(id, Number{bytes.subspan<2, 4>()});
+        return bytes.subspan(kNumberValueSize);
+      }
+    } else if (type == 3) {
+      if (bytes.size() >= kExtendedNumberValueSize) {
+        numberFunction(id, Number{bytes.subspan<7, 4>()});
+        return bytes.subspan(kExtendedNumberValueSize);
+      }
+    } else if (type == 4) {
+      if (bytes.size() >= kStringOffset) {
+        const auto data = bytes.subspan(kStringOffset);
+        const auto it = std::find(data.begin(), data.end(), uint8_t{0});
+
+        // The terminating 0 is followed by one more byte
+        const auto pos = static_cast<size_t>(std::distance(data.begin(), it));
+        if (pos + 2 <= data.size()) {
+          // It looks like a custom encoding is used for strings. Special
+          // characters will unfortunately not works as expected.
+          stringFunction(id, std::string_view{
+                                 reinterpret_cast<const char*>(data.data()),
+                                 pos});
+          return data.subspan(pos + 2);
+        }
+      }
+    } else {
+      error = ParseError::unknownValueType;
+      return {};
     }
   }
 
+  error = ParseError::truncatedValue;
   return {};
 }
+
 } // namespace detail
 
 template <typename NumberFunction, typename StringFunction>
-void parseValues(std::span<const uint8_t> bytes, NumberFunction numberFunction,
-                 StringFunction stringFunction) {
+std::optional<ParseError> parseValues(std::span<const uint8_t> bytes,
+                                      NumberFunction numberFunction,
+                                      StringFunction stringFunction) {
+  std::optional<ParseError> error;
   while (!bytes.empty()) {
-    bytes = detail::parseValue(bytes, numberFunction, stringFunction);
+    bytes = detail::parseValue(bytes, numberFunction, stringFunction, error);
   }
+  return error;
 }
+
 } // namespace spymarine
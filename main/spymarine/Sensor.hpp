@@ -3,57 +3,408 @@
 #include "JsonWriter.hpp"
 #include "Parsing.hpp"
 
+#include <array>
 #include <cstdint>
-#include <unordered_map>
+#include <initializer_list>
+#include <optional>
+#include <utility>
 
 namespace spymarine {
 
-/* Sensor type of a Simarine device.
- * Note that this is only a subset that I needed for
- * personal use.
+/* Sensor type of a Simarine device. The values are part of the binary
+ * sensor value format, new types have to be added at the end.
  */
-enum class SensorType {
+enum class SensorType : uint8_t {
+  // State of charge of a battery from 0 to 1
   charge,
+
+  // Current in A
   current,
+
+  // Voltage in V
   voltage,
+
+  // Temperature in °C
+  temperature,
+
+  // Fill level of a tank from 0 to 1
+  tankLevel,
+
+  // Remaining volume of a tank in l
+  tankVolume,
+
+  // Pressure, e.g. of a water system, in bar
+  pressure,
+
+  // Atmospheric pressure in hPa
+  barometer,
+
+  // Resistance in Ω
+  resistance,
+
+  // Remaining capacity of a battery in Ah
+  capacity,
+
+  // The following types aren't reported by Simarine devices but derived
+  // from other sensors, see DerivedSensors.hpp
+
+  // Power in W
+  power,
+
+  // Energy in Wh
+  energy,
+
+  // Change of the state of charge per hour
+  chargeRate,
+
+  // Duration in h
+  duration,
 };
 
+// duration has to stay the last type
+constexpr size_t kSensorTypeCount =
+    static_cast<size_t>(SensorType::duration) + 1;
+
+// Names of the sensor types as written in code, indexed by the type
+inline constexpr std::array<const char*, kSensorTypeCount> kSensorTypeNames{
+    "charge",     "current",   "voltage",    "temperature", "tankLevel",
+    "tankVolume", "pressure",  "barometer",  "resistance",  "capacity",
+    "power",      "energy",    "chargeRate", "duration"};
+static_assert(kSensorTypeNames.back() != nullptr,
+              "Every sensor type needs a name");
+
 // Identifies a sensor in a sensor state message
 using SensorId = uint8_t;
 
-// A map from sensor id to sensor type. The sensor state message
-// does unfortunately not contain the information so it needs to be
-// extracted upfront.
-using SensorDefinition = std::unordered_map<SensorId, SensorType>;
+// Where the raw value of a sensor is stored in a Number
+enum class RawEncoding : uint8_t {
+  // Signed 16 bit, the lower half
+  firstWord,
+
+  // Signed 16 bit, the upper half
+  secondWord,
+
+  // Unsigned 16 bit, the lower half
+  unsignedFirstWord,
+
+  // Unsigned 32 bit, all 4 bytes
+  unsignedValue,
+};
+
+/* How the number of a sensor type is converted: kEncoding tells where the
+ * raw value is stored and kScale is the number of raw units per unit, e.g.
+ * the number of a voltage sensor is in mV. kBinaryScale is the resolution of
+ * the binary sensor value format if it differs from kScale. All scales are
+ * products of powers of 2 and 5, so every raw value has an exact decimal
+ * representation.
+ *
+ * charge, current and voltage are verified with a Simarine Pico, the other
+ * types follow the encoding documented by the community and might need
+ * adjustments for some devices.
+ */
+template <SensorType Type> struct SensorTraits;
+
+template <> struct SensorTraits<SensorType::charge> {
+  static constexpr auto kEncoding = RawEncoding::secondWord;
+  static constexpr uint32_t kScale = 16000;
+};
+
+template <> struct SensorTraits<SensorType::current> {
+  static constexpr auto kEncoding = RawEncoding::firstWord;
+  static constexpr uint32_t kScale = 100;
+};
+
+template <> struct SensorTraits<SensorType::voltage> {
+  static constexpr auto kEncoding = RawEncoding::firstWord;
+  static constexpr uint32_t kScale = 1000;
+};
+
+template <> struct SensorTraits<SensorType::temperature> {
+  static constexpr auto kEncoding = RawEncoding::firstWord;
+  static constexpr uint32_t kScale = 10;
+};
+
+template <> struct SensorTraits<SensorType::tankLevel> {
+  static constexpr auto kEncoding = RawEncoding::firstWord;
+  static constexpr uint32_t kScale = 1000;
+};
+
+template <> struct SensorTraits<SensorType::tankVolume> {
+  static constexpr auto kEncoding = RawEncoding::secondWord;
+  static constexpr uint32_t kScale = 10;
+};
+
+template <> struct SensorTraits<SensorType::pressure> {
+  static constexpr auto kEncoding = RawEncoding::firstWord;
+  static constexpr uint32_t kScale = 1000;
+};
+
+// Pa don't fit into 16 bits, the binary format uses 0.1 hPa instead
+template <> struct SensorTraits<SensorType::barometer> {
+  static constexpr auto kEncoding = RawEncoding::unsignedValue;
+  static constexpr uint32_t kScale = 100;
+  static constexpr uint32_t kBinaryScale = 10;
+};
+
+template <> struct SensorTraits<SensorType::resistance> {
+  static constexpr auto kEncoding = RawEncoding::unsignedFirstWord;
+  static constexpr uint32_t kScale = 1;
+};
+
+// Derived integrals count capacity since boot, the binary format uses 0.1 Ah
+// to hold more than 327 Ah
+template <> struct SensorTraits<SensorType::capacity> {
+  static constexpr auto kEncoding = RawEncoding::firstWord;
+  static constexpr uint32_t kScale = 100;
+  static constexpr uint32_t kBinaryScale = 10;
+};
+
+/* The derived types are computed from raw values, their encoding only
+ * matters for a device that would report them. The binary format trades
+ * resolution for range.
+ */
+template <> struct SensorTraits<SensorType::power> {
+  static constexpr auto kEncoding = RawEncoding::firstWord;
+  static constexpr uint32_t kScale = 100;
+  static constexpr uint32_t kBinaryScale = 10;
+};
+
+template <> struct SensorTraits<SensorType::energy> {
+  static constexpr auto kEncoding = RawEncoding::firstWord;
+  static constexpr uint32_t kScale = 100;
+  static constexpr uint32_t kBinaryScale = 1;
+};
+
+template <> struct SensorTraits<SensorType::chargeRate> {
+  static constexpr auto kEncoding = RawEncoding::firstWord;
+  static constexpr uint32_t kScale = 10000;
+};
+
+template <> struct SensorTraits<SensorType::duration> {
+  static constexpr auto kEncoding = RawEncoding::firstWord;
+  static constexpr uint32_t kScale = 100;
+  static constexpr uint32_t kBinaryScale = 10;
+};
+
+/* Converts the number of a sensor to its value without branching on the
+ * sensor type: the raw value is shifted and masked out of the 32 bit number,
+ * sign extended and scaled.
+ */
+class SensorConversion {
+public:
+  constexpr SensorConversion() = default;
+  constexpr SensorConversion(RawEncoding encoding, uint32_t scale)
+      : mScale{scale} {
+    switch (encoding) {
+    case RawEncoding::firstWord:
+      mMask = 0xffff;
+      mSignBit = 0x8000;
+      break;
+    case RawEncoding::secondWord:
+      mShift = 16;
+      mMask = 0xffff;
+      mSignBit = 0x8000;
+      break;
+    case RawEncoding::unsignedFirstWord:
+      mMask = 0xffff;
+      break;
+    case RawEncoding::unsignedValue:
+      break;
+    }
+  }
+
+  // The value in raw units
+  constexpr int64_t raw(Number number) const {
+    const int64_t value = (number.unsignedValue() >> mShift) & mMask;
+    return (value ^ mSignBit) - mSignBit;
+  }
+
+  constexpr double operator()(Number number) const {
+    return static_cast<double>(raw(number)) / mScale;
+  }
+
+  // Raw units per unit
+  constexpr uint32_t scale() const { return mScale; }
+
+private:
+  uint32_t mShift{0};
+  uint32_t mMask{0xffffffff};
+  int64_t mSignBit{0};
+  uint32_t mScale{1};
+};
+
+namespace detail {
+template <SensorType Type> constexpr uint32_t binaryScale() {
+  using Traits = SensorTraits<Type>;
+  if constexpr (requires { Traits::kBinaryScale; }) {
+    return Traits::kBinaryScale;
+  } else {
+    return Traits::kScale;
+  }
+}
+
+template <size_t... Types>
+constexpr std::array<SensorConversion, kSensorTypeCount>
+makeSensorConversions(std::index_sequence<Types...>) {
+  return {SensorConversion{
+      SensorTraits<static_cast<SensorType>(Types)>::kEncoding,
+      SensorTraits<static_cast<SensorType>(Types)>::kScale}...};
+}
+
+template <size_t... Types>
+constexpr std::array<uint32_t, kSensorTypeCount>
+makeSensorScales(std::index_sequence<Types...>) {
+  return {SensorTraits<static_cast<SensorType>(Types)>::kScale...};
+}
+
+template <size_t... Types>
+constexpr std::array<uint32_t, kSensorTypeCount>
+makeSensorBinaryScales(std::index_sequence<Types...>) {
+  return {binaryScale<static_cast<SensorType>(Types)>()...};
+}
+} // namespace detail
+
+// Conversions and scales of every sensor type, indexed by the type
+inline constexpr auto kSensorConversions = detail::makeSensorConversions(
+    std::make_index_sequence<kSensorTypeCount>{});
+inline constexpr auto kSensorScales =
+    detail::makeSensorScales(std::make_index_sequence<kSensorTypeCount>{});
+inline constexpr auto kSensorBinaryScales = detail::makeSensorBinaryScales(
+    std::make_index_sequence<kSensorTypeCount>{});
+
+/* A map from sensor id to sensor type. The sensor state message
+ * does unfortunately not contain the information so it needs to be
+ * extracted upfront.
+ *
+ * Since sensor ids are a single byte, the map is a dense table indexed by
+ * the id. Lookups are a single load and the table can be built at compile
+ * time, e.g. constexpr SensorDefinition definition{{26, SensorType::charge}}.
+ * The conversion of each sensor is resolved when it's added, so converting a
+ * sample doesn't depend on its type.
+ */
+class SensorDefinition {
+public:
+  using Entry = std::pair<SensorId, SensorType>;
+
+  constexpr SensorDefinition() = default;
+  constexpr SensorDefinition(std::initializer_list<Entry> entries) {
+    for (const auto& [id, type] : entries) {
+      add(id, type);
+    }
+  }
+
+  constexpr void add(SensorId id, SensorType type) {
+    mTypes[id] = type;
+    mConversions[id] = kSensorConversions[static_cast<size_t>(type)];
+  }
+
+  // Returns the type of the sensor or std::nullopt if it's not defined
+  constexpr std::optional<SensorType> find(SensorId id) const {
+    return mTypes[id];
+  }
+
+  // Returns the conversion of a defined sensor
+  constexpr const SensorConversion& conversion(SensorId id) const {
+    return mConversions[id];
+  }
+
+  // Calls function with the id and type of every defined sensor in id order
+  template <typename Function>
+  constexpr void forEach(Function function) const {
+    for (size_t id = 0; id < mTypes.size(); id++) {
+      if (mTypes[id]) {
+        function(static_cast<SensorId>(id), *mTypes[id]);
+      }
+    }
+  }
+
+private:
+  std::array<std::optional<SensorType>, 256> mTypes{};
+  std::array<SensorConversion, 256> mConversions{};
+};
+
+// Converts a serialized sensor type, returns std::nullopt for unknown types
+constexpr std::optional<SensorType> toSensorType(uint8_t type) {
+  if (type < kSensorTypeCount) {
+    return static_cast<SensorType>(type);
+  }
+  return std::nullopt;
+}
+
+/* Number of raw units per unit of the sensor value, e.g. the number of a
+ * voltage sensor is in mV.
+ */
+constexpr uint32_t sensorScale(SensorType type) {
+  return kSensorScales[static_cast<size_t>(type)];
+}
 
-/* Convert the given number and type to a value in the expected unit
+// Number of units of the binary sensor value format per unit of the value
+constexpr uint32_t sensorBinaryScale(SensorType type) {
+  return kSensorBinaryScales[static_cast<size_t>(type)];
+}
+
+/* Convert the given number and type to a value in the expected unit. Prefer
+ * SensorDefinition::conversion when converting many samples.
  */
-double sensorValue(SensorType type, Number number);
+constexpr double sensorValue(SensorType type, Number number) {
+  return kSensorConversions[static_cast<size_t>(type)](number);
+}
 
 /* Convenience function that takes a buffer containing a message and a
  * sensor definition and calls function for every sensor with the sensor
  * id and the sensor value.
  */
 template <typename SensorValueFunction>
-void parseSensorStateMessage(const std::span<uint8_t> bytes,
+void parseSensorStateMessage(const std::span<const uint8_t> bytes,
                              const SensorDefinition& sensorDefinition,
                              SensorValueFunction function);
 
+// Same as above, counts the reason if the message or a value is rejected
+template <typename SensorValueFunction>
+void parseSensorStateMessage(const std::span<const uint8_t> bytes,
+                             const SensorDefinition& sensorDefinition,
+                             ParseCounters& counters,
+                             SensorValueFunction function);
+
+namespace detail {
+template <typename SensorValueFunction>
+std::optional<ParseError>
+parseSensorStateValues(const Message& message,
+                       const SensorDefinition& sensorDefinition,
+                       SensorValueFunction function) {
+  if (message.type != MessageType::sensorState) {
+    return std::nullopt;
+  }
+  return parseValues(
+      message.data,
+      [&](const SensorId id, const Number number) {
+        if (const auto type = sensorDefinition.find(id)) {
+          function(id, sensorValue(*type, number));
+        }
+      },
+      [](const SensorId, const std::string_view) {});
+}
+} // namespace detail
+
+template <typename SensorValueFunction>
+void parseSensorStateMessage(const std::span<const uint8_t> bytes,
+                             const SensorDefinition& sensorDefinition,
+                             SensorValueFunction function) {
+  if (const auto message = parseMessage(bytes)) {
+    detail::parseSensorStateValues(*message, sensorDefinition, function);
+  }
+}
+
 template <typename SensorValueFunction>
-void parseSensorStateMessage(const std::span<uint8_t> bytes,
+void parseSensorStateMessage(const std::span<const uint8_t> bytes,
                              const SensorDefinition& sensorDefinition,
+                             ParseCounters& counters,
                              SensorValueFunction function) {
-  if (const auto message = parseMessage(bytes);
-      message && message->type == MessageType::sensorState) {
-    parseValues(
-        message->data,
-        [&](const SensorId id, const Number number) {
-          const auto it = sensorDefinition.find(id);
-          if (it != sensorDefinition.end()) {
-            function(id, sensorValue(it->second, number));
-          }
-        },
-        [](const SensorId, const std::string_view) {});
+  if (const auto message = parseMessage(bytes, counters)) {
+    if (const auto error = detail::parseSensorStateValues(
+            *message, sensorDefinition, function)) {
+      counters.count(*error);
+    }
   }
 }
 
@@ -0,0 +1,95 @@
+#include "SensorStateDecoder.hpp"
+
+#include "Crc.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+namespace spymarine {
+
+namespace {
+
+// The smallest frame that holds a header and a CRC
+constexpr size_t kMinMessageLength = kHeaderLength + 2;
+
+// Bytes added to the CRC at once, a multiple of every supported slice count
+constexpr size_t kCrcBlockSize = 32;
+
+} // namespace
+
+std::optional<std::span<SensorReading>>
+decodeSensorState(const std::span<const uint8_t> bytes,
+                  const SensorDefinition& sensorDefinition,
+                  const std::span<SensorReading> output,
+                  ParseCounters& counters) {
+  const auto reject = [&](ParseError error) {
+    counters.count(error);
+    return std::nullopt;
+  };
+
+  if (bytes.size() < kHeaderLength) {
+    return reject(ParseError::lengthMismatch);
+  }
+  if (std::memcmp(bytes.data(), "\x00\x00\x00\x00\x00\xff", 6) != 0 ||
+      bytes[13] != 0xff) {
+    return reject(ParseError::badMagic);
+  }
+  const auto length = static_cast<size_t>((bytes[11] << 8) | bytes[12]);
+  if (bytes.size() < kMinMessageLength ||
+      length != bytes.size() - kHeaderLength + 1) {
+    return reject(ParseError::lengthMismatch);
+  }
+  if (bytes[6] != static_cast<uint8_t>(MessageType::sensorState)) {
+    return output.first(0);
+  }
+
+  // The CRC covers everything but the first byte, the byte before the CRC
+  // and the CRC itself. It trails the value cursor in small blocks, so the
+  // CRC chain and the value extraction are interleaved in the same loop
+  // instead of walking the frame twice.
+  CrcState crc;
+  size_t crcPosition = 1;
+  const auto crcEnd = bytes.size() - 3;
+
+  const auto end = bytes.size() - 2;
+  size_t count = 0;
+  std::optional<ParseError> valueError;
+
+  auto numberFunction = [&](const SensorId id, const Number number) {
+    if (sensorDefinition.find(id) && count < output.size()) {
+      // Only unsigned 32 bit values can exceed the range
+      const auto raw = std::clamp<int64_t>(
+          sensorDefinition.conversion(id).raw(number),
+          std::numeric_limits<int32_t>::min(),
+          std::numeric_limits<int32_t>::max());
+      output[count++] = {id, static_cast<int32_t>(raw)};
+    }
+  };
+  auto stringFunction = [](const SensorId, const std::string_view) {};
+
+  auto values = bytes.subspan(kHeaderLength, end - kHeaderLength);
+  while (!values.empty()) {
+    values =
+        detail::parseValue(values, numberFunction, stringFunction, valueError);
+
+    const auto position = std::min(end - values.size(), crcEnd);
+    while (position - crcPosition >= kCrcBlockSize) {
+      crc.update(bytes.subspan(crcPosition, kCrcBlockSize));
+      crcPosition += kCrcBlockSize;
+    }
+  }
+
+  crc.update(bytes.subspan(crcPosition, crcEnd - crcPosition));
+  if (crc.value() != ((bytes[end] << 8) | bytes[end + 1])) {
+    return reject(ParseError::crcMismatch);
+  }
+
+  if (valueError) {
+    counters.count(*valueError);
+  }
+  return output.first(count);
+}
+
+} // namespace spymarine
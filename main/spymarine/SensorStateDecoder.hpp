@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Parsing.hpp"
+#include "Sensor.hpp"
+
+#include <optional>
+#include <span>
+
+namespace spymarine {
+
+/* A value of a sensor in a sensor state message in raw units, see
+ * SensorConversion::scale
+ */
+struct SensorReading {
+  SensorId id;
+  int32_t raw;
+};
+
+/* Decodes a sensor state message in a single forward pass over bytes:
+ * validates the header, accumulates the CRC and extracts the values at the
+ * same time. Only values of sensors in sensorDefinition are written to
+ * output, values beyond output.size() are dropped.
+ *
+ * Returns the written readings, which are empty for messages of other types
+ * whose CRC isn't checked. Returns std::nullopt and counts the reason if the
+ * message is rejected. Like parseSensorStateMessage, the readings before a
+ * truncated or unknown value are returned and the value error is counted.
+ */
+std::optional<std::span<SensorReading>>
+decodeSensorState(std::span<const uint8_t> bytes,
+                  const SensorDefinition& sensorDefinition,
+                  std::span<SensorReading> output, ParseCounters& counters);
+
+} // namespace spymarine